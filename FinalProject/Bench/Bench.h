@@ -0,0 +1,22 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <chrono>
+
+using namespace std;
+
+// Each benchmark prints its own results, returns false when it could not run
+bool RunDrawBenchmark();
+bool RunLightBenchmark();
+bool RunMeshReport();
+bool RunNormalBenchmark();
+bool RunPrimitiveBenchmark();
+
+/* Milliseconds elapsed since start */
+/////////////////////////////////////
+inline double ElapsedMilliseconds(chrono::steady_clock::time_point start)
+{
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
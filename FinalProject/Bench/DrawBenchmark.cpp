@@ -0,0 +1,304 @@
+#include "Bench.h"
+#include "FrameContext.h"
+#include "FrameData.h"
+#include "GeometryArena.h"
+#include "PrimitiveCache.h"
+#include "RenderQueue.h"
+#include "Scene.h"
+#include "ShaderCache.h"
+#include "UniformTable.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/transform.hpp>
+
+#include <iostream>
+#include <vector>
+
+#define GLSL(Version, Source) "#version " #Version " core \n" #Source
+
+// Draws submitted per frame and frames averaged
+const GLuint DRAW_BENCH_DRAWS = 10000;
+const int DRAW_BENCH_FRAMES = 20;
+
+/* Uniform interface of the original object shader: camera and lights are set per draw */
+//////////////////////////////////////////////////////////////////////////////////////////
+static const char* baselineVertexShader = GLSL(330,
+	layout(location = 0) in vec3 position;
+	layout(location = 1) in vec3 normal;
+
+	out vec3 vertexNormal;
+	out vec3 vertexFragmentPos;
+
+	uniform mat4 model;
+	uniform mat4 view;
+	uniform mat4 projection;
+
+	void main()
+	{
+		gl_Position = projection * view * model * vec4(position, 1.0f);
+		vertexFragmentPos = vec3(model * vec4(position, 1.0f));
+		vertexNormal = mat3(model) * normal;
+	}
+);
+
+static const char* baselineFragmentShader = GLSL(330,
+	in vec3 vertexNormal;
+	in vec3 vertexFragmentPos;
+
+	out vec4 fragmentColor;
+
+	struct Light {
+		vec3 position;
+		vec3 color;
+		vec3 direction;
+		float intensity;
+	};
+
+	uniform vec3 objectColor;
+	uniform vec3 viewPosition;
+	uniform bool hasTexture;
+	uniform Light lights[3];
+
+	void main()
+	{
+		vec3 result = vec3(0.0);
+		for (int i = 0; i < 3; i++)
+		{
+			vec3 toLight = lights[i].position - vertexFragmentPos - lights[i].direction;
+			result += lights[i].color * lights[i].intensity * max(dot(normalize(vertexNormal), normalize(toLight)), 0.0);
+		}
+		float rim = length(viewPosition - vertexFragmentPos) * 0.0f;
+		fragmentColor = vec4(result * objectColor + rim + (hasTexture ? 0.0 : 0.1), 1.0);
+	}
+);
+
+/* Uniform interface of the current object shader: camera and lights come from FrameData */
+////////////////////////////////////////////////////////////////////////////////////////////
+static const char* frameDataVertexShader = GLSL(330,
+	layout(location = 0) in vec3 position;
+	layout(location = 1) in vec3 normal;
+
+	out vec3 vertexNormal;
+	out vec3 vertexFragmentPos;
+
+	struct Light {
+		vec3 position;
+		vec3 color;
+		vec3 direction;
+		float intensity;
+	};
+
+	layout(std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec3 viewPosition;
+		Light lights[3];
+	};
+
+	uniform mat4 model;
+	uniform mat3 normalMatrix;
+
+	void main()
+	{
+		gl_Position = projection * view * model * vec4(position, 1.0f);
+		vertexFragmentPos = vec3(model * vec4(position, 1.0f));
+		vertexNormal = normalMatrix * normal;
+	}
+);
+
+static const char* frameDataFragmentShader = GLSL(330,
+	in vec3 vertexNormal;
+	in vec3 vertexFragmentPos;
+
+	out vec4 fragmentColor;
+
+	struct Light {
+		vec3 position;
+		vec3 color;
+		vec3 direction;
+		float intensity;
+	};
+
+	layout(std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec3 viewPosition;
+		Light lights[3];
+	};
+
+	uniform vec3 objectColor;
+
+	void main()
+	{
+		vec3 result = vec3(0.0);
+		for (int i = 0; i < 3; i++)
+		{
+			vec3 toLight = lights[i].position - vertexFragmentPos - lights[i].direction;
+			result += lights[i].color * lights[i].intensity * max(dot(normalize(vertexNormal), normalize(toLight)), 0.0);
+		}
+		fragmentColor = vec4(result * objectColor, 1.0);
+	}
+);
+
+/* The original setUniforms: every location looked up by name, camera copied by value */
+/////////////////////////////////////////////////////////////////////////////////////////
+static void setBaselineUniforms(glm::mat4 model, glm::mat4 view, glm::mat4 projection, GLuint shaderId, Camera camera, bool hasTexture)
+{
+	glUniformMatrix4fv(glGetUniformLocation(shaderId, "model"), 1, GL_FALSE, glm::value_ptr(model));
+	glUniformMatrix4fv(glGetUniformLocation(shaderId, "view"), 1, GL_FALSE, glm::value_ptr(view));
+	glUniformMatrix4fv(glGetUniformLocation(shaderId, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+
+	glUniform3f(glGetUniformLocation(shaderId, "lights[0].position"), 7.0f, 1.0f, 0.0f);
+	glUniform3f(glGetUniformLocation(shaderId, "lights[0].color"), 1.0f, 0.97f, 0.61f);
+	glUniform1f(glGetUniformLocation(shaderId, "lights[0].intensity"), 1.0f);
+	glUniform3f(glGetUniformLocation(shaderId, "lights[1].position"), 0.0f, 1.0f, -7.0f);
+	glUniform3f(glGetUniformLocation(shaderId, "lights[1].color"), 1.0f, 0.97f, 0.61f);
+	glUniform1f(glGetUniformLocation(shaderId, "lights[1].intensity"), 1.0f);
+	glUniform3f(glGetUniformLocation(shaderId, "lights[2].direction"), -0.2f, -1.0f, -0.3f);
+	glUniform3f(glGetUniformLocation(shaderId, "lights[2].color"), 1.0f, 1.0f, 1.0f);
+
+	glUniform3f(glGetUniformLocation(shaderId, "objectColor"), 1.0f, 1.0f, 1.0f);
+	glUniform3f(glGetUniformLocation(shaderId, "viewPosition"), camera.Position.x, camera.Position.y, camera.Position.z);
+	glUniform1i(glGetUniformLocation(shaderId, "hasTexture"), hasTexture);
+}
+
+/* The original Render* path for one draw: program, matrices and VAO are set every time */
+///////////////////////////////////////////////////////////////////////////////////////////
+static void drawBaseline(GLuint shaderId, const Mesh& mesh, const glm::vec3& position, GLint width, GLint height, Camera camera)
+{
+	glUseProgram(shaderId);
+
+	glm::mat4 model = glm::translate(position) * glm::rotate(glm::radians(35.0f), glm::vec3(0.0f, -1.0f, 0.0f)) * glm::scale(glm::vec3(1.0f));
+	glm::mat4 view = camera.GetViewMatrix();
+	glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (GLfloat)width / (GLfloat)height, 0.1f, 100.0f);
+	setBaselineUniforms(model, view, projection, shaderId, camera, true);
+
+	glBindVertexArray(mesh.GetVertexArray());
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	mesh.DrawBound(0);
+	glBindVertexArray(0);
+
+	glUseProgram(0);
+}
+
+/* Where draw i sits in a grid that fills the view */
+/////////////////////////////////////////////////////
+static glm::vec3 gridPosition(GLuint i)
+{
+	return glm::vec3((float)(i % 100) * 0.5f - 25.0f, (float)(i / 100) * 0.5f - 25.0f, 0.0f);
+}
+
+/* CPU submit cost of 10k cube draws through the original per-draw uniform path   */
+/* and through the FrameData buffer and render queue                              */
+////////////////////////////////////////////////////////////////////////////////////
+bool RunDrawBenchmark()
+{
+	const GLint width = 800, height = 600;
+	Camera camera(glm::vec3(0.0f, 0.0f, 60.0f));
+
+	GLuint baselineProgram = 0, frameDataProgram = 0;
+	if (!CreateShaderProgram(baselineVertexShader, baselineFragmentShader, baselineProgram) ||
+		!CreateShaderProgram(frameDataVertexShader, frameDataFragmentShader, frameDataProgram))
+	{
+		DestroyShaderProgram(baselineProgram);
+		DestroyShaderProgram(frameDataProgram);
+		return false;
+	}
+
+	// Float vertices, the layout the original meshes used
+	PrimitiveCache primitiveCache(VertexLayout::PositionNormalUV());
+	shared_ptr<Mesh> cube = primitiveCache.Acquire(PrimitiveDesc::Cube(0.3f, 0.3f, 0.3f));
+
+	glViewport(0, 0, width, height);
+	glEnable(GL_DEPTH_TEST);
+
+	// Before: every draw copies the camera and looks up and sets every uniform
+	double baselineMilliseconds = 0.0;
+	for (int frame = 0; frame < DRAW_BENCH_FRAMES; ++frame)
+	{
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glFinish();
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (GLuint i = 0; i < DRAW_BENCH_DRAWS; ++i)
+		{
+			drawBaseline(baselineProgram, *cube, gridPosition(i), width, height, camera);
+		}
+		baselineMilliseconds += ElapsedMilliseconds(start);
+		glFinish();
+	}
+
+	// After: camera and lights are uploaded once per frame, draws are sorted and use cached handles
+	UniformTable uniformTable;
+	uniformTable.Build(frameDataProgram);
+	DrawUniforms uniforms;
+	uniforms.Resolve(uniformTable);
+
+	FrameUniformBuffer frameUniformBuffer;
+	frameUniformBuffer.Create();
+	frameUniformBuffer.AttachProgram(frameDataProgram);
+
+	Scene scene;
+	RenderQueue renderQueue;
+	GLuint cubeMesh = scene.AddMesh(cube.get());
+	GLuint material = scene.AddMaterial({ uniforms, 0, glm::vec3(1.0f) });
+	for (GLuint i = 0; i < DRAW_BENCH_DRAWS; ++i)
+	{
+		scene.AddItem(cubeMesh, material, glm::translate(gridPosition(i)) * glm::rotate(glm::radians(35.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
+	}
+
+	FrameContext frameContext;
+	frameContext.SetViewport(width, height);
+	const GLfloat orthoCoords[4] = { 0.0f, 5.0f, 0.0f, 4.0f };
+
+	FrameData frameData = {};
+	frameData.lights[0].position = glm::vec4(7.0f, 1.0f, 0.0f, 1.0f);
+	frameData.lights[0].color = glm::vec4(1.0f, 0.97f, 0.61f, 1.0f);
+	frameData.lights[0].intensity = 1.0f;
+	frameData.lights[1].position = glm::vec4(0.0f, 1.0f, -7.0f, 1.0f);
+	frameData.lights[1].color = glm::vec4(1.0f, 0.97f, 0.61f, 1.0f);
+	frameData.lights[1].intensity = 1.0f;
+	frameData.lights[2].color = glm::vec4(1.0f);
+	frameData.lights[2].direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+
+	double queueMilliseconds = 0.0;
+	for (int frame = 0; frame < DRAW_BENCH_FRAMES; ++frame)
+	{
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glFinish();
+
+		// Mark the camera moved so each frame pays for the upload as well
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		frameContext.MarkViewDirty();
+		frameContext.Update(camera, true, orthoCoords);
+		frameData.view = frameContext.GetView();
+		frameData.projection = frameContext.GetProjection();
+		frameData.viewPosition = glm::vec4(frameContext.GetViewPosition(), 1.0f);
+		frameUniformBuffer.Update(frameData);
+
+		renderQueue.Clear();
+		scene.Enqueue(renderQueue, frameContext.GetView(), frameContext.GetProjection());
+		renderQueue.Flush();
+		queueMilliseconds += ElapsedMilliseconds(start);
+		glFinish();
+	}
+
+	double baselinePerDraw = baselineMilliseconds * 1000.0 / (DRAW_BENCH_FRAMES * DRAW_BENCH_DRAWS);
+	double queuePerDraw = queueMilliseconds * 1000.0 / (DRAW_BENCH_FRAMES * DRAW_BENCH_DRAWS);
+	cout << DRAW_BENCH_DRAWS << " draws, " << DRAW_BENCH_FRAMES << " frames" << endl;
+	cout << "Per-draw uniforms: " << baselineMilliseconds / DRAW_BENCH_FRAMES << " ms per frame, " << baselinePerDraw << " us per draw" << endl;
+	cout << "Frame data and queue: " << queueMilliseconds / DRAW_BENCH_FRAMES << " ms per frame, " << queuePerDraw << " us per draw" << endl;
+	cout << "Speedup: " << baselinePerDraw / queuePerDraw << "x" << endl;
+
+	frameUniformBuffer.Destroy();
+	primitiveCache.Clear();
+	cube.reset();
+	GeometryArena::ReleaseAll();
+	DestroyShaderProgram(baselineProgram);
+	DestroyShaderProgram(frameDataProgram);
+	return true;
+}
@@ -0,0 +1,91 @@
+#include "Bench.h"
+#include "ClusteredLighting.h"
+#include "FrameContext.h"
+#include "LightManager.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+// Light counts swept, the first is the app's own three lights
+const GLuint LIGHT_BENCH_COUNTS[] = { 3, 16, 64, 256, 1024, 4096 };
+const int LIGHT_BENCH_RUNS = 100;
+
+/* Add count point lights at repeatable random spots over the desk */
+/////////////////////////////////////////////////////////////////////
+static void scatterPointLights(LightManager& lightManager, GLuint count)
+{
+	// Fixed seed so runs with the same count are comparable
+	mt19937 generator(330);
+	uniform_real_distribution<float> across(-6.0f, 6.0f);
+	uniform_real_distribution<float> above(0.1f, 2.0f);
+	uniform_real_distribution<float> channel(0.2f, 1.0f);
+
+	count = min(count, MAX_LIGHTS - lightManager.GetCount());
+	for (GLuint i = 0; i < count; ++i)
+	{
+		glm::vec3 position(across(generator), above(generator), across(generator));
+		glm::vec3 color(channel(generator), channel(generator), channel(generator));
+
+		// Small enough that each cluster only sees a few lights, and too many to give each a lamp
+		LightDesc light = LightDesc::Point(position, color, 1.0f, 1.5f);
+		light.gizmoScale = 0.0f;
+		lightManager.Add(light);
+	}
+}
+
+/* Cost of binning the desk's lights into clusters as the light count grows */
+//////////////////////////////////////////////////////////////////////////////
+bool RunLightBenchmark()
+{
+	if (!ClusteredLighting::IsSupported())
+	{
+		cout << "Skipped, clustered lighting needs shader storage buffers" << endl;
+		return true;
+	}
+
+	// The app's starting view
+	const GLint width = 800, height = 600;
+	Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+	FrameContext frameContext;
+	frameContext.SetViewport(width, height);
+	const GLfloat orthoCoords[4] = { 0.0f, 5.0f, 0.0f, 4.0f };
+	frameContext.Update(camera, true, orthoCoords);
+
+	cout << "Clusters " << CLUSTER_GRID_X << "x" << CLUSTER_GRID_Y << "x" << CLUSTER_GRID_Z << ", " << LIGHT_BENCH_RUNS << " binnings per count" << endl;
+	for (size_t c = 0; c < sizeof(LIGHT_BENCH_COUNTS) / sizeof(LIGHT_BENCH_COUNTS[0]); ++c)
+	{
+		// Same key and fill lights as the app, the rest scattered over the desk
+		LightManager lightManager;
+		lightManager.Create();
+		lightManager.Add(LightDesc::Directional(glm::vec3(-0.2f, -1.0f, -0.3f), glm::vec3(1.0f, 1.0f, 1.0f)));
+		const glm::vec3 fillColor(1.0f, 0.97f, 0.61f);
+		lightManager.Add(LightDesc::Point(glm::vec3(7.0f, 1.0f, 0.0f), fillColor, 1.0f, LightRange(1.0f)));
+		lightManager.Add(LightDesc::Point(glm::vec3(0.0f, 1.0f, -7.0f), fillColor, 1.0f, LightRange(1.0f)));
+		scatterPointLights(lightManager, LIGHT_BENCH_COUNTS[c] - lightManager.GetCount());
+		lightManager.Upload();
+
+		ClusteredLighting clusteredLighting;
+		clusteredLighting.Create();
+
+		// Binning and the upload of the cluster lists, as on every view change
+		glFinish();
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (int run = 0; run < LIGHT_BENCH_RUNS; ++run)
+		{
+			clusteredLighting.Update(lightManager, frameContext.GetView(), frameContext.GetProjection(), width, height);
+		}
+		glFinish();
+		double milliseconds = ElapsedMilliseconds(start) / LIGHT_BENCH_RUNS;
+
+		GLuint entries = clusteredLighting.GetIndexCount();
+		cout << lightManager.GetCount() << " lights: " << milliseconds << " ms per binning, " << entries << " cluster entries, "
+			<< (double)entries / CLUSTER_COUNT << " per cluster" << endl;
+
+		clusteredLighting.Destroy();
+		lightManager.Destroy();
+	}
+	return true;
+}
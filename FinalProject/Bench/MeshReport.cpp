@@ -0,0 +1,27 @@
+#include "Bench.h"
+#include "Mesh.h"
+#include "Primitives.h"
+#include "VertexLayout.h"
+
+#include <iostream>
+
+/* Weld and vertex cache results for a dense sphere in the app's vertex layout */
+/* Runs on the CPU only, nothing is uploaded                                   */
+/////////////////////////////////////////////////////////////////////////////////
+bool RunMeshReport()
+{
+	PrimitiveDesc desc = PrimitiveDesc::Sphere(1.0f, 256, 128);
+	PreparedGeometry prepared;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	if (!Mesh::Prepare(VertexLayout::PackedPositionNormalUV(), desc, prepared))
+	{
+		return false;
+	}
+	double milliseconds = ElapsedMilliseconds(start);
+
+	cout << "Sphere 256x128: " << prepared.vertexCount << " vertices, " << prepared.indices.size() / 3 << " triangles, prepared in "
+		<< milliseconds << " ms" << endl;
+	Mesh::PrintReport(prepared);
+	return true;
+}
@@ -0,0 +1,166 @@
+#include "Bench.h"
+#include "GeometryArena.h"
+#include "NormalMatrix.h"
+#include "PrimitiveCache.h"
+#include "ShaderCache.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/transform.hpp>
+
+#include <iostream>
+#include <vector>
+
+#define GLSL(Version, Source) "#version " #Version " core \n" #Source
+
+// A finely tessellated sphere drawn as a grid of small instances, so vertex work dominates
+const int NORMAL_BENCH_SECTORS = 1024;
+const int NORMAL_BENCH_STACKS = 512;
+const GLuint NORMAL_BENCH_GRID = 8;
+const int NORMAL_BENCH_FRAMES = 10;
+
+/* The original object vertex shader: the normal matrix is inverted for every vertex */
+////////////////////////////////////////////////////////////////////////////////////////
+static const char* perVertexShader = GLSL(330,
+	layout(location = 0) in vec3 position;
+	layout(location = 1) in vec3 normal;
+	layout(location = 3) in mat4 instanceModel;
+
+	out vec3 vertexNormal;
+
+	uniform mat4 model;
+	uniform mat4 view;
+	uniform mat4 projection;
+
+	void main()
+	{
+		mat4 world = model * instanceModel;
+		gl_Position = projection * view * world * vec4(position, 1.0f);
+		vertexNormal = mat3(transpose(inverse(world))) * normal;
+	}
+);
+
+/* The current object vertex shader: normal matrices are computed on the CPU */
+////////////////////////////////////////////////////////////////////////////////
+static const char* precomputedVertexShader = GLSL(330,
+	layout(location = 0) in vec3 position;
+	layout(location = 1) in vec3 normal;
+	layout(location = 3) in mat4 instanceModel;
+	layout(location = 7) in mat3 instanceNormalMatrix;
+
+	out vec3 vertexNormal;
+
+	uniform mat4 model;
+	uniform mat3 normalMatrix;
+	uniform mat4 view;
+	uniform mat4 projection;
+
+	void main()
+	{
+		gl_Position = projection * view * model * instanceModel * vec4(position, 1.0f);
+		vertexNormal = normalMatrix * instanceNormalMatrix * normal;
+	}
+);
+
+/* Shows the normal, so neither vertex shader's output is optimized away */
+///////////////////////////////////////////////////////////////////////////
+static const char* normalFragmentShader = GLSL(330,
+	in vec3 vertexNormal;
+
+	out vec4 fragmentColor;
+
+	void main()
+	{
+		fragmentColor = vec4(normalize(vertexNormal) * 0.5f + 0.5f, 1.0f);
+	}
+);
+
+/* Draw every instance of mesh each frame and return the milliseconds per frame, GPU work included */
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+static double timeInstancedDraws(GLuint program, const Mesh& mesh, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection)
+{
+	glUseProgram(program);
+	glUniformMatrix4fv(glGetUniformLocation(program, "model"), 1, GL_FALSE, glm::value_ptr(model));
+	glUniformMatrix3fv(glGetUniformLocation(program, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(NormalMatrix(model)));
+	glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, glm::value_ptr(view));
+	glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+	glBindVertexArray(mesh.GetInstanceVertexArray());
+
+	// One untimed frame so shader compilation and uploads are not measured
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	mesh.DrawBoundInstanced(0);
+	glFinish();
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int frame = 0; frame < NORMAL_BENCH_FRAMES; ++frame)
+	{
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		mesh.DrawBoundInstanced(0);
+	}
+	glFinish();
+	double milliseconds = ElapsedMilliseconds(start) / NORMAL_BENCH_FRAMES;
+
+	glBindVertexArray(0);
+	glUseProgram(0);
+	return milliseconds;
+}
+
+/* Print the vertex rate of one shader */
+////////////////////////////////////////
+static void printRate(const char* name, double vertices, double milliseconds)
+{
+	cout << name << ": " << milliseconds << " ms per frame, " << vertices / (milliseconds / 1000.0) / 1e6 << "M vertices/s" << endl;
+}
+
+/* Vertex throughput of inverting the normal matrix per vertex against precomputed normal matrices */
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+bool RunNormalBenchmark()
+{
+	const GLint width = 800, height = 600;
+
+	GLuint perVertexProgram = 0, precomputedProgram = 0;
+	if (!CreateShaderProgram(perVertexShader, normalFragmentShader, perVertexProgram) ||
+		!CreateShaderProgram(precomputedVertexShader, normalFragmentShader, precomputedProgram))
+	{
+		DestroyShaderProgram(perVertexProgram);
+		DestroyShaderProgram(precomputedProgram);
+		return false;
+	}
+
+	// Float vertices so both shaders read the normal directly
+	PrimitiveCache primitiveCache(VertexLayout::PositionNormalUV());
+	shared_ptr<Mesh> sphere = primitiveCache.Acquire(PrimitiveDesc::Sphere(1.0f, NORMAL_BENCH_SECTORS, NORMAL_BENCH_STACKS));
+
+	// Squashed so the normal matrix differs from the model matrix, and small on screen
+	vector<glm::mat4> instances;
+	for (GLuint i = 0; i < NORMAL_BENCH_GRID * NORMAL_BENCH_GRID; ++i)
+	{
+		glm::vec3 position((float)(i % NORMAL_BENCH_GRID) - NORMAL_BENCH_GRID * 0.5f, (float)(i / NORMAL_BENCH_GRID) - NORMAL_BENCH_GRID * 0.5f, 0.0f);
+		instances.push_back(glm::translate(position) * glm::rotate(glm::radians(10.0f * i), glm::vec3(0.0f, 1.0f, 0.0f)) * glm::scale(glm::vec3(0.1f, 0.2f, 0.1f)));
+	}
+	sphere->SetInstanceTransforms(instances.data(), (GLsizei)instances.size());
+
+	glm::mat4 model = glm::rotate(glm::radians(35.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 20.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (GLfloat)width / (GLfloat)height, 0.1f, 100.0f);
+
+	glViewport(0, 0, width, height);
+	glEnable(GL_DEPTH_TEST);
+
+	double perVertexMilliseconds = timeInstancedDraws(perVertexProgram, *sphere, model, view, projection);
+	double precomputedMilliseconds = timeInstancedDraws(precomputedProgram, *sphere, model, view, projection);
+
+	double vertices = (double)sphere->GetVertexCount() * instances.size();
+	cout << "Sphere " << NORMAL_BENCH_SECTORS << "x" << NORMAL_BENCH_STACKS << ", " << instances.size() << " instances, "
+		<< vertices / 1e6 << "M vertices per frame" << endl;
+	printRate("Inverse per vertex", vertices, perVertexMilliseconds);
+	printRate("Precomputed normal matrix", vertices, precomputedMilliseconds);
+	cout << "Speedup: " << perVertexMilliseconds / precomputedMilliseconds << "x" << endl;
+
+	primitiveCache.Clear();
+	sphere.reset();
+	GeometryArena::ReleaseAll();
+	DestroyShaderProgram(perVertexProgram);
+	DestroyShaderProgram(precomputedProgram);
+	return true;
+}
@@ -0,0 +1,345 @@
+#include "Bench.h"
+#include "Primitives.h"
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Primitive size and how many times each generator runs
+const int PRIMITIVE_BENCH_SECTORS = 1024;
+const int PRIMITIVE_BENCH_STACKS = 512;
+const int PRIMITIVE_BENCH_RUNS = 10;
+
+/* The original sphere generator: trig per vertex, fresh buffers grown with push_back */
+/* Returns the number of vertices generated                                           */
+////////////////////////////////////////////////////////////////////////////////////////
+static GLsizei generateSphereBaseline(float radius, float sectorCount, float stackCount)
+{
+	const float PI = 3.1415926f;
+	float x, y, z, xy;                              // Vertex position
+	float nx, ny, nz, lengthInv = 1.0f / radius;    // Normal
+	float s, t;                                     // Texture coordinate
+
+	float sectorStep = 2 * PI / sectorCount;
+	float stackStep = PI / stackCount;
+	float sectorAngle, stackAngle;
+	vector<GLfloat> vertices;
+	vector<GLuint> indices;
+
+	for (int i = 0; i <= stackCount; ++i)
+	{
+		stackAngle = PI / 2 - i * stackStep;        // Starting from pi/2 to -pi/2
+		xy = radius * cosf(stackAngle);             // r * cos(u)
+		z = radius * sinf(stackAngle);              // r * sin(u)
+
+		for (int j = 0; j <= sectorCount; ++j)
+		{
+			sectorAngle = j * sectorStep;           // Starting from 0 to 2pi
+
+			x = xy * cosf(sectorAngle);             // r * cos(u) * cos(v)
+			y = xy * sinf(sectorAngle);             // r * cos(u) * sin(v)
+			vertices.push_back(x);
+			vertices.push_back(y);
+			vertices.push_back(z);
+
+			nx = x * lengthInv;
+			ny = y * lengthInv;
+			nz = z * lengthInv;
+			vertices.push_back(nx);
+			vertices.push_back(ny);
+			vertices.push_back(nz);
+
+			s = (float)j / sectorCount;
+			t = (float)i / stackCount;
+			vertices.push_back(s);
+			vertices.push_back(t);
+		}
+	}
+
+	int k1, k2;
+	for (int i = 0; i < stackCount; ++i)
+	{
+		k1 = i * (sectorCount + 1);     // Beginning of current stack
+		k2 = k1 + sectorCount + 1;      // Beginning of next stack
+
+		for (int j = 0; j < sectorCount; ++j, ++k1, ++k2)
+		{
+			if (i != 0)
+			{
+				indices.push_back(k1);
+				indices.push_back(k2);
+				indices.push_back(k1 + 1);
+			}
+
+			if (i != (stackCount - 1))
+			{
+				indices.push_back(k1 + 1);
+				indices.push_back(k2);
+				indices.push_back(k2 + 1);
+			}
+		}
+	}
+
+	return (GLsizei)(vertices.size() / PRIMITIVE_FLOATS_PER_VERTEX);
+}
+
+/* The original unit circle of the cylinder generator */
+////////////////////////////////////////////////////////
+static vector<GLfloat> getUnitCircleVertices(float sectorStep, float sectorCount)
+{
+	float sectorAngle;
+	vector<GLfloat> unitVerts;
+
+	// Get vertices of unit circle
+	for (int i = 0; i <= sectorCount; ++i)
+	{
+		sectorAngle = i * sectorStep;
+		unitVerts.push_back(cos(sectorAngle)); // x
+		unitVerts.push_back(sin(sectorAngle)); // y
+		unitVerts.push_back(0);                // z
+	}
+
+	return unitVerts;
+}
+
+/* The original side normals of the cylinder generator */
+/////////////////////////////////////////////////////////
+static vector<GLfloat> getCylinderNormals(float sectorStep, float sectorCount, float zAngle)
+{
+	float sectorAngle;
+
+	// Compute the normal vector at 0 degree first
+	float x0 = cos(zAngle);
+	float y0 = 0;
+	float z0 = sin(zAngle);
+
+	// Rotate (x0, y0, z0) per sector angle
+	vector<GLfloat> norms;
+	for (int i = 0; i <= sectorCount; ++i)
+	{
+		sectorAngle = i * sectorStep;
+		norms.push_back(cos(sectorAngle) * x0 - sin(sectorAngle) * y0);   // nx
+		norms.push_back(sin(sectorAngle) * x0 + cos(sectorAngle) * y0);   // ny
+		norms.push_back(z0);  // nz
+	}
+
+	return norms;
+}
+
+/* The original cylinder indices: two triangles per side quad, a fan per cap */
+///////////////////////////////////////////////////////////////////////////////
+static vector<GLuint> getCylinderIndices(float stackCount, float sectorCount, int baseVertexIndex, int topVertexIndex)
+{
+	vector<GLuint> idx;
+	GLuint k1, k2;
+	// Get indices for sides
+	for (int i = 0; i < stackCount; ++i)
+	{
+		k1 = i * (sectorCount + 1);     // Beginning of current stack
+		k2 = k1 + sectorCount + 1;      // Beginning of next stack
+
+		for (int j = 0; j < sectorCount; ++j, ++k1, ++k2)
+		{
+			// 2 triangles
+			idx.push_back(k1);
+			idx.push_back(k1 + 1);
+			idx.push_back(k2);
+
+			idx.push_back(k2);
+			idx.push_back(k1 + 1);
+			idx.push_back(k2 + 1);
+		}
+	}
+
+	// Get indices for base
+	for (int i = 0, k = baseVertexIndex + 1; i < sectorCount; ++i, ++k)
+	{
+		if (i < (sectorCount - 1))
+		{
+			idx.push_back(baseVertexIndex);
+			idx.push_back(k + 1);
+			idx.push_back(k);
+		}
+		else // Last triangle
+		{
+			idx.push_back(baseVertexIndex);
+			idx.push_back(baseVertexIndex + 1);
+			idx.push_back(k);
+		}
+	}
+
+	// Get indices for top
+	for (int i = 0, k = topVertexIndex + 1; i < sectorCount; ++i, ++k)
+	{
+		if (i < (sectorCount - 1))
+		{
+			idx.push_back(topVertexIndex);
+			idx.push_back(k);
+			idx.push_back(k + 1);
+		}
+		else
+		{
+			idx.push_back(topVertexIndex);
+			idx.push_back(k);
+			idx.push_back(topVertexIndex + 1);
+		}
+	}
+
+	return idx;
+}
+
+/* The original cylinder generator: a trig table per call, fresh buffers grown with push_back */
+/* Returns the number of vertices generated                                                   */
+////////////////////////////////////////////////////////////////////////////////////////////////
+static GLsizei generateCylinderBaseline(float baseRadius, float topRadius, float sectorCount, float height, float stackCount)
+{
+	const float PI = 3.1415926f;
+	float sectorStep = 2 * PI / sectorCount;
+	vector<GLfloat> vertices;
+	GLfloat x, y, z, radius;
+
+	vector<GLfloat> unitVertices = getUnitCircleVertices(sectorStep, sectorCount);
+
+	// Compute the normal vector at 0 degree first
+	float zAngle = atan2(baseRadius - topRadius, height);
+	vector<GLfloat> normals = getCylinderNormals(sectorStep, sectorCount, zAngle);
+
+	// Get vertices of cylinder sides
+	for (int i = 0; i <= stackCount; ++i)
+	{
+		z = -(height * 0.5f) + (float)i / stackCount * height;      // Vertex position z
+		radius = baseRadius + (float)i / stackCount * (topRadius - baseRadius); // Keep track of radius for different base sizes
+		float t = 1.0f - (float)i / stackCount;   // Top to bottom
+
+		for (int j = 0, k = 0; j <= sectorCount; ++j, k += 3)
+		{
+			x = unitVertices[k];
+			y = unitVertices[k + 1];
+			// Vertex coordinates
+			vertices.push_back(x * radius);
+			vertices.push_back(y * radius);
+			vertices.push_back(z);
+			// Normals
+			vertices.push_back(normals[k]);
+			vertices.push_back(normals[k + 1]);
+			vertices.push_back(normals[k + 2]);
+			// Texture coordinates
+			vertices.push_back((float)j / sectorCount);
+			vertices.push_back(t);
+		}
+	}
+
+	// Keep track of where the base vertices start, used for indices
+	unsigned int baseVertexIndex = (unsigned int)vertices.size() / 8;
+
+	// Center and rim of the base
+	z = -height * 0.5f;
+	vertices.push_back(0);
+	vertices.push_back(0);
+	vertices.push_back(z);
+	vertices.push_back(0);
+	vertices.push_back(0);
+	vertices.push_back(-1);
+	vertices.push_back(0.5f);
+	vertices.push_back(0.5f);
+	for (int i = 0, j = 0; i < sectorCount; ++i, j += 3)
+	{
+		x = unitVertices[j];
+		y = unitVertices[j + 1];
+		vertices.push_back(x * baseRadius);
+		vertices.push_back(y * baseRadius);
+		vertices.push_back(z);
+		vertices.push_back(0);
+		vertices.push_back(0);
+		vertices.push_back(-1);
+		vertices.push_back(-x * 0.5f + 0.5f);
+		vertices.push_back(-y * 0.5f + 0.5f);
+	}
+
+	// Keep track of where the top vertices start, used for indices
+	unsigned int topVertexIndex = (unsigned int)vertices.size() / 8;
+
+	// Center and rim of the top
+	z = height * 0.5f;
+	vertices.push_back(0);
+	vertices.push_back(0);
+	vertices.push_back(z);
+	vertices.push_back(0);
+	vertices.push_back(0);
+	vertices.push_back(1);
+	vertices.push_back(0.5f);
+	vertices.push_back(0.5f);
+	for (int i = 0, j = 0; i < sectorCount; ++i, j += 3)
+	{
+		x = unitVertices[j];
+		y = unitVertices[j + 1];
+		vertices.push_back(x * topRadius);
+		vertices.push_back(y * topRadius);
+		vertices.push_back(z);
+		vertices.push_back(0);
+		vertices.push_back(0);
+		vertices.push_back(1);
+		vertices.push_back(x * 0.5f + 0.5f);
+		vertices.push_back(-y * 0.5f + 0.5f);
+	}
+
+	vector<GLuint> indices = getCylinderIndices(stackCount, sectorCount, baseVertexIndex, topVertexIndex);
+
+	return (GLsizei)(vertices.size() / PRIMITIVE_FLOATS_PER_VERTEX);
+}
+
+/* Print the vertex rate of one generator */
+////////////////////////////////////////////
+static void printRate(const char* name, GLsizei vertexCount, double milliseconds)
+{
+	double verticesPerSecond = (double)vertexCount * PRIMITIVE_BENCH_RUNS / (milliseconds / 1000.0);
+	cout << name << ": " << milliseconds / PRIMITIVE_BENCH_RUNS << " ms per mesh, " << verticesPerSecond / 1e6 << "M vertices/s" << endl;
+}
+
+/* Vertices per second of the original generators against the trig table generators */
+//////////////////////////////////////////////////////////////////////////////////////
+bool RunPrimitiveBenchmark()
+{
+	MeshData data;
+
+	// Each baseline run starts from empty vectors, as the original generators did
+	GLsizei baselineSphereVertices = 0;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int run = 0; run < PRIMITIVE_BENCH_RUNS; ++run)
+	{
+		baselineSphereVertices = generateSphereBaseline(1.0f, (float)PRIMITIVE_BENCH_SECTORS, (float)PRIMITIVE_BENCH_STACKS);
+	}
+	double baselineSphereMilliseconds = ElapsedMilliseconds(start);
+
+	GLsizei baselineCylinderVertices = 0;
+	start = chrono::steady_clock::now();
+	for (int run = 0; run < PRIMITIVE_BENCH_RUNS; ++run)
+	{
+		baselineCylinderVertices = generateCylinderBaseline(1.0f, 0.5f, (float)PRIMITIVE_BENCH_SECTORS, 2.0f, (float)PRIMITIVE_BENCH_STACKS);
+	}
+	double baselineCylinderMilliseconds = ElapsedMilliseconds(start);
+
+	PrimitiveDesc sphere = PrimitiveDesc::Sphere(1.0f, PRIMITIVE_BENCH_SECTORS, PRIMITIVE_BENCH_STACKS);
+	start = chrono::steady_clock::now();
+	for (int run = 0; run < PRIMITIVE_BENCH_RUNS; ++run)
+	{
+		GeneratePrimitive(sphere, data);
+	}
+	double sphereMilliseconds = ElapsedMilliseconds(start);
+	GLsizei sphereVertices = data.GetVertexCount();
+
+	PrimitiveDesc cylinder = PrimitiveDesc::Cylinder(1.0f, 0.5f, PRIMITIVE_BENCH_SECTORS, 2.0f, PRIMITIVE_BENCH_STACKS);
+	start = chrono::steady_clock::now();
+	for (int run = 0; run < PRIMITIVE_BENCH_RUNS; ++run)
+	{
+		GeneratePrimitive(cylinder, data);
+	}
+	double cylinderMilliseconds = ElapsedMilliseconds(start);
+
+	cout << "Sphere and cylinder " << PRIMITIVE_BENCH_SECTORS << "x" << PRIMITIVE_BENCH_STACKS << ", " << PRIMITIVE_BENCH_RUNS << " runs each" << endl;
+	printRate("Original sphere", baselineSphereVertices, baselineSphereMilliseconds);
+	printRate("Sphere", sphereVertices, sphereMilliseconds);
+	printRate("Original cylinder", baselineCylinderVertices, baselineCylinderMilliseconds);
+	printRate("Cylinder", data.GetVertexCount(), cylinderMilliseconds);
+	return true;
+}
@@ -0,0 +1,98 @@
+#include "Bench.h"
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+/* One benchmark the runner can select by name */
+/////////////////////////////////////////////////
+struct Benchmark
+{
+	const char* name;
+	bool (*run)();
+	bool needsContext; // Runs against a hidden OpenGL window
+};
+
+static const Benchmark BENCHMARKS[] =
+{
+	{ "draw", RunDrawBenchmark, true },
+	{ "lights", RunLightBenchmark, true },
+	{ "mesh", RunMeshReport, false },
+	{ "normals", RunNormalBenchmark, true },
+	{ "primitives", RunPrimitiveBenchmark, false },
+};
+
+/* Create a hidden window whose context the GL benchmarks draw with */
+//////////////////////////////////////////////////////////////////////
+static GLFWwindow* createContext()
+{
+	if (!glfwInit())
+	{
+		return NULL;
+	}
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	GLFWwindow* window = glfwCreateWindow(800, 600, "Bench", NULL, NULL);
+	if (window == NULL)
+	{
+		glfwTerminate();
+		return NULL;
+	}
+	glfwMakeContextCurrent(window);
+
+	glewExperimental = GL_TRUE;
+	if (glewInit() != GLEW_OK)
+	{
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return NULL;
+	}
+	return window;
+}
+
+/* Run every benchmark, or only the ones named on the command line */
+/////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[])
+{
+	GLFWwindow* window = NULL;
+	bool failed = false;
+
+	for (size_t b = 0; b < sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]); ++b)
+	{
+		const Benchmark& benchmark = BENCHMARKS[b];
+		bool selected = argc == 1;
+		for (int i = 1; i < argc; ++i)
+		{
+			selected = selected || strcmp(argv[i], benchmark.name) == 0;
+		}
+		if (!selected)
+		{
+			continue;
+		}
+
+		cout << "== " << benchmark.name << endl;
+		if (benchmark.needsContext && window == NULL && (window = createContext()) == NULL)
+		{
+			cout << "Skipped, no OpenGL context" << endl;
+			continue;
+		}
+		failed = !benchmark.run() || failed;
+	}
+
+	if (window != NULL)
+	{
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
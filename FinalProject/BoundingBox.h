@@ -0,0 +1,11 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+/* Axis aligned box, minimum and maximum corner */
+//////////////////////////////////////////////////
+struct BoundingBox
+{
+	glm::vec3 minimum;
+	glm::vec3 maximum;
+};
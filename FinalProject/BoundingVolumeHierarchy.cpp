@@ -0,0 +1,502 @@
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+/* Surface area of a box, the chance a random ray hits it is proportional to it */
+//////////////////////////////////////////////////////////////////////////////////
+static float surfaceArea(const glm::vec3& minimum, const glm::vec3& maximum)
+{
+	glm::vec3 extent = maximum - minimum;
+	return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+/* Where a box lies relative to the frustum */
+//////////////////////////////////////////////
+enum FrustumSide
+{
+	FRUSTUM_OUTSIDE,
+	FRUSTUM_INTERSECTS,
+	FRUSTUM_INSIDE
+};
+
+/* Test a box against six inward facing planes */
+/////////////////////////////////////////////////
+static FrustumSide classifyBox(const glm::vec4 planes[6], const glm::vec3& minimum, const glm::vec3& maximum)
+{
+	glm::vec3 center = (minimum + maximum) * 0.5f;
+	glm::vec3 extent = (maximum - minimum) * 0.5f;
+	bool inside = true;
+
+	for (int i = 0; i < 6; ++i)
+	{
+		glm::vec3 normal(planes[i]);
+		float distance = glm::dot(normal, center) + planes[i].w;
+		float radius = glm::dot(glm::abs(normal), extent);
+
+		if (distance + radius < 0.0f)
+		{
+			return FRUSTUM_OUTSIDE;
+		}
+		if (distance - radius < 0.0f)
+		{
+			inside = false;
+		}
+	}
+
+	return inside ? FRUSTUM_INSIDE : FRUSTUM_INTERSECTS;
+}
+
+/* Slab test, entry is the distance the ray enters the box, 0 when it starts inside */
+///////////////////////////////////////////////////////////////////////////////////////
+static bool intersectBox(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& minimum, const glm::vec3& maximum,
+	float maxDistance, float& entry)
+{
+	glm::vec3 t1 = (minimum - origin) * inverseDirection;
+	glm::vec3 t2 = (maximum - origin) * inverseDirection;
+	glm::vec3 entries = glm::min(t1, t2);
+	glm::vec3 exits = glm::max(t1, t2);
+
+	entry = max(max(entries.x, entries.y), max(entries.z, 0.0f));
+	float exit = min(min(exits.x, exits.y), min(exits.z, maxDistance));
+	return entry <= exit;
+}
+
+/* Constructor */
+/////////////////
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+{
+	depth = 0;
+	buildMilliseconds = 0.0;
+}
+
+/* Build the tree top down, splitting each range where the binned surface area heuristic is cheapest */
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+void BoundingVolumeHierarchy::Build(const vector<BoundingBox>& bounds)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	Clear();
+	if (bounds.empty())
+	{
+		return;
+	}
+
+	uint32_t count = (uint32_t)bounds.size();
+	boxes = bounds;
+
+	primitiveIndices.resize(count);
+	centroids.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		primitiveIndices[i] = i;
+		centroids[i] = (bounds[i].minimum + bounds[i].maximum) * 0.5f;
+	}
+
+	// A binary tree with leaves of at least one primitive has fewer than 2n nodes
+	nodes.reserve(2 * count);
+	parents.reserve(2 * count);
+	leafOfPrimitive.resize(count);
+
+	buildNode(0, count, 0, 1);
+
+	vector<glm::vec3>().swap(centroids);
+
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	buildMilliseconds = elapsed.count();
+}
+
+/* Remove every node and primitive */
+/////////////////////////////////////
+void BoundingVolumeHierarchy::Clear()
+{
+	nodes.clear();
+	primitiveIndices.clear();
+	boxes.clear();
+	centroids.clear();
+	parents.clear();
+	leafOfPrimitive.clear();
+	depth = 0;
+	buildMilliseconds = 0.0;
+}
+
+/* Build the node for primitiveIndices[begin, end) and its subtree, returns its index */
+/////////////////////////////////////////////////////////////////////////////////////////
+uint32_t BoundingVolumeHierarchy::buildNode(uint32_t begin, uint32_t end, uint32_t parent, uint32_t level)
+{
+	uint32_t index = (uint32_t)nodes.size();
+	nodes.push_back(BvhNode());
+	parents.push_back(parent);
+	depth = max(depth, level);
+
+	// Bounds of the boxes and of their centroids
+	glm::vec3 minimum = boxes[primitiveIndices[begin]].minimum;
+	glm::vec3 maximum = boxes[primitiveIndices[begin]].maximum;
+	glm::vec3 centroidMinimum = centroids[primitiveIndices[begin]];
+	glm::vec3 centroidMaximum = centroidMinimum;
+	for (uint32_t i = begin + 1; i < end; ++i)
+	{
+		uint32_t primitive = primitiveIndices[i];
+		minimum = glm::min(minimum, boxes[primitive].minimum);
+		maximum = glm::max(maximum, boxes[primitive].maximum);
+		centroidMinimum = glm::min(centroidMinimum, centroids[primitive]);
+		centroidMaximum = glm::max(centroidMaximum, centroids[primitive]);
+	}
+	nodes[index].minimum = minimum;
+	nodes[index].maximum = maximum;
+
+	uint32_t count = end - begin;
+
+	// Cheapest split over every axis, cost is primitives times surface area on each side
+	float bestCost = numeric_limits<float>::max();
+	int bestAxis = -1;
+	int bestSplit = 0;
+
+	for (int axis = 0; axis < 3 && count > 1; ++axis)
+	{
+		float extent = centroidMaximum[axis] - centroidMinimum[axis];
+		if (extent <= 0.0f)
+		{
+			continue;
+		}
+
+		uint32_t binCounts[BVH_BIN_COUNT] = {};
+		glm::vec3 binMinimum[BVH_BIN_COUNT], binMaximum[BVH_BIN_COUNT];
+		float scale = BVH_BIN_COUNT / extent;
+
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			uint32_t primitive = primitiveIndices[i];
+			int bin = min((int)((centroids[primitive][axis] - centroidMinimum[axis]) * scale), BVH_BIN_COUNT - 1);
+
+			binMinimum[bin] = binCounts[bin] == 0 ? boxes[primitive].minimum : glm::min(binMinimum[bin], boxes[primitive].minimum);
+			binMaximum[bin] = binCounts[bin] == 0 ? boxes[primitive].maximum : glm::max(binMaximum[bin], boxes[primitive].maximum);
+			++binCounts[bin];
+		}
+
+		// Sweep from the right to know the cost of every right side, then from the left
+		float rightCosts[BVH_BIN_COUNT];
+		uint32_t rightCount = 0;
+		glm::vec3 rightMinimum(0.0f), rightMaximum(0.0f);
+		for (int bin = BVH_BIN_COUNT - 1; bin > 0; --bin)
+		{
+			if (binCounts[bin] > 0)
+			{
+				rightMinimum = rightCount == 0 ? binMinimum[bin] : glm::min(rightMinimum, binMinimum[bin]);
+				rightMaximum = rightCount == 0 ? binMaximum[bin] : glm::max(rightMaximum, binMaximum[bin]);
+				rightCount += binCounts[bin];
+			}
+			rightCosts[bin] = rightCount * (rightCount > 0 ? surfaceArea(rightMinimum, rightMaximum) : 0.0f);
+		}
+
+		uint32_t leftCount = 0;
+		glm::vec3 leftMinimum(0.0f), leftMaximum(0.0f);
+		for (int split = 1; split < BVH_BIN_COUNT; ++split)
+		{
+			int bin = split - 1;
+			if (binCounts[bin] > 0)
+			{
+				leftMinimum = leftCount == 0 ? binMinimum[bin] : glm::min(leftMinimum, binMinimum[bin]);
+				leftMaximum = leftCount == 0 ? binMaximum[bin] : glm::max(leftMaximum, binMaximum[bin]);
+				leftCount += binCounts[bin];
+			}
+			if (leftCount == 0 || leftCount == count)
+			{
+				continue;
+			}
+
+			float cost = leftCount * surfaceArea(leftMinimum, leftMaximum) + rightCosts[split];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	// Stay a leaf when splitting costs more than testing every primitive, or the range cannot be split
+	float area = surfaceArea(minimum, maximum);
+	float leafCost = count * area;
+	bestCost += BVH_TRAVERSAL_COST * area;
+	bool leaf = count == 1 || level >= BVH_MAX_DEPTH || (count <= BVH_MAX_LEAF_SIZE && (bestAxis < 0 || bestCost >= leafCost));
+
+	// Identical centroids cannot be binned, they are halved in place
+	uint32_t middle = begin + count / 2;
+	if (!leaf && bestAxis >= 0)
+	{
+		float scale = BVH_BIN_COUNT / (centroidMaximum[bestAxis] - centroidMinimum[bestAxis]);
+		float axisMinimum = centroidMinimum[bestAxis];
+		const vector<glm::vec3>& centers = centroids;
+		uint32_t* split = partition(primitiveIndices.data() + begin, primitiveIndices.data() + end, [&](uint32_t primitive)
+			{
+				return min((int)((centers[primitive][bestAxis] - axisMinimum) * scale), BVH_BIN_COUNT - 1) < bestSplit;
+			});
+		middle = (uint32_t)(split - primitiveIndices.data());
+	}
+
+	if (leaf)
+	{
+		nodes[index].rightOrFirst = begin;
+		nodes[index].count = count;
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			leafOfPrimitive[primitiveIndices[i]] = index;
+		}
+		return index;
+	}
+
+	buildNode(begin, middle, index, level + 1);
+	uint32_t right = buildNode(middle, end, index, level + 1);
+	nodes[index].rightOrFirst = right;
+	nodes[index].count = 0;
+	return index;
+}
+
+/* Move a primitive and refit every node from its leaf up to the root */
+/////////////////////////////////////////////////////////////////////////
+void BoundingVolumeHierarchy::Refit(uint32_t primitive, const BoundingBox& bounds)
+{
+	boxes[primitive] = bounds;
+
+	uint32_t node = leafOfPrimitive[primitive];
+	while (true)
+	{
+		refitNode(node);
+		if (node == 0)
+		{
+			break;
+		}
+		node = parents[node];
+	}
+}
+
+/* Recompute a node's box from its primitives or children */
+/////////////////////////////////////////////////////////////
+void BoundingVolumeHierarchy::refitNode(uint32_t node)
+{
+	BvhNode& current = nodes[node];
+
+	if (current.count > 0)
+	{
+		const BoundingBox& first = boxes[primitiveIndices[current.rightOrFirst]];
+		current.minimum = first.minimum;
+		current.maximum = first.maximum;
+		for (uint32_t i = 1; i < current.count; ++i)
+		{
+			const BoundingBox& box = boxes[primitiveIndices[current.rightOrFirst + i]];
+			current.minimum = glm::min(current.minimum, box.minimum);
+			current.maximum = glm::max(current.maximum, box.maximum);
+		}
+	}
+	else
+	{
+		const BvhNode& left = nodes[node + 1];
+		const BvhNode& right = nodes[current.rightOrFirst];
+		current.minimum = glm::min(left.minimum, right.minimum);
+		current.maximum = glm::max(left.maximum, right.maximum);
+	}
+}
+
+/* Collect every primitive inside or crossing the frustum                  */
+/* Subtrees entirely inside are taken without testing their primitives     */
+/////////////////////////////////////////////////////////////////////////////
+void BoundingVolumeHierarchy::QueryFrustum(const glm::vec4 planes[6], vector<uint32_t>& primitives) const
+{
+	primitives.clear();
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	uint32_t stack[BVH_MAX_DEPTH + 1];
+	bool stackInside[BVH_MAX_DEPTH + 1];
+	uint32_t size = 0;
+
+	stack[size] = 0;
+	stackInside[size++] = false;
+
+	while (size > 0)
+	{
+		--size;
+		const BvhNode& node = nodes[stack[size]];
+		bool inside = stackInside[size];
+
+		if (!inside)
+		{
+			FrustumSide side = classifyBox(planes, node.minimum, node.maximum);
+			if (side == FRUSTUM_OUTSIDE)
+			{
+				continue;
+			}
+			inside = side == FRUSTUM_INSIDE;
+		}
+
+		if (node.count > 0)
+		{
+			for (uint32_t i = 0; i < node.count; ++i)
+			{
+				uint32_t primitive = primitiveIndices[node.rightOrFirst + i];
+				if (inside || node.count == 1 || classifyBox(planes, boxes[primitive].minimum, boxes[primitive].maximum) != FRUSTUM_OUTSIDE)
+				{
+					primitives.push_back(primitive);
+				}
+			}
+			continue;
+		}
+
+		uint32_t nodeIndex = (uint32_t)(&node - nodes.data());
+		stack[size] = node.rightOrFirst;
+		stackInside[size++] = inside;
+		stack[size] = nodeIndex + 1;
+		stackInside[size++] = inside;
+	}
+}
+
+/* Find the nearest primitive box along a ray, children are visited nearest first */
+/////////////////////////////////////////////////////////////////////////////////////
+bool BoundingVolumeHierarchy::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t& primitive, float& distance) const
+{
+	if (nodes.empty())
+	{
+		return false;
+	}
+
+	// Axis parallel rays get a huge inverse instead of a division by zero
+	glm::vec3 inverseDirection;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float component = direction[axis];
+		inverseDirection[axis] = fabs(component) > 1e-20f ? 1.0f / component : (component < 0.0f ? -1e30f : 1e30f);
+	}
+
+	float nearest = maxDistance;
+	bool hit = false;
+
+	uint32_t stack[BVH_MAX_DEPTH + 1];
+	uint32_t size = 0;
+
+	float entry;
+	if (!intersectBox(origin, inverseDirection, nodes[0].minimum, nodes[0].maximum, nearest, entry))
+	{
+		return false;
+	}
+	stack[size++] = 0;
+
+	while (size > 0)
+	{
+		uint32_t nodeIndex = stack[--size];
+		const BvhNode& node = nodes[nodeIndex];
+
+		// The node may have been entered before a nearer hit was found
+		if (!intersectBox(origin, inverseDirection, node.minimum, node.maximum, nearest, entry))
+		{
+			continue;
+		}
+
+		if (node.count > 0)
+		{
+			for (uint32_t i = 0; i < node.count; ++i)
+			{
+				uint32_t candidate = primitiveIndices[node.rightOrFirst + i];
+				if (intersectBox(origin, inverseDirection, boxes[candidate].minimum, boxes[candidate].maximum, nearest, entry) && (!hit || entry < nearest))
+				{
+					nearest = entry;
+					primitive = candidate;
+					hit = true;
+				}
+			}
+			continue;
+		}
+
+		// Push the farther child first so the nearer one is visited next
+		uint32_t left = nodeIndex + 1;
+		uint32_t right = node.rightOrFirst;
+		float leftEntry, rightEntry;
+		bool hitLeft = intersectBox(origin, inverseDirection, nodes[left].minimum, nodes[left].maximum, nearest, leftEntry);
+		bool hitRight = intersectBox(origin, inverseDirection, nodes[right].minimum, nodes[right].maximum, nearest, rightEntry);
+
+		if (hitLeft && hitRight)
+		{
+			bool leftFirst = leftEntry <= rightEntry;
+			stack[size++] = leftFirst ? right : left;
+			stack[size++] = leftFirst ? left : right;
+		}
+		else if (hitLeft)
+		{
+			stack[size++] = left;
+		}
+		else if (hitRight)
+		{
+			stack[size++] = right;
+		}
+	}
+
+	distance = nearest;
+	return hit;
+}
+
+/* Get the number of primitives in the tree */
+//////////////////////////////////////////////
+uint32_t BoundingVolumeHierarchy::GetPrimitiveCount() const
+{
+	return (uint32_t)boxes.size();
+}
+
+/* Check whether the tree has been built from any primitive */
+///////////////////////////////////////////////////////////////
+bool BoundingVolumeHierarchy::IsEmpty() const
+{
+	return nodes.empty();
+}
+
+/* Count nodes and leaves and estimate the cost of a random query relative to testing the root */
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BvhStats BoundingVolumeHierarchy::GetStats() const
+{
+	BvhStats stats;
+	stats.nodeCount = (uint32_t)nodes.size();
+	stats.leafCount = 0;
+	stats.depth = depth;
+	stats.sahCost = 0.0f;
+	stats.buildMilliseconds = buildMilliseconds;
+
+	if (nodes.empty())
+	{
+		return stats;
+	}
+
+	float rootArea = surfaceArea(nodes[0].minimum, nodes[0].maximum);
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		float area = rootArea > 0.0f ? surfaceArea(nodes[i].minimum, nodes[i].maximum) / rootArea : 1.0f;
+		if (nodes[i].count > 0)
+		{
+			++stats.leafCount;
+			stats.sahCost += area * nodes[i].count;
+		}
+		else
+		{
+			stats.sahCost += area * BVH_TRAVERSAL_COST;
+		}
+	}
+
+	return stats;
+}
+
+/* Print the shape and build time of the tree */
+////////////////////////////////////////////////
+void BoundingVolumeHierarchy::PrintStats() const
+{
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	BvhStats stats = GetStats();
+	cout << "BVH: " << boxes.size() << " primitives, " << stats.nodeCount << " nodes, " << stats.leafCount << " leaves, depth " << stats.depth
+		<< ", SAH cost " << stats.sahCost << ", built in " << stats.buildMilliseconds << " ms" << endl;
+}
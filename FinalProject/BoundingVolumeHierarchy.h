@@ -0,0 +1,83 @@
+#pragma once
+
+#include "BoundingBox.h"
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Most primitives a leaf holds, and the bins tried per axis when splitting
+const uint32_t BVH_MAX_LEAF_SIZE = 4;
+const int BVH_BIN_COUNT = 16;
+
+// Cost of visiting an inner node relative to testing one primitive box
+const float BVH_TRAVERSAL_COST = 1.0f;
+
+// Ranges still unsplit at this depth become one leaf, bounds the traversal stacks
+const uint32_t BVH_MAX_DEPTH = 64;
+
+/* One node of the flattened tree, 32 bytes                               */
+/* The left child directly follows its parent, count is 0 for inner nodes */
+////////////////////////////////////////////////////////////////////////////
+struct BvhNode
+{
+	glm::vec3 minimum;
+	uint32_t rightOrFirst; // Right child of an inner node, first primitive of a leaf
+	glm::vec3 maximum;
+	uint32_t count;        // Primitives in a leaf
+};
+
+/* Shape and build cost of a hierarchy */
+/////////////////////////////////////////
+struct BvhStats
+{
+	uint32_t nodeCount;
+	uint32_t leafCount;
+	uint32_t depth;
+	float sahCost;
+	double buildMilliseconds;
+};
+
+/* Surface area heuristic hierarchy over primitive bounds, uses no GL      */
+/* Primitives are referred to by their index in the bounds passed to Build */
+/////////////////////////////////////////////////////////////////////////////
+class BoundingVolumeHierarchy
+{
+public:
+	BoundingVolumeHierarchy();
+
+	void Build(const vector<BoundingBox>& bounds);
+	void Clear();
+
+	// Move one primitive and grow or shrink its ancestors, the tree shape is kept
+	void Refit(uint32_t primitive, const BoundingBox& bounds);
+
+	// Primitives whose box touches the frustum, planes as from ExtractFrustumPlanes
+	void QueryFrustum(const glm::vec4 planes[6], vector<uint32_t>& primitives) const;
+
+	// Nearest primitive box hit by a ray within maxDistance
+	bool Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t& primitive, float& distance) const;
+
+	uint32_t GetPrimitiveCount() const;
+	bool IsEmpty() const;
+	BvhStats GetStats() const;
+	void PrintStats() const;
+
+private:
+	uint32_t buildNode(uint32_t begin, uint32_t end, uint32_t parent, uint32_t level);
+	void refitNode(uint32_t node);
+
+	vector<BvhNode> nodes;
+	vector<uint32_t> primitiveIndices; // Leaf ranges index into this
+	vector<BoundingBox> boxes;
+	vector<glm::vec3> centroids;       // Only used while building
+
+	// Refit walks from a primitive's leaf to the root
+	vector<uint32_t> parents;
+	vector<uint32_t> leafOfPrimitive;
+
+	uint32_t depth;
+	double buildMilliseconds;
+};
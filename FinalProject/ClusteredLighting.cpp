@@ -0,0 +1,251 @@
+#include "ClusteredLighting.h"
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+/* Tile of a normalized device coordinate, clamped to the grid */
+/////////////////////////////////////////////////////////////////
+static GLuint tileOf(float ndc, GLuint tileCount)
+{
+	int tile = (int)floor((ndc * 0.5f + 0.5f) * tileCount);
+	return (GLuint)min(max(tile, 0), (int)tileCount - 1);
+}
+
+/* Constructor */
+/////////////////
+ClusteredLighting::ClusteredLighting()
+{
+	gridBuffer = 0;
+	indexBuffer = 0;
+	indexCapacity = 0;
+
+	nearDepth = CLUSTER_MIN_DEPTH;
+	farDepth = 1.0f;
+	header.scale = glm::vec4(0.0f);
+	header.size[0] = CLUSTER_GRID_X;
+	header.size[1] = CLUSTER_GRID_Y;
+	header.size[2] = CLUSTER_GRID_Z;
+	header.size[3] = 0;
+
+	cells.resize(CLUSTER_COUNT * 2, 0);
+}
+
+/* Check for shader storage buffers */
+//////////////////////////////////////
+bool ClusteredLighting::IsSupported()
+{
+	return GLEW_ARB_shader_storage_buffer_object != 0;
+}
+
+/* Allocate both buffers and bind them to their binding points */
+/////////////////////////////////////////////////////////////////
+void ClusteredLighting::Create()
+{
+	Destroy();
+
+	// Index list starts with room for one light per cluster and grows as needed
+	indexCapacity = CLUSTER_COUNT;
+
+	glGenBuffers(1, &gridBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, gridBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(ClusterGridHeader) + sizeof(GLuint) * cells.size(), NULL, GL_DYNAMIC_DRAW);
+
+	glGenBuffers(1, &indexBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * indexCapacity, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	// Reallocating keeps the buffer names, so the bindings only need setting once
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_GRID_BINDING, gridBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_INDEX_BINDING, indexBuffer);
+}
+
+/* Bin every light into the clusters of this view and upload the lists */
+/////////////////////////////////////////////////////////////////////////
+void ClusteredLighting::Update(const LightManager& lights, const glm::mat4& view, const glm::mat4& projection, GLint viewportWidth, GLint viewportHeight)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	// Recover the depth range, perspective and orthographic projections store it differently
+	float a = projection[2][2], b = projection[3][2];
+	bool perspective = projection[3][3] == 0.0f;
+	float nearPlane = perspective ? b / (a - 1.0f) : (b + 1.0f) / a;
+	float farPlane = perspective ? b / (a + 1.0f) : (b - 1.0f) / a;
+	nearDepth = max(nearPlane, CLUSTER_MIN_DEPTH);
+	farDepth = max(farPlane, nearDepth * 2.0f);
+
+	// Slice = log(depth / near) * slices / log(far / near), folded into a scale and bias
+	float sliceScale = CLUSTER_GRID_Z / log(farDepth / nearDepth);
+	header.scale = glm::vec4(CLUSTER_GRID_X / (float)viewportWidth, CLUSTER_GRID_Y / (float)viewportHeight, sliceScale, -log(nearDepth) * sliceScale);
+
+	// Directional lights reach everything and are read from the frame data instead
+	const vector<GLubyte>& types = lights.GetTypes();
+	const vector<glm::vec3>& positions = lights.GetPositions();
+	const vector<float>& radii = lights.GetRadii();
+
+	ranges.clear();
+	for (GLuint i = 0; i < lights.GetCount(); ++i)
+	{
+		ClusterRange range;
+		if (types[i] != LIGHT_DIRECTIONAL && findRange(positions[i], radii[i], view, projection, range))
+		{
+			range.light = i;
+			ranges.push_back(range);
+		}
+	}
+
+	// Count the lights of each cluster, then turn the counts into offsets
+	fill(cells.begin(), cells.end(), 0);
+	for (size_t r = 0; r < ranges.size(); ++r)
+	{
+		const ClusterRange& range = ranges[r];
+		for (GLuint z = range.minZ; z <= range.maxZ; ++z)
+		{
+			for (GLuint y = range.minY; y <= range.maxY; ++y)
+			{
+				GLuint row = (z * CLUSTER_GRID_Y + y) * CLUSTER_GRID_X;
+				for (GLuint x = range.minX; x <= range.maxX; ++x)
+				{
+					++cells[(row + x) * 2 + 1];
+				}
+			}
+		}
+	}
+
+	GLuint offset = 0;
+	for (GLuint cluster = 0; cluster < CLUSTER_COUNT; ++cluster)
+	{
+		cells[cluster * 2] = offset;
+		offset += cells[cluster * 2 + 1];
+		cells[cluster * 2 + 1] = 0;
+	}
+
+	// Second pass writes each light into its clusters' slots
+	indices.resize(offset);
+	for (size_t r = 0; r < ranges.size(); ++r)
+	{
+		const ClusterRange& range = ranges[r];
+		for (GLuint z = range.minZ; z <= range.maxZ; ++z)
+		{
+			for (GLuint y = range.minY; y <= range.maxY; ++y)
+			{
+				GLuint row = (z * CLUSTER_GRID_Y + y) * CLUSTER_GRID_X;
+				for (GLuint x = range.minX; x <= range.maxX; ++x)
+				{
+					GLuint* cell = &cells[(row + x) * 2];
+					indices[cell[0] + cell[1]++] = range.light;
+				}
+			}
+		}
+	}
+
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	gFrameStats.lightBinMilliseconds += elapsed.count();
+	gFrameStats.lightBins++;
+	gFrameStats.clusterLightIndices += offset;
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, gridBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(ClusterGridHeader), &header);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(ClusterGridHeader), sizeof(GLuint) * cells.size(), cells.data());
+
+	if (!indices.empty())
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexBuffer);
+		if (indices.size() > indexCapacity)
+		{
+			indexCapacity = max((GLuint)indices.size(), indexCapacity * 2);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * indexCapacity, NULL, GL_DYNAMIC_DRAW);
+		}
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint) * indices.size(), indices.data());
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/* Release the buffers */
+/////////////////////////
+void ClusteredLighting::Destroy()
+{
+	glDeleteBuffers(1, &gridBuffer);
+	glDeleteBuffers(1, &indexBuffer);
+
+	gridBuffer = 0;
+	indexBuffer = 0;
+	indexCapacity = 0;
+}
+
+/* Get the number of light entries over all clusters after the last update */
+//////////////////////////////////////////////////////////////////////////////
+GLuint ClusteredLighting::GetIndexCount() const
+{
+	return (GLuint)indices.size();
+}
+
+/* Destructor */
+////////////////
+ClusteredLighting::~ClusteredLighting()
+{
+	Destroy();
+}
+
+/* Clusters touched by a light sphere's bounding box in view space, false when it cannot be seen */
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool ClusteredLighting::findRange(const glm::vec3& position, float radius, const glm::mat4& view, const glm::mat4& projection, ClusterRange& range) const
+{
+	glm::vec4 center = view * glm::vec4(position, 1.0f);
+
+	// View space looks down -z
+	float depth = -center.z;
+	float minDepth = depth - radius, maxDepth = depth + radius;
+	if (maxDepth <= 0.0f || minDepth > farDepth)
+	{
+		return false;
+	}
+	minDepth = min(max(minDepth, nearDepth), farDepth);
+	maxDepth = min(max(maxDepth, nearDepth), farDepth);
+
+	// The box's screen extent, x / depth is smallest at the near depth when x is negative
+	bool perspective = projection[3][3] == 0.0f;
+	GLuint minTile[2], maxTile[2];
+	const GLuint tileCounts[2] = { CLUSTER_GRID_X, CLUSTER_GRID_Y };
+	for (int axis = 0; axis < 2; ++axis)
+	{
+		float low = center[axis] - radius, high = center[axis] + radius;
+		float scale = projection[axis][axis];
+		float ndcMin, ndcMax;
+		if (perspective)
+		{
+			ndcMin = scale * low / (low < 0.0f ? minDepth : maxDepth) - projection[2][axis];
+			ndcMax = scale * high / (high > 0.0f ? minDepth : maxDepth) - projection[2][axis];
+		}
+		else
+		{
+			ndcMin = scale * low + projection[3][axis];
+			ndcMax = scale * high + projection[3][axis];
+		}
+
+		if (ndcMax < -1.0f || ndcMin > 1.0f)
+		{
+			return false;
+		}
+		minTile[axis] = tileOf(ndcMin, tileCounts[axis]);
+		maxTile[axis] = tileOf(ndcMax, tileCounts[axis]);
+	}
+
+	range.minX = minTile[0];
+	range.maxX = maxTile[0];
+	range.minY = minTile[1];
+	range.maxY = maxTile[1];
+	range.minZ = slice(minDepth);
+	range.maxZ = slice(maxDepth);
+	return true;
+}
+
+/* Depth slice of a view depth, clamped to the grid */
+//////////////////////////////////////////////////////
+GLuint ClusteredLighting::slice(float depth) const
+{
+	int index = (int)floor(log(depth) * header.scale.z + header.scale.w);
+	return (GLuint)min(max(index, 0), (int)CLUSTER_GRID_Z - 1);
+}
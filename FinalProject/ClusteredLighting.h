@@ -0,0 +1,74 @@
+#pragma once
+
+#include "LightManager.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+using namespace std;
+
+// Froxel grid: screen tiles across, exponential slices along view depth
+const GLuint CLUSTER_GRID_X = 16;
+const GLuint CLUSTER_GRID_Y = 9;
+const GLuint CLUSTER_GRID_Z = 24;
+const GLuint CLUSTER_COUNT = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+
+// Closest depth the slices start at, an orthographic near plane is 0
+const float CLUSTER_MIN_DEPTH = 0.1f;
+
+// Shader storage binding points, after the light manager's light buffer
+const GLuint CLUSTER_GRID_BINDING = 2;
+const GLuint CLUSTER_INDEX_BINDING = 3;
+
+/* Start of the cluster grid buffer, one offset and count pair per cluster follows */
+/////////////////////////////////////////////////////////////////////////////////////
+struct ClusterGridHeader
+{
+	glm::vec4 scale; // Tiles per pixel in xy, log view depth to slice in zw
+	GLuint size[4];  // Grid dimensions, w is padding
+};
+
+/* Bins point and spot lights into the clusters of the view frustum on the CPU, */
+/* each fragment then only shades the lights listed for its cluster             */
+//////////////////////////////////////////////////////////////////////////////////
+class ClusteredLighting
+{
+public:
+	ClusteredLighting();
+
+	static bool IsSupported();
+
+	void Create();
+	void Update(const LightManager& lights, const glm::mat4& view, const glm::mat4& projection, GLint viewportWidth, GLint viewportHeight);
+	void Destroy();
+
+	GLuint GetIndexCount() const;
+
+	~ClusteredLighting();
+
+private:
+	/* Clusters covered by one light, inclusive */
+	//////////////////////////////////////////////
+	struct ClusterRange
+	{
+		GLuint light;
+		GLuint minX, maxX, minY, maxY, minZ, maxZ;
+	};
+
+	bool findRange(const glm::vec3& position, float radius, const glm::mat4& view, const glm::mat4& projection, ClusterRange& range) const;
+	GLuint slice(float depth) const;
+
+	GLuint gridBuffer;
+	GLuint indexBuffer;
+	GLuint indexCapacity;
+
+	// Depth range the slices cover this update
+	float nearDepth, farDepth;
+	ClusterGridHeader header;
+
+	// Reused every update
+	vector<ClusterRange> ranges;
+	vector<GLuint> cells; // Offset and count per cluster
+	vector<GLuint> indices;
+};
@@ -0,0 +1,139 @@
+#include "FrameContext.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+/* Constructor */
+/////////////////
+FrameContext::FrameContext()
+{
+	view = glm::mat4(1.0f);
+	projection = glm::mat4(1.0f);
+	viewProjection = glm::mat4(1.0f);
+	viewPosition = glm::vec3(0.0f);
+
+	viewportWidth = 1;
+	viewportHeight = 1;
+	perspective = true;
+
+	// Build everything on the first update
+	viewDirty = true;
+	projectionDirty = true;
+}
+
+/* Store the framebuffer size used for the aspect ratio */
+//////////////////////////////////////////////////////////
+void FrameContext::SetViewport(GLint width, GLint height)
+{
+	// A minimized window reports a zero size, keep the last aspect ratio
+	if (width <= 0 || height <= 0)
+	{
+		return;
+	}
+
+	viewportWidth = width;
+	viewportHeight = height;
+	projectionDirty = true;
+}
+
+/* Camera position or orientation changed */
+////////////////////////////////////////////
+void FrameContext::MarkViewDirty()
+{
+	viewDirty = true;
+}
+
+/* Projection mode, zoom or orthographic bounds changed */
+/////////////////////////////////////////////////////////
+void FrameContext::MarkProjectionDirty()
+{
+	projectionDirty = true;
+}
+
+/* Rebuild the dirty matrices, returns true if anything changed */
+//////////////////////////////////////////////////////////////////
+bool FrameContext::Update(const Camera& camera, bool perspective, const GLfloat* orthoCoords)
+{
+	if (!viewDirty && !projectionDirty)
+	{
+		return false;
+	}
+
+	if (viewDirty)
+	{
+		// Transform the camera for view space
+		view = camera.GetViewMatrix();
+		viewPosition = camera.Position;
+	}
+
+	if (projectionDirty)
+	{
+		this->perspective = perspective;
+
+		if (perspective)
+		{
+			// Create a perspective projection for clip space
+			projection = glm::perspective(glm::radians(camera.Zoom), (GLfloat)viewportWidth / (GLfloat)viewportHeight, 0.1f, 100.0f);
+		}
+		else
+		{
+			// Create orthographic projection
+			projection = glm::ortho(orthoCoords[0], orthoCoords[1], orthoCoords[2], orthoCoords[3], 0.0f, 1000.0f);
+		}
+	}
+
+	viewProjection = projection * view;
+
+	viewDirty = false;
+	projectionDirty = false;
+
+	return true;
+}
+
+/* Get the view matrix */
+/////////////////////////
+const glm::mat4& FrameContext::GetView() const
+{
+	return view;
+}
+
+/* Get the projection matrix */
+///////////////////////////////
+const glm::mat4& FrameContext::GetProjection() const
+{
+	return projection;
+}
+
+/* Get projection * view */
+///////////////////////////
+const glm::mat4& FrameContext::GetViewProjection() const
+{
+	return viewProjection;
+}
+
+/* Get the camera position in world space */
+////////////////////////////////////////////
+const glm::vec3& FrameContext::GetViewPosition() const
+{
+	return viewPosition;
+}
+
+/* Get the framebuffer width */
+////////////////////////////////
+GLint FrameContext::GetViewportWidth() const
+{
+	return viewportWidth;
+}
+
+/* Get the framebuffer height */
+/////////////////////////////////
+GLint FrameContext::GetViewportHeight() const
+{
+	return viewportHeight;
+}
+
+/* Check if the projection is perspective or orthographic */
+/////////////////////////////////////////////////////////////
+bool FrameContext::IsPerspective() const
+{
+	return perspective;
+}
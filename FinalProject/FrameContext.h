@@ -0,0 +1,39 @@
+#pragma once
+
+#include "dependencies/camera.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/* Camera matrices for the current frame, rebuilt only when something changed */
+//////////////////////////////////////////////////////////////////////////////////
+class FrameContext
+{
+public:
+	FrameContext();
+
+	void SetViewport(GLint width, GLint height);
+	void MarkViewDirty();
+	void MarkProjectionDirty();
+	bool Update(const Camera& camera, bool perspective, const GLfloat* orthoCoords);
+
+	const glm::mat4& GetView() const;
+	const glm::mat4& GetProjection() const;
+	const glm::mat4& GetViewProjection() const;
+	const glm::vec3& GetViewPosition() const;
+	GLint GetViewportWidth() const;
+	GLint GetViewportHeight() const;
+	bool IsPerspective() const;
+
+private:
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::vec3 viewPosition;
+
+	GLint viewportWidth;
+	GLint viewportHeight;
+	bool perspective;
+
+	bool viewDirty;
+	bool projectionDirty;
+};
@@ -0,0 +1,48 @@
+#include "FrameData.h"
+
+/* Constructor */
+/////////////////
+FrameUniformBuffer::FrameUniformBuffer()
+{
+	ubo = 0;
+}
+
+/* Allocate the buffer and bind it to the FrameData binding point */
+////////////////////////////////////////////////////////////////////
+void FrameUniformBuffer::Create()
+{
+	glGenBuffers(1, &ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, ubo);
+}
+
+/* Point a program's FrameData block at the shared binding point */
+///////////////////////////////////////////////////////////////////
+void FrameUniformBuffer::AttachProgram(GLuint programId) const
+{
+	GLuint blockIndex = glGetUniformBlockIndex(programId, "FrameData");
+	if (blockIndex != GL_INVALID_INDEX)
+	{
+		glUniformBlockBinding(programId, blockIndex, FRAME_DATA_BINDING);
+	}
+}
+
+/* Upload this frame's camera and light data */
+///////////////////////////////////////////////
+void FrameUniformBuffer::Update(const FrameData& data) const
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/* Release the buffer */
+////////////////////////
+void FrameUniformBuffer::Destroy()
+{
+	glDeleteBuffers(1, &ubo);
+	ubo = 0;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Number of lights in the object fragment shader
+const int NR_LIGHTS = 3;
+
+// Uniform block binding point shared by every program that reads FrameData
+const GLuint FRAME_DATA_BINDING = 0;
+
+/* One light in std140 layout, matches struct Light in the object shader */
+////////////////////////////////////////////////////////////////////////////
+struct LightData
+{
+	glm::vec4 position;  // xyz used, w is padding
+	glm::vec4 color;     // xyz used, w is padding
+	glm::vec3 direction; // Zero for point lights
+	float intensity;
+};
+
+/* Per-frame shader data in std140 layout, matches the FrameData uniform block */
+//////////////////////////////////////////////////////////////////////////////////
+struct FrameData
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec4 viewPosition; // xyz used, w is padding
+	LightData lights[NR_LIGHTS];
+};
+
+/* Uniform buffer holding the FrameData block, written once per frame */
+/////////////////////////////////////////////////////////////////////////
+class FrameUniformBuffer
+{
+public:
+	FrameUniformBuffer();
+
+	void Create();
+	void AttachProgram(GLuint programId) const;
+	void Update(const FrameData& data) const;
+	void Destroy();
+
+private:
+	GLuint ubo;
+};
@@ -0,0 +1,148 @@
+#include "FrameStats.h"
+
+#include <iostream>
+
+using namespace std;
+
+FrameStats gFrameStats;
+
+/* Constructor */
+/////////////////
+FrameStats::FrameStats()
+{
+	drawCalls = 0;
+	stateChanges = 0;
+	elidedStateChanges = 0;
+	triangles = 0;
+	fullDetailTriangles = 0;
+	visibleObjects = 0;
+	culledObjects = 0;
+	occlusionTests = 0;
+	occludedObjects = 0;
+	lightBins = 0;
+	clusterLightIndices = 0;
+	uploadedLights = 0;
+	lightBinMilliseconds = 0.0;
+	submitMilliseconds = 0.0;
+	frameMilliseconds = 0.0;
+
+	frames = 0;
+	totalDrawCalls = 0;
+	totalStateChanges = 0;
+	totalElidedStateChanges = 0;
+	totalTriangles = 0;
+	totalFullDetailTriangles = 0;
+	totalVisibleObjects = 0;
+	totalCulledObjects = 0;
+	totalOcclusionTests = 0;
+	totalOccludedObjects = 0;
+	totalLightBins = 0;
+	totalClusterLightIndices = 0;
+	totalUploadedLights = 0;
+	totalLightBinMilliseconds = 0.0;
+	totalSubmitMilliseconds = 0.0;
+	totalFrameMilliseconds = 0.0;
+
+	frameStarted = false;
+}
+
+/* Add the last frame to the totals and reset the per-frame counters */
+///////////////////////////////////////////////////////////////////////
+void FrameStats::BeginFrame()
+{
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	if (frameStarted)
+	{
+		chrono::duration<double, milli> elapsed = now - frameStart;
+		frameMilliseconds = elapsed.count();
+	}
+	frameStart = now;
+	frameStarted = true;
+
+	if (drawCalls > 0)
+	{
+		++frames;
+		totalDrawCalls += drawCalls;
+		totalStateChanges += stateChanges;
+		totalElidedStateChanges += elidedStateChanges;
+		totalTriangles += triangles;
+		totalFullDetailTriangles += fullDetailTriangles;
+		totalVisibleObjects += visibleObjects;
+		totalCulledObjects += culledObjects;
+		totalOcclusionTests += occlusionTests;
+		totalOccludedObjects += occludedObjects;
+		totalLightBins += lightBins;
+		totalClusterLightIndices += clusterLightIndices;
+		totalUploadedLights += uploadedLights;
+		totalLightBinMilliseconds += lightBinMilliseconds;
+		totalSubmitMilliseconds += submitMilliseconds;
+		totalFrameMilliseconds += frameMilliseconds;
+	}
+
+	drawCalls = 0;
+	stateChanges = 0;
+	elidedStateChanges = 0;
+	triangles = 0;
+	fullDetailTriangles = 0;
+	visibleObjects = 0;
+	culledObjects = 0;
+	occlusionTests = 0;
+	occludedObjects = 0;
+	lightBins = 0;
+	clusterLightIndices = 0;
+	uploadedLights = 0;
+	lightBinMilliseconds = 0.0;
+	submitMilliseconds = 0.0;
+	frameMilliseconds = 0.0;
+}
+
+/* Start timing CPU work spent submitting draws */
+//////////////////////////////////////////////////
+void FrameStats::BeginSubmit()
+{
+	submitStart = chrono::steady_clock::now();
+}
+
+/* Stop timing CPU submission */
+////////////////////////////////
+void FrameStats::EndSubmit()
+{
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - submitStart;
+	submitMilliseconds += elapsed.count();
+}
+
+/* Print the per-frame and per-draw averages */
+///////////////////////////////////////////////
+void FrameStats::Print() const
+{
+	if (frames == 0 || totalDrawCalls == 0)
+	{
+		return;
+	}
+
+	cout << "Frames: " << frames << endl;
+	cout << "Draw calls per frame: " << (double)totalDrawCalls / frames << endl;
+	cout << "State changes per frame: " << (double)totalStateChanges / frames << endl;
+	cout << "Elided state changes per frame: " << (double)totalElidedStateChanges / frames << endl;
+	cout << "Triangles per frame: " << (double)totalTriangles / frames << " (" << (double)totalFullDetailTriangles / frames << " at full detail)" << endl;
+	cout << "Visible objects per frame: " << (double)totalVisibleObjects / frames << ", culled: " << (double)totalCulledObjects / frames << endl;
+	if (totalOcclusionTests > 0)
+	{
+		cout << "Occluded objects per frame: " << (double)totalOccludedObjects / frames << ", "
+			<< 100.0 * totalOccludedObjects / totalOcclusionTests << "% of tested" << endl;
+	}
+	if (totalLightBins > 0)
+	{
+		cout << "Light binning: " << totalLightBinMilliseconds / totalLightBins << " ms per binning, "
+			<< totalLightBinMilliseconds / frames << " ms per frame, "
+			<< (double)totalClusterLightIndices / totalLightBins << " cluster entries" << endl;
+	}
+	cout << "Lights uploaded per frame: " << (double)totalUploadedLights / frames << endl;
+	cout << "Frame time: " << totalFrameMilliseconds / frames << " ms" << endl;
+	if (totalFrameMilliseconds > 0.0)
+	{
+		cout << "Triangles per second: " << totalTriangles * 1000.0 / totalFrameMilliseconds << endl;
+	}
+	cout << "CPU submit per frame: " << totalSubmitMilliseconds / frames << " ms" << endl;
+	cout << "CPU submit per draw: " << totalSubmitMilliseconds * 1000.0 / totalDrawCalls << " us" << endl;
+}
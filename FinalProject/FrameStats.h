@@ -0,0 +1,60 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <chrono>
+
+/* CPU-side counters for the render loop, printed as averages on exit */
+////////////////////////////////////////////////////////////////////////
+class FrameStats
+{
+public:
+	// Counters for the current frame, reset by BeginFrame
+	GLuint drawCalls;
+	GLuint stateChanges;
+	GLuint elidedStateChanges;
+	GLuint triangles;
+	GLuint fullDetailTriangles; // Triangles the same draws would submit at detail level 0
+	GLuint visibleObjects;
+	GLuint culledObjects;
+	GLuint occlusionTests;   // Items inside the frustum tested against the occluders
+	GLuint occludedObjects;
+	GLuint lightBins;           // Times the point lights were binned into clusters
+	GLuint clusterLightIndices; // Light entries over all clusters, summed over the binnings
+	GLuint uploadedLights;      // Lights written to the light buffer
+	double lightBinMilliseconds;
+	double submitMilliseconds;
+	double frameMilliseconds;   // Time since the previous BeginFrame
+
+	// Totals over all finished frames
+	GLuint frames;
+	unsigned long long totalDrawCalls;
+	unsigned long long totalStateChanges;
+	unsigned long long totalElidedStateChanges;
+	unsigned long long totalTriangles;
+	unsigned long long totalFullDetailTriangles;
+	unsigned long long totalVisibleObjects;
+	unsigned long long totalCulledObjects;
+	unsigned long long totalOcclusionTests;
+	unsigned long long totalOccludedObjects;
+	unsigned long long totalLightBins;
+	unsigned long long totalClusterLightIndices;
+	unsigned long long totalUploadedLights;
+	double totalLightBinMilliseconds;
+	double totalSubmitMilliseconds;
+	double totalFrameMilliseconds;
+
+	FrameStats();
+
+	void BeginFrame();
+	void BeginSubmit();
+	void EndSubmit();
+	void Print() const;
+
+private:
+	std::chrono::steady_clock::time_point submitStart;
+	std::chrono::steady_clock::time_point frameStart;
+	bool frameStarted;
+};
+
+extern FrameStats gFrameStats;
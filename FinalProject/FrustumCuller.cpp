@@ -0,0 +1,263 @@
+#include "FrustumCuller.h"
+
+#include <cmath>
+
+// AVX tests eight bounds per instruction, SSE2 tests them as two halves
+#if defined(__AVX__)
+#define FRUSTUM_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_SSE
+#include <emmintrin.h>
+#endif
+
+/* Move an object space box to a world space box, given as center and half extent */
+/* The extent is the box's corners projected onto each world axis                  */
+/////////////////////////////////////////////////////////////////////////////////////
+void TransformBoundingBox(const glm::vec3& minimum, const glm::vec3& maximum, const glm::mat4& model, glm::vec3& center, glm::vec3& extent)
+{
+	glm::vec3 localCenter = (minimum + maximum) * 0.5f;
+	glm::vec3 localExtent = (maximum - minimum) * 0.5f;
+
+	center = glm::vec3(model * glm::vec4(localCenter, 1.0f));
+	extent = glm::abs(glm::vec3(model[0])) * localExtent.x + glm::abs(glm::vec3(model[1])) * localExtent.y + glm::abs(glm::vec3(model[2])) * localExtent.z;
+}
+
+/* Extract the frustum planes from the rows of a view-projection matrix         */
+/* Planes are normalized so sphere radii can be compared with distances         */
+/* Order is left, right, bottom, top, near, far, normals point into the frustum */
+//////////////////////////////////////////////////////////////////////////////////
+void ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	planes[0] = rows[3] + rows[0]; // Left
+	planes[1] = rows[3] - rows[0]; // Right
+	planes[2] = rows[3] + rows[1]; // Bottom
+	planes[3] = rows[3] - rows[1]; // Top
+	planes[4] = rows[3] + rows[2]; // Near
+	planes[5] = rows[3] - rows[2]; // Far
+
+	for (int i = 0; i < 6; ++i)
+	{
+		float length = glm::length(glm::vec3(planes[i]));
+		if (length > 0.0f)
+		{
+			planes[i] = planes[i] / length;
+		}
+	}
+}
+
+/* Constructor */
+/////////////////
+FrustumCuller::FrustumCuller()
+{
+	for (int i = 0; i < 6; ++i)
+	{
+		planes[i] = glm::vec4(0.0f);
+	}
+
+	count = 0;
+	visibleCount = 0;
+}
+
+/* Add an object's world space bounding sphere and box, returns its handle */
+/////////////////////////////////////////////////////////////////////////////
+GLuint FrustumCuller::Add(const glm::vec4& sphere, const glm::vec3& boxCenter, const glm::vec3& boxExtent)
+{
+	// Grow a whole batch at a time, padding entries are never reported
+	if (count % CULL_BATCH_SIZE == 0)
+	{
+		size_t size = count + CULL_BATCH_SIZE;
+		sphereX.resize(size); sphereY.resize(size); sphereZ.resize(size); sphereRadius.resize(size);
+		centerX.resize(size); centerY.resize(size); centerZ.resize(size);
+		extentX.resize(size); extentY.resize(size); extentZ.resize(size);
+		visible.resize(size, 1);
+	}
+
+	GLuint handle = count++;
+	SetBounds(handle, sphere, boxCenter, boxExtent);
+	return handle;
+}
+
+/* Replace an object's bounds after it moved */
+///////////////////////////////////////////////
+void FrustumCuller::SetBounds(GLuint handle, const glm::vec4& sphere, const glm::vec3& boxCenter, const glm::vec3& boxExtent)
+{
+	sphereX[handle] = sphere.x;
+	sphereY[handle] = sphere.y;
+	sphereZ[handle] = sphere.z;
+	sphereRadius[handle] = sphere.w;
+
+	centerX[handle] = boxCenter.x;
+	centerY[handle] = boxCenter.y;
+	centerZ[handle] = boxCenter.z;
+
+	extentX[handle] = boxExtent.x;
+	extentY[handle] = boxExtent.y;
+	extentZ[handle] = boxExtent.z;
+}
+
+/* Remove every object */
+/////////////////////////
+void FrustumCuller::Clear()
+{
+	sphereX.clear(); sphereY.clear(); sphereZ.clear(); sphereRadius.clear();
+	centerX.clear(); centerY.clear(); centerZ.clear();
+	extentX.clear(); extentY.clear(); extentZ.clear();
+	visible.clear();
+
+	count = 0;
+	visibleCount = 0;
+}
+
+/* Use the planes of a view-projection matrix */
+/////////////////////////////////////////////////
+void FrustumCuller::SetViewProjection(const glm::mat4& viewProjection)
+{
+	ExtractFrustumPlanes(viewProjection, planes);
+}
+
+/* Test every object, an object is culled when its sphere or its box is behind any plane */
+//////////////////////////////////////////////////////////////////////////////////////////////
+void FrustumCuller::Cull()
+{
+	size_t batched = count - count % CULL_BATCH_SIZE;
+	cullSimd(0, batched);
+	cullScalar(batched, count);
+
+	visibleCount = 0;
+	for (GLuint i = 0; i < count; ++i)
+	{
+		visibleCount += visible[i];
+	}
+}
+
+/* Test one object at a time */
+///////////////////////////////
+void FrustumCuller::cullScalar(size_t begin, size_t end)
+{
+	for (size_t i = begin; i < end; ++i)
+	{
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; ++p)
+		{
+			const glm::vec4& plane = planes[p];
+
+			float sphereDistance = plane.x * sphereX[i] + plane.y * sphereY[i] + plane.z * sphereZ[i] + plane.w;
+			float boxDistance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+			float boxRadius = fabs(plane.x) * extentX[i] + fabs(plane.y) * extentY[i] + fabs(plane.z) * extentZ[i];
+
+			outside = sphereDistance < -sphereRadius[i] || boxDistance + boxRadius < 0.0f;
+		}
+		visible[i] = !outside;
+	}
+}
+
+/* Test CULL_BATCH_SIZE objects per pass, end - begin must be a multiple of it */
+/////////////////////////////////////////////////////////////////////////////////
+void FrustumCuller::cullSimd(size_t begin, size_t end)
+{
+#if defined(FRUSTUM_AVX)
+	for (size_t i = begin; i < end; i += 8)
+	{
+		__m256 sx = _mm256_loadu_ps(&sphereX[i]), sy = _mm256_loadu_ps(&sphereY[i]), sz = _mm256_loadu_ps(&sphereZ[i]);
+		__m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&sphereRadius[i]));
+		__m256 cx = _mm256_loadu_ps(&centerX[i]), cy = _mm256_loadu_ps(&centerY[i]), cz = _mm256_loadu_ps(&centerZ[i]);
+		__m256 ex = _mm256_loadu_ps(&extentX[i]), ey = _mm256_loadu_ps(&extentY[i]), ez = _mm256_loadu_ps(&extentZ[i]);
+		__m256 outside = _mm256_setzero_ps();
+
+		for (int p = 0; p < 6; ++p)
+		{
+			const glm::vec4& plane = planes[p];
+			__m256 a = _mm256_set1_ps(plane.x), b = _mm256_set1_ps(plane.y), c = _mm256_set1_ps(plane.z), d = _mm256_set1_ps(plane.w);
+
+			__m256 sphereDistance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, sx), _mm256_mul_ps(b, sy)), _mm256_add_ps(_mm256_mul_ps(c, sz), d));
+			__m256 boxDistance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, cx), _mm256_mul_ps(b, cy)), _mm256_add_ps(_mm256_mul_ps(c, cz), d));
+			__m256 boxRadius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(fabs(plane.x)), ex), _mm256_mul_ps(_mm256_set1_ps(fabs(plane.y)), ey)),
+				_mm256_mul_ps(_mm256_set1_ps(fabs(plane.z)), ez));
+
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(sphereDistance, negativeRadius, _CMP_LT_OQ));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(boxDistance, boxRadius), _mm256_setzero_ps(), _CMP_LT_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(outside);
+		for (int lane = 0; lane < 8; ++lane)
+		{
+			visible[i + lane] = !((mask >> lane) & 1);
+		}
+	}
+#elif defined(FRUSTUM_SSE)
+	// Eight objects per pass as a low and a high half
+	for (size_t i = begin; i < end; i += 8)
+	{
+		__m128 sx[2], sy[2], sz[2], negativeRadius[2], cx[2], cy[2], cz[2], ex[2], ey[2], ez[2], outside[2];
+		for (int h = 0; h < 2; ++h)
+		{
+			size_t j = i + h * 4;
+			sx[h] = _mm_loadu_ps(&sphereX[j]); sy[h] = _mm_loadu_ps(&sphereY[j]); sz[h] = _mm_loadu_ps(&sphereZ[j]);
+			negativeRadius[h] = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&sphereRadius[j]));
+			cx[h] = _mm_loadu_ps(&centerX[j]); cy[h] = _mm_loadu_ps(&centerY[j]); cz[h] = _mm_loadu_ps(&centerZ[j]);
+			ex[h] = _mm_loadu_ps(&extentX[j]); ey[h] = _mm_loadu_ps(&extentY[j]); ez[h] = _mm_loadu_ps(&extentZ[j]);
+			outside[h] = _mm_setzero_ps();
+		}
+
+		for (int p = 0; p < 6; ++p)
+		{
+			const glm::vec4& plane = planes[p];
+			__m128 a = _mm_set1_ps(plane.x), b = _mm_set1_ps(plane.y), c = _mm_set1_ps(plane.z), d = _mm_set1_ps(plane.w);
+			__m128 absA = _mm_set1_ps(fabs(plane.x)), absB = _mm_set1_ps(fabs(plane.y)), absC = _mm_set1_ps(fabs(plane.z));
+
+			for (int h = 0; h < 2; ++h)
+			{
+				__m128 sphereDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, sx[h]), _mm_mul_ps(b, sy[h])), _mm_add_ps(_mm_mul_ps(c, sz[h]), d));
+				__m128 boxDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, cx[h]), _mm_mul_ps(b, cy[h])), _mm_add_ps(_mm_mul_ps(c, cz[h]), d));
+				__m128 boxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absA, ex[h]), _mm_mul_ps(absB, ey[h])), _mm_mul_ps(absC, ez[h]));
+
+				outside[h] = _mm_or_ps(outside[h], _mm_cmplt_ps(sphereDistance, negativeRadius[h]));
+				outside[h] = _mm_or_ps(outside[h], _mm_cmplt_ps(_mm_add_ps(boxDistance, boxRadius), _mm_setzero_ps()));
+			}
+		}
+
+		int mask = _mm_movemask_ps(outside[0]) | (_mm_movemask_ps(outside[1]) << 4);
+		for (int lane = 0; lane < 8; ++lane)
+		{
+			visible[i + lane] = !((mask >> lane) & 1);
+		}
+	}
+#else
+	cullScalar(begin, end);
+#endif
+}
+
+/* Check whether an object passed the last Cull */
+///////////////////////////////////////////////////
+bool FrustumCuller::IsVisible(GLuint handle) const
+{
+	return visible[handle] != 0;
+}
+
+/* Get the number of objects */
+////////////////////////////////
+GLuint FrustumCuller::GetCount() const
+{
+	return count;
+}
+
+/* Get the number of objects inside the frustum at the last Cull */
+///////////////////////////////////////////////////////////////////
+GLuint FrustumCuller::GetVisibleCount() const
+{
+	return visibleCount;
+}
+
+/* Get the number of objects rejected at the last Cull */
+//////////////////////////////////////////////////////////
+GLuint FrustumCuller::GetCulledCount() const
+{
+	return count - visibleCount;
+}
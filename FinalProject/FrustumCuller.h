@@ -0,0 +1,51 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+using namespace std;
+
+// Bounds tested per SIMD pass, storage is padded to a multiple of this
+const GLuint CULL_BATCH_SIZE = 8;
+
+void ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+void TransformBoundingBox(const glm::vec3& minimum, const glm::vec3& maximum, const glm::mat4& model, glm::vec3& center, glm::vec3& extent);
+
+/* World space bounds of many objects tested against the six planes of a view-projection matrix */
+/* Bounds are stored as structure of arrays so eight objects are tested per pass               */
+///////////////////////////////////////////////////////////////////////////////////////////////////
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+
+	GLuint Add(const glm::vec4& sphere, const glm::vec3& boxCenter, const glm::vec3& boxExtent);
+	void SetBounds(GLuint handle, const glm::vec4& sphere, const glm::vec3& boxCenter, const glm::vec3& boxExtent);
+	void Clear();
+
+	// Works for perspective and orthographic projections alike
+	void SetViewProjection(const glm::mat4& viewProjection);
+	void Cull();
+
+	bool IsVisible(GLuint handle) const;
+	GLuint GetCount() const;
+	GLuint GetVisibleCount() const;
+	GLuint GetCulledCount() const;
+
+private:
+	void cullScalar(size_t begin, size_t end);
+	void cullSimd(size_t begin, size_t end);
+
+	// Normalized planes: left, right, bottom, top, near, far as (normal, distance)
+	glm::vec4 planes[6];
+
+	vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+	vector<float> centerX, centerY, centerZ;
+	vector<float> extentX, extentY, extentZ;
+	vector<unsigned char> visible;
+
+	GLuint count;
+	GLuint visibleCount;
+};
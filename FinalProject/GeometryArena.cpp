@@ -0,0 +1,404 @@
+#include "GeometryArena.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <iostream>
+
+vector<GeometryArena*> GeometryArena::arenas;
+GLsizei GeometryArena::defaultVertexCapacity = DEFAULT_ARENA_VERTICES;
+GLsizei GeometryArena::defaultIndexCapacity = DEFAULT_ARENA_INDICES;
+GLuint GeometryArena::identityInstanceBuffer = 0;
+
+/* Start with a single free block covering the whole range */
+//////////////////////////////////////////////////////////////
+void RangeAllocator::Reset(GLsizei capacity)
+{
+	this->capacity = capacity;
+	used = 0;
+
+	freeBlocks.clear();
+	if (capacity > 0)
+	{
+		Block block = { 0, capacity };
+		freeBlocks.push_back(block);
+	}
+}
+
+/* Take count elements from the first free block large enough */
+////////////////////////////////////////////////////////////////
+GLint RangeAllocator::Allocate(GLsizei count)
+{
+	for (size_t i = 0; i < freeBlocks.size(); ++i)
+	{
+		Block& block = freeBlocks[i];
+		if (block.count < count)
+		{
+			continue;
+		}
+
+		GLint offset = block.offset;
+		block.offset += count;
+		block.count -= count;
+		if (block.count == 0)
+		{
+			freeBlocks.erase(freeBlocks.begin() + i);
+		}
+
+		used += count;
+		return offset;
+	}
+
+	return -1;
+}
+
+/* Return a range, merging it with the free blocks on either side */
+////////////////////////////////////////////////////////////////////
+void RangeAllocator::Free(GLint offset, GLsizei count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// Find the first free block after the range
+	size_t next = 0;
+	while (next < freeBlocks.size() && freeBlocks[next].offset < offset)
+	{
+		++next;
+	}
+
+	bool joinsPrevious = next > 0 && freeBlocks[next - 1].offset + freeBlocks[next - 1].count == offset;
+	bool joinsNext = next < freeBlocks.size() && offset + count == freeBlocks[next].offset;
+
+	if (joinsPrevious && joinsNext)
+	{
+		freeBlocks[next - 1].count += count + freeBlocks[next].count;
+		freeBlocks.erase(freeBlocks.begin() + next);
+	}
+	else if (joinsPrevious)
+	{
+		freeBlocks[next - 1].count += count;
+	}
+	else if (joinsNext)
+	{
+		freeBlocks[next].offset = offset;
+		freeBlocks[next].count += count;
+	}
+	else
+	{
+		Block block = { offset, count };
+		freeBlocks.insert(freeBlocks.begin() + next, block);
+	}
+
+	used -= count;
+}
+
+/* Get the number of elements managed */
+////////////////////////////////////////
+GLsizei RangeAllocator::GetCapacity() const
+{
+	return capacity;
+}
+
+/* Get the number of elements handed out */
+///////////////////////////////////////////
+GLsizei RangeAllocator::GetUsed() const
+{
+	return used;
+}
+
+/* Get the number of separate free blocks */
+////////////////////////////////////////////
+GLsizei RangeAllocator::GetFreeBlockCount() const
+{
+	return (GLsizei)freeBlocks.size();
+}
+
+/* Get the largest allocation that can still succeed */
+//////////////////////////////////////////////////////
+GLsizei RangeAllocator::GetLargestFreeBlock() const
+{
+	GLsizei largest = 0;
+	for (size_t i = 0; i < freeBlocks.size(); ++i)
+	{
+		if (freeBlocks[i].count > largest)
+		{
+			largest = freeBlocks[i].count;
+		}
+	}
+
+	return largest;
+}
+
+/* 0 when all free space is one block, towards 1 as it splinters */
+///////////////////////////////////////////////////////////////////
+float RangeAllocator::GetFragmentation() const
+{
+	GLsizei freeCount = capacity - used;
+	if (freeCount == 0)
+	{
+		return 0.0f;
+	}
+
+	return 1.0f - (float)GetLargestFreeBlock() / freeCount;
+}
+
+/* Constructor, allocates both buffers and the shared VAO up front */
+/////////////////////////////////////////////////////////////////////
+GeometryArena::GeometryArena(const VertexLayout& layout, GLenum indexType, GLsizei vertexCapacity, GLsizei indexCapacity)
+{
+	this->layout = layout;
+	this->indexType = indexType;
+
+	vertexRanges.Reset(vertexCapacity);
+	indexRanges.Reset(indexCapacity);
+
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexCapacity * layout.stride, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glGenBuffers(1, &ibo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexCapacity * GetIndexSize(), NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	// Single draws read the shared identity transform as their only instance
+	vao = CreateVertexArray(getIdentityInstanceBuffer());
+}
+
+/* Find an arena with room for the geometry, creating one when all are full */
+//////////////////////////////////////////////////////////////////////////////
+GeometryArena* GeometryArena::Acquire(const VertexLayout& layout, GLenum indexType, GLsizei vertexCount, GLsizei indexCount)
+{
+	for (size_t i = 0; i < arenas.size(); ++i)
+	{
+		GeometryArena* arena = arenas[i];
+		if (arena->indexType == indexType && arena->layout.Matches(layout) &&
+			arena->vertexRanges.GetLargestFreeBlock() >= vertexCount &&
+			arena->indexRanges.GetLargestFreeBlock() >= indexCount)
+		{
+			return arena;
+		}
+	}
+
+	// Meshes larger than the default size get an arena of their own
+	GLsizei vertexCapacity = vertexCount > defaultVertexCapacity ? vertexCount : defaultVertexCapacity;
+	GLsizei indexCapacity = indexCount > defaultIndexCapacity ? indexCount : defaultIndexCapacity;
+
+	GeometryArena* arena = new GeometryArena(layout, indexType, vertexCapacity, indexCapacity);
+	arenas.push_back(arena);
+	return arena;
+}
+
+/* Set the size of arenas created from now on */
+////////////////////////////////////////////////
+void GeometryArena::SetDefaultCapacity(GLsizei vertices, GLsizei indices)
+{
+	defaultVertexCapacity = vertices;
+	defaultIndexCapacity = indices;
+}
+
+/* Print occupancy and fragmentation of every arena */
+//////////////////////////////////////////////////////
+void GeometryArena::PrintStats()
+{
+	for (size_t i = 0; i < arenas.size(); ++i)
+	{
+		ArenaStats stats = arenas[i]->GetStats();
+
+		cout << "Geometry arena " << i << " (stride " << arenas[i]->layout.stride << ", " << arenas[i]->GetIndexSize() * 8 << " bit indices)" << endl;
+		cout << "  Vertices: " << stats.verticesUsed << " / " << stats.vertexCapacity
+			<< ", " << stats.freeVertexBlocks << " free blocks, largest " << stats.largestFreeVertexBlock
+			<< ", fragmentation " << stats.vertexFragmentation << endl;
+		cout << "  Indices: " << stats.indicesUsed << " / " << stats.indexCapacity
+			<< ", " << stats.freeIndexBlocks << " free blocks, largest " << stats.largestFreeIndexBlock
+			<< ", fragmentation " << stats.indexFragmentation << endl;
+	}
+}
+
+/* Destroy every arena, call once all meshes are cleared */
+///////////////////////////////////////////////////////////
+void GeometryArena::ReleaseAll()
+{
+	for (size_t i = 0; i < arenas.size(); ++i)
+	{
+		delete arenas[i];
+	}
+	arenas.clear();
+
+	glDeleteBuffers(1, &identityInstanceBuffer);
+	identityInstanceBuffer = 0;
+}
+
+/* Copy a mesh into free ranges of both buffers, false when the arena is full */
+/* Indices must already be of the arena's index type                          */
+///////////////////////////////////////////////////////////////////////////////
+bool GeometryArena::Allocate(const void* vertices, GLsizei vertexCount, const void* indices, GLsizei indexCount, GeometryAllocation& allocation)
+{
+	GLint baseVertex = vertexRanges.Allocate(vertexCount);
+	if (baseVertex < 0)
+	{
+		return false;
+	}
+
+	GLint firstIndex = indexRanges.Allocate(indexCount);
+	if (firstIndex < 0)
+	{
+		vertexRanges.Free(baseVertex, vertexCount);
+		return false;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)baseVertex * layout.stride, (GLsizeiptr)vertexCount * layout.stride, vertices);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// The element buffer binding is VAO state, so upload through a neutral target
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ibo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstIndex * GetIndexSize(), (GLsizeiptr)indexCount * GetIndexSize(), indices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	allocation.baseVertex = baseVertex;
+	allocation.firstIndex = (GLuint)firstIndex;
+	allocation.vertexCount = vertexCount;
+	allocation.indexCount = indexCount;
+
+	return true;
+}
+
+/* Give a mesh's ranges back to the arena */
+////////////////////////////////////////////
+void GeometryArena::Free(const GeometryAllocation& allocation)
+{
+	vertexRanges.Free(allocation.baseVertex, allocation.vertexCount);
+	indexRanges.Free((GLint)allocation.firstIndex, allocation.indexCount);
+}
+
+/* Create a VAO over the arena's buffers with the given per-instance transforms */
+//////////////////////////////////////////////////////////////////////////////////
+GLuint GeometryArena::CreateVertexArray(GLuint instanceBuffer) const
+{
+	GLuint vertexArray;
+	glGenVertexArrays(1, &vertexArray);
+	glBindVertexArray(vertexArray);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+
+	// Tell OpenGL how to interpret vertex data
+	for (GLuint i = 0; i < layout.attributeCount; ++i)
+	{
+		const VertexAttribute& attribute = layout.attributes[i];
+		glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized, layout.stride, (void*)(size_t)attribute.offset);
+		glEnableVertexAttribArray(attribute.location);
+	}
+
+	// A mat4 attribute takes four consecutive locations, one column each
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	for (GLuint column = 0; column < 4; ++column)
+	{
+		GLuint location = INSTANCE_MODEL_LOCATION + column;
+		glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform), (void*)(sizeof(glm::vec4) * column));
+		glVertexAttribDivisor(location, 1);
+		glEnableVertexAttribArray(location);
+	}
+
+	// The mat3 normal matrix follows it in three more
+	for (GLuint column = 0; column < 3; ++column)
+	{
+		GLuint location = INSTANCE_NORMAL_LOCATION + column;
+		glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform), (void*)(sizeof(glm::mat4) + sizeof(glm::vec3) * column));
+		glVertexAttribDivisor(location, 1);
+		glEnableVertexAttribArray(location);
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return vertexArray;
+}
+
+/* Get the VAO every mesh in the arena draws single instances with */
+/////////////////////////////////////////////////////////////////////
+GLuint GeometryArena::GetVertexArray() const
+{
+	return vao;
+}
+
+/* Get the vertex buffer */
+///////////////////////////
+GLuint GeometryArena::GetVertexBuffer() const
+{
+	return vbo;
+}
+
+/* Get the index buffer */
+//////////////////////////
+GLuint GeometryArena::GetIndexBuffer() const
+{
+	return ibo;
+}
+
+/* Get the index type, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT */
+//////////////////////////////////////////////////////////////
+GLenum GeometryArena::GetIndexType() const
+{
+	return indexType;
+}
+
+/* Get the size of one index in bytes */
+////////////////////////////////////////
+GLsizei GeometryArena::GetIndexSize() const
+{
+	return indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+/* Get the vertex layout */
+///////////////////////////
+const VertexLayout& GeometryArena::GetLayout() const
+{
+	return layout;
+}
+
+/* Get occupancy and fragmentation of both buffers */
+/////////////////////////////////////////////////////
+ArenaStats GeometryArena::GetStats() const
+{
+	ArenaStats stats;
+	stats.vertexCapacity = vertexRanges.GetCapacity();
+	stats.verticesUsed = vertexRanges.GetUsed();
+	stats.freeVertexBlocks = vertexRanges.GetFreeBlockCount();
+	stats.largestFreeVertexBlock = vertexRanges.GetLargestFreeBlock();
+	stats.vertexFragmentation = vertexRanges.GetFragmentation();
+	stats.indexCapacity = indexRanges.GetCapacity();
+	stats.indicesUsed = indexRanges.GetUsed();
+	stats.freeIndexBlocks = indexRanges.GetFreeBlockCount();
+	stats.largestFreeIndexBlock = indexRanges.GetLargestFreeBlock();
+	stats.indexFragmentation = indexRanges.GetFragmentation();
+	return stats;
+}
+
+/* Buffer holding one identity transform, shared by every arena */
+//////////////////////////////////////////////////////////////////
+GLuint GeometryArena::getIdentityInstanceBuffer()
+{
+	if (identityInstanceBuffer == 0)
+	{
+		const InstanceTransform identity = { glm::mat4(1.0f), glm::mat3(1.0f) };
+		glGenBuffers(1, &identityInstanceBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, identityInstanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceTransform), &identity, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	return identityInstanceBuffer;
+}
+
+/* Destructor */
+////////////////
+GeometryArena::~GeometryArena()
+{
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &vbo);
+	glDeleteBuffers(1, &ibo);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "VertexLayout.h"
+#include <GL/glew.h>
+
+#include <vector>
+
+using namespace std;
+
+// Default size of a new arena, SetDefaultCapacity before creating meshes to change it
+const GLsizei DEFAULT_ARENA_VERTICES = 65536;
+const GLsizei DEFAULT_ARENA_INDICES = 196608;
+
+/* First-fit free-list over a range of elements, free blocks are coalesced */
+/////////////////////////////////////////////////////////////////////////////
+class RangeAllocator
+{
+public:
+	void Reset(GLsizei capacity);
+	GLint Allocate(GLsizei count); // -1 when no free block is large enough
+	void Free(GLint offset, GLsizei count);
+
+	GLsizei GetCapacity() const;
+	GLsizei GetUsed() const;
+	GLsizei GetFreeBlockCount() const;
+	GLsizei GetLargestFreeBlock() const;
+	float GetFragmentation() const;
+
+private:
+	struct Block
+	{
+		GLint offset;
+		GLsizei count;
+	};
+
+	vector<Block> freeBlocks; // Sorted by offset
+	GLsizei capacity;
+	GLsizei used;
+};
+
+/* Where a mesh lives inside an arena */
+////////////////////////////////////////
+struct GeometryAllocation
+{
+	GLint baseVertex;
+	GLuint firstIndex;
+	GLsizei vertexCount;
+	GLsizei indexCount;
+};
+
+/* Occupancy of an arena's vertex and index buffers */
+//////////////////////////////////////////////////////
+struct ArenaStats
+{
+	GLsizei vertexCapacity, verticesUsed, freeVertexBlocks, largestFreeVertexBlock;
+	GLsizei indexCapacity, indicesUsed, freeIndexBlocks, largestFreeIndexBlock;
+	float vertexFragmentation, indexFragmentation; // 1 - largest free block / total free
+};
+
+/* Vertex and index buffers shared by every mesh of one layout and index type */
+/* Meshes suballocate ranges and draw through the arena's single VAO          */
+///////////////////////////////////////////////////////////////////////////////
+class GeometryArena
+{
+public:
+	GeometryArena(const VertexLayout& layout, GLenum indexType, GLsizei vertexCapacity, GLsizei indexCapacity);
+
+	static GeometryArena* Acquire(const VertexLayout& layout, GLenum indexType, GLsizei vertexCount, GLsizei indexCount);
+	static void SetDefaultCapacity(GLsizei vertices, GLsizei indices);
+	static void PrintStats();
+	static void ReleaseAll();
+
+	bool Allocate(const void* vertices, GLsizei vertexCount, const void* indices, GLsizei indexCount, GeometryAllocation& allocation);
+	void Free(const GeometryAllocation& allocation);
+	GLuint CreateVertexArray(GLuint instanceBuffer) const;
+
+	GLuint GetVertexArray() const;
+	GLuint GetVertexBuffer() const;
+	GLuint GetIndexBuffer() const;
+	GLenum GetIndexType() const;
+	GLsizei GetIndexSize() const;
+	const VertexLayout& GetLayout() const;
+	ArenaStats GetStats() const;
+
+	~GeometryArena();
+
+private:
+	static GLuint getIdentityInstanceBuffer();
+
+	VertexLayout layout;
+	GLenum indexType;
+	GLuint vao;
+	GLuint vbo;
+	GLuint ibo;
+	RangeAllocator vertexRanges;
+	RangeAllocator indexRanges;
+
+	// Every arena created through Acquire
+	static vector<GeometryArena*> arenas;
+	static GLsizei defaultVertexCapacity;
+	static GLsizei defaultIndexCapacity;
+
+	// One identity matrix read as the instance transform of single draws
+	static GLuint identityInstanceBuffer;
+};
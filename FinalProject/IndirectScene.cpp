@@ -0,0 +1,294 @@
+#include "IndirectScene.h"
+#include "FrameStats.h"
+#include "LevelOfDetail.h"
+
+#include <algorithm>
+
+/* Constructor */
+/////////////////
+IndirectScene::IndirectScene()
+{
+	program = 0;
+	arena = NULL;
+	commandBuffer = 0;
+	objectBuffer = 0;
+	textureArray = 0;
+	nCommands = 0;
+	triangles = 0;
+	fullDetailTriangles = 0;
+}
+
+/* Check for multi-draw indirect, shader storage buffers and gl_DrawIDARB */
+///////////////////////////////////////////////////////////////////////////
+bool IndirectScene::IsSupported()
+{
+	return GLEW_ARB_multi_draw_indirect && GLEW_ARB_shader_storage_buffer_object && GLEW_ARB_shader_draw_parameters;
+}
+
+/* Batch every static, textured item drawn with objectProgram               */
+/* Returns the number of items taken over from the scene's render queue path */
+///////////////////////////////////////////////////////////////////////////////
+GLuint IndirectScene::Build(Scene& scene, GLuint objectProgram, GLuint indirectProgram)
+{
+	Destroy();
+	program = indirectProgram;
+
+	vector<IndirectObjectData> objects;
+	vector<GLuint> textures;
+
+	// Object data is copied once, so the normal matrices must be current
+	scene.UpdateNormalMatrices();
+	for (GLuint handle = 0; handle < scene.GetItemCount(); ++handle)
+	{
+		const DrawItem& item = scene.GetItem(handle);
+		const Material& material = scene.GetMaterial(item.materialHandle);
+		const Mesh* mesh = scene.GetMesh(item.meshHandle);
+
+		if (item.instanced || material.uniforms.program != objectProgram || material.textureId == 0 || mesh->GetArena() == NULL)
+		{
+			continue;
+		}
+
+		// Every mesh in the batch is drawn through one arena's VAO
+		if (arena == NULL)
+		{
+			arena = mesh->GetArena();
+		}
+		else if (mesh->GetArena() != arena)
+		{
+			continue;
+		}
+
+		// Give each texture a layer of the texture array
+		GLuint textureLayer = 0;
+		while (textureLayer < textures.size() && textures[textureLayer] != material.textureId)
+		{
+			++textureLayer;
+		}
+		if (textureLayer == textures.size())
+		{
+			if (textures.size() == MAX_INDIRECT_TEXTURES)
+			{
+				continue;
+			}
+			textures.push_back(material.textureId);
+		}
+
+		IndirectObjectData object;
+		object.model = item.modelMatrix;
+		for (int column = 0; column < 3; ++column)
+		{
+			object.normalMatrix[column] = glm::vec4(item.normalMatrix[column], 0.0f);
+		}
+		object.color = glm::vec4(material.color, 1.0f);
+		object.positionScale = glm::vec4(mesh->GetQuantization().positionScale, 0.0f);
+		object.positionOffset = glm::vec4(mesh->GetQuantization().positionOffset, 0.0f);
+		object.textureLayer = textureLayer;
+		object.octahedralNormals = mesh->GetQuantization().octahedralNormals;
+		object.padding[0] = object.padding[1] = 0;
+		objects.push_back(object);
+
+		// The mesh already lives in the arena, the command just points at its finest level
+		DrawElementsIndirectCommand command = { (GLuint)mesh->GetIndexCount(0), 1, mesh->GetFirstIndex(0), mesh->GetBaseVertex(), 0 };
+		commands.push_back(command);
+		meshes.push_back(mesh);
+		boundingSpheres.push_back(TransformBoundingSphere(mesh->GetBoundingSphere(), item.modelMatrix));
+		lods.push_back(0);
+		triangles += command.count / 3;
+
+		itemHandles.push_back(handle);
+	}
+
+	if (commands.empty())
+	{
+		return 0;
+	}
+
+	// Draw commands and the per-object data they index
+	glGenBuffers(1, &commandBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * commands.size(), commands.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	glGenBuffers(1, &objectBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(IndirectObjectData) * objects.size(), objects.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	nCommands = (GLsizei)commands.size();
+	fullDetailTriangles = triangles;
+
+	buildTextureArray(textures);
+
+	// The render queue no longer draws these items
+	for (size_t i = 0; i < itemHandles.size(); ++i)
+	{
+		scene.SetBatched(itemHandles[i], true);
+	}
+
+	return (GLuint)itemHandles.size();
+}
+
+/* Pick every object's detail level and drop objects the scene culled           */
+/* The command buffer is only written when a level or a visibility changes      */
+//////////////////////////////////////////////////////////////////////////////////
+void IndirectScene::Update(const Scene& scene, const glm::mat4& view, const glm::mat4& projection)
+{
+	bool changed = false;
+	triangles = 0;
+	fullDetailTriangles = 0;
+
+	for (GLsizei i = 0; i < nCommands; ++i)
+	{
+		DrawElementsIndirectCommand& command = commands[i];
+
+		// Culled objects keep their command with no instances
+		GLuint instanceCount = scene.IsVisible(itemHandles[i]) ? 1 : 0;
+		if (instanceCount != command.instanceCount)
+		{
+			command.instanceCount = instanceCount;
+			changed = true;
+		}
+		if (instanceCount == 0)
+		{
+			continue;
+		}
+
+		GLuint lod = SelectLod(ProjectedSize(boundingSpheres[i], view, projection), lods[i], meshes[i]->GetLodCount());
+		if (lod != lods[i])
+		{
+			command.count = (GLuint)meshes[i]->GetIndexCount(lod);
+			command.firstIndex = meshes[i]->GetFirstIndex(lod);
+			lods[i] = lod;
+			changed = true;
+		}
+
+		triangles += command.count / 3;
+		fullDetailTriangles += meshes[i]->GetIndexCount(0) / 3;
+	}
+
+	if (changed)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawElementsIndirectCommand) * commands.size(), commands.data());
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+}
+
+/* Draw the whole batch with a single call */
+/////////////////////////////////////////////
+void IndirectScene::Draw() const
+{
+	if (nCommands == 0)
+	{
+		return;
+	}
+
+	// Set shader
+	glUseProgram(program);
+
+	// Every texture of the batch is a layer of one array
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_DATA_BINDING, objectBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glBindVertexArray(arena->GetVertexArray());
+
+	// Draw
+	++gFrameStats.drawCalls;
+	gFrameStats.triangles += triangles;
+	gFrameStats.fullDetailTriangles += fullDetailTriangles;
+	glMultiDrawElementsIndirect(GL_TRIANGLES, arena->GetIndexType(), NULL, nCommands, sizeof(DrawElementsIndirectCommand));
+
+	// Deactivate VAO
+	glBindVertexArray(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	glUseProgram(0);
+}
+
+/* Copy every texture into a layer of one array, scaled to the largest texture's size */
+/* Any index into the array is valid in a shader, unlike an index into sampler arrays */
+////////////////////////////////////////////////////////////////////////////////////////
+void IndirectScene::buildTextureArray(const vector<GLuint>& textures)
+{
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	maxSize = min(maxSize, MAX_INDIRECT_TEXTURE_SIZE);
+
+	GLint width = 1, height = 1;
+	for (size_t i = 0; i < textures.size(); ++i)
+	{
+		GLint textureWidth = 0, textureHeight = 0;
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &textureWidth);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &textureHeight);
+		width = max(width, min(textureWidth, maxSize));
+		height = max(height, min(textureHeight, maxSize));
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// Same sampling as the individual textures
+	glGenTextures(1, &textureArray);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, (GLsizei)textures.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	// The GPU scales each texture into its layer with a filtered blit
+	GLuint framebuffers[2];
+	glGenFramebuffers(2, framebuffers);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+
+	for (size_t i = 0; i < textures.size(); ++i)
+	{
+		GLint textureWidth = 0, textureHeight = 0;
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &textureWidth);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &textureHeight);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], 0);
+		glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureArray, 0, (GLint)i);
+		glBlitFramebuffer(0, 0, textureWidth, textureHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(2, framebuffers);
+}
+
+/* Release the command and object buffers */
+/////////////////////////////////////////////
+void IndirectScene::Destroy()
+{
+	glDeleteBuffers(1, &commandBuffer);
+	glDeleteBuffers(1, &objectBuffer);
+	glDeleteTextures(1, &textureArray);
+
+	arena = NULL;
+	commandBuffer = 0;
+	objectBuffer = 0;
+	textureArray = 0;
+	nCommands = 0;
+
+	commands.clear();
+	itemHandles.clear();
+	meshes.clear();
+	boundingSpheres.clear();
+	lods.clear();
+	triangles = 0;
+	fullDetailTriangles = 0;
+}
+
+/* Destructor */
+////////////////
+IndirectScene::~IndirectScene()
+{
+	Destroy();
+}
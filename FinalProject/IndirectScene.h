@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Mesh.h"
+#include "Scene.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+using namespace std;
+
+// Layers of the texture array the batch samples from, one per distinct texture
+const GLuint MAX_INDIRECT_TEXTURES = 16;
+
+// Textures are scaled to a common size to share the array, at most this large
+const GLint MAX_INDIRECT_TEXTURE_SIZE = 2048;
+
+// Shader storage binding point of the per-object data
+const GLuint OBJECT_DATA_BINDING = 0;
+
+/* Layout of one command in the GL_DRAW_INDIRECT_BUFFER */
+//////////////////////////////////////////////////////////
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+/* Per-object data in std430 layout, indexed by gl_DrawIDARB */
+///////////////////////////////////////////////////////////////
+struct IndirectObjectData
+{
+	glm::mat4 model;
+	glm::vec4 normalMatrix[3]; // Columns of a std430 mat3, each padded to a vec4
+	glm::vec4 color;
+	glm::vec4 positionScale;  // xyz used, w is padding
+	glm::vec4 positionOffset; // xyz used, w is padding
+	GLuint textureLayer;
+	GLuint octahedralNormals;
+	GLuint padding[2];
+};
+
+/* Static scene objects sharing one geometry arena, drawn with one call */
+///////////////////////////////////////////////////////////////////////////
+class IndirectScene
+{
+public:
+	IndirectScene();
+
+	static bool IsSupported();
+
+	GLuint Build(Scene& scene, GLuint objectProgram, GLuint indirectProgram);
+	void Update(const Scene& scene, const glm::mat4& view, const glm::mat4& projection);
+	void Draw() const;
+	void Destroy();
+
+	~IndirectScene();
+
+private:
+	void buildTextureArray(const vector<GLuint>& textures);
+
+	GLuint program;
+	const GeometryArena* arena; // Holds every batched mesh
+	GLuint commandBuffer;
+	GLuint objectBuffer;
+	GLsizei nCommands;
+
+	GLuint textureArray; // One layer per texture of the batch
+
+	// CPU copy of the commands, rewritten when an object changes detail level or visibility
+	vector<DrawElementsIndirectCommand> commands;
+	vector<GLuint> itemHandles;
+	vector<const Mesh*> meshes;
+	vector<glm::vec4> boundingSpheres; // World space
+	vector<GLuint> lods;
+	GLuint triangles;
+	GLuint fullDetailTriangles;
+};
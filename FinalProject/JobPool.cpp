@@ -0,0 +1,137 @@
+#include "JobPool.h"
+
+/* Constructor, one thread per core counting the caller */
+///////////////////////////////////////////////////////////
+JobPool::JobPool()
+{
+	unsigned int cores = thread::hardware_concurrency();
+	start(cores > 1 ? cores - 1 : 0);
+}
+
+/* Constructor with a fixed number of worker threads */
+///////////////////////////////////////////////////////
+JobPool::JobPool(size_t threadCount)
+{
+	start(threadCount);
+}
+
+/* Destructor, lets the workers finish and joins them */
+/////////////////////////////////////////////////////////
+JobPool::~JobPool()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (size_t i = 0; i < workers.size(); ++i)
+	{
+		workers[i].join();
+	}
+}
+
+/* Spawn the worker threads */
+//////////////////////////////
+void JobPool::start(size_t threadCount)
+{
+	stopping = false;
+	generation = 0;
+	activeWorkers = 0;
+	job = NULL;
+	jobCount = 0;
+	nextJob = 0;
+
+	workers.reserve(threadCount);
+	for (size_t i = 0; i < threadCount; ++i)
+	{
+		workers.push_back(thread(&JobPool::workerLoop, this));
+	}
+}
+
+/* Run a loop body for every index, the calling thread works too */
+///////////////////////////////////////////////////////////////////
+void JobPool::ParallelFor(size_t count, const function<void(size_t)>& job)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// Not worth waking anyone for a single job
+	if (workers.empty() || count == 1)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			job(i);
+		}
+		return;
+	}
+
+	{
+		lock_guard<mutex> guard(lock);
+		this->job = &job;
+		jobCount = count;
+		nextJob = 0;
+		activeWorkers = workers.size();
+		++generation;
+	}
+	wake.notify_all();
+
+	runJobs();
+
+	// Workers may still be finishing their last job
+	unique_lock<mutex> guard(lock);
+	done.wait(guard, [this] { return activeWorkers == 0; });
+	this->job = NULL;
+}
+
+/* Get the number of worker threads, not counting the caller */
+///////////////////////////////////////////////////////////////
+size_t JobPool::GetThreadCount() const
+{
+	return workers.size();
+}
+
+/* Wait for a new ParallelFor and help run it */
+/////////////////////////////////////////////////
+void JobPool::workerLoop()
+{
+	size_t seenGeneration = 0;
+
+	while (true)
+	{
+		{
+			unique_lock<mutex> guard(lock);
+			wake.wait(guard, [this, seenGeneration] { return stopping || generation != seenGeneration; });
+			if (stopping)
+			{
+				return;
+			}
+			seenGeneration = generation;
+		}
+
+		runJobs();
+
+		bool last;
+		{
+			lock_guard<mutex> guard(lock);
+			last = --activeWorkers == 0;
+		}
+		if (last)
+		{
+			done.notify_one();
+		}
+	}
+}
+
+/* Claim indices until the loop is exhausted */
+///////////////////////////////////////////////
+void JobPool::runJobs()
+{
+	const function<void(size_t)>& current = *job;
+	for (size_t i = nextJob++; i < jobCount; i = nextJob++)
+	{
+		current(i);
+	}
+}
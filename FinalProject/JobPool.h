@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/* Worker threads that run the iterations of a loop in parallel */
+//////////////////////////////////////////////////////////////////
+class JobPool
+{
+public:
+	JobPool();
+	JobPool(size_t threadCount);
+	~JobPool();
+
+	// Run job(0) .. job(count - 1) across the workers and the calling thread, returns when all are done
+	void ParallelFor(size_t count, const function<void(size_t)>& job);
+	size_t GetThreadCount() const;
+
+private:
+	void start(size_t threadCount);
+	void workerLoop();
+	void runJobs();
+
+	vector<thread> workers;
+
+	mutex lock;
+	condition_variable wake;
+	condition_variable done;
+	bool stopping;
+	size_t generation;  // Bumped for every ParallelFor so workers see new work once
+	size_t activeWorkers;
+
+	const function<void(size_t)>* job;
+	size_t jobCount;
+	atomic<size_t> nextJob;
+};
@@ -0,0 +1,70 @@
+#include "LevelOfDetail.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+/* Move an object space bounding sphere (center, radius) to world space */
+/* The radius grows with the largest axis scale of the model matrix     */
+//////////////////////////////////////////////////////////////////////////
+glm::vec4 TransformBoundingSphere(const glm::vec4& sphere, const glm::mat4& model)
+{
+	glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(sphere), 1.0f));
+
+	float scale = max(glm::length(glm::vec3(model[0])), max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	return glm::vec4(center, sphere.w * scale);
+}
+
+/* Radius of a world space sphere on screen, in half screen heights */
+//////////////////////////////////////////////////////////////////////
+float ProjectedSize(const glm::vec4& worldSphere, const glm::mat4& view, const glm::mat4& projection)
+{
+	// Orthographic projections keep w at 1, perspective ones divide by view depth
+	float w = 1.0f;
+	if (projection[3][3] == 0.0f)
+	{
+		glm::vec4 viewCenter = view * glm::vec4(glm::vec3(worldSphere), 1.0f);
+		w = -viewCenter.z;
+
+		// The camera is inside or next to the sphere
+		if (w <= worldSphere.w)
+		{
+			return numeric_limits<float>::max();
+		}
+	}
+
+	return worldSphere.w * fabs(projection[1][1]) / w;
+}
+
+/* Pick a detail level for a projected size, starting from the level drawn last frame */
+/////////////////////////////////////////////////////////////////////////////////////////
+GLuint SelectLod(float projectedSize, GLuint currentLod, GLuint lodCount)
+{
+	if (lodCount <= 1)
+	{
+		return 0;
+	}
+
+	GLuint lod = min(currentLod, lodCount - 1);
+
+	// Size below which level + 1 is used
+	float threshold = LOD_SCREEN_SIZE / (float)(1 << lod);
+
+	// Coarser while clearly below the current level's threshold
+	while (lod + 1 < lodCount && projectedSize < threshold * (1.0f - LOD_HYSTERESIS))
+	{
+		++lod;
+		threshold *= 0.5f;
+	}
+
+	// Finer while clearly above the next finer level's threshold
+	while (lod > 0 && projectedSize > threshold * 2.0f * (1.0f + LOD_HYSTERESIS))
+	{
+		--lod;
+		threshold *= 2.0f;
+	}
+
+	return lod;
+}
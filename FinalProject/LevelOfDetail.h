@@ -0,0 +1,14 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Projected radius, in half screen heights, below which a mesh drops to level 1, halves for every further level
+const float LOD_SCREEN_SIZE = 0.25f;
+
+// Fraction a projected size must pass a threshold by before the level changes, keeps levels from popping back and forth
+const float LOD_HYSTERESIS = 0.15f;
+
+glm::vec4 TransformBoundingSphere(const glm::vec4& sphere, const glm::mat4& model);
+float ProjectedSize(const glm::vec4& worldSphere, const glm::mat4& view, const glm::mat4& projection);
+GLuint SelectLod(float projectedSize, GLuint currentLod, GLuint lodCount);
@@ -0,0 +1,405 @@
+#include "LightManager.h"
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Nanoseconds to wait on a fence before asking again
+const GLuint64 LIGHT_FENCE_TIMEOUT = 1000000;
+
+/* Distance at which a light of this intensity stops mattering */
+/////////////////////////////////////////////////////////////////
+float LightRange(float intensity)
+{
+	// Solve intensity / (1 + 0.09d + 0.032d^2) = LIGHT_CUTOFF for d
+	float c = 1.0f - intensity / LIGHT_CUTOFF;
+	if (c >= 0.0f)
+	{
+		return 0.0f;
+	}
+
+	return (-0.09f + sqrt(0.09f * 0.09f - 4.0f * 0.032f * c)) / (2.0f * 0.032f);
+}
+
+/* Describe a point light */
+////////////////////////////
+LightDesc LightDesc::Point(const glm::vec3& position, const glm::vec3& color, float intensity, float radius)
+{
+	LightDesc desc = {};
+	desc.type = LIGHT_POINT;
+	desc.position = position;
+	desc.color = color;
+	desc.intensity = intensity;
+	desc.radius = radius;
+	desc.gizmoScale = LIGHT_GIZMO_SCALE;
+	return desc;
+}
+
+/* Describe a directional light, it has no gizmo until given a position */
+//////////////////////////////////////////////////////////////////////////
+LightDesc LightDesc::Directional(const glm::vec3& direction, const glm::vec3& color)
+{
+	LightDesc desc = {};
+	desc.type = LIGHT_DIRECTIONAL;
+	desc.direction = direction;
+	desc.color = color;
+	return desc;
+}
+
+/* Describe a spot light */
+///////////////////////////
+LightDesc LightDesc::Spot(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& color, float intensity, float radius, float innerCone, float outerCone)
+{
+	LightDesc desc = Point(position, color, intensity, radius);
+	desc.type = LIGHT_SPOT;
+	desc.direction = direction;
+	desc.innerCone = innerCone;
+	desc.outerCone = outerCone;
+	return desc;
+}
+
+/* Constructor */
+/////////////////
+LightManager::LightManager()
+{
+	buffer = 0;
+	persistent = false;
+	mapped = NULL;
+	regionSize = 0;
+	region = 0;
+	for (GLuint i = 0; i < LIGHT_BUFFER_REGIONS; ++i)
+	{
+		fences[i] = 0;
+		dirty[i].begin = 0;
+		dirty[i].end = 0;
+	}
+
+	gizmosDirty = false;
+}
+
+/* Check for immutable buffers that can stay mapped while the GPU reads them */
+///////////////////////////////////////////////////////////////////////////////
+bool LightManager::SupportsPersistentMapping()
+{
+	return GLEW_ARB_buffer_storage != 0;
+}
+
+/* Allocate the light buffer, mapped once for good when the driver allows it */
+///////////////////////////////////////////////////////////////////////////////
+void LightManager::Create()
+{
+	Destroy();
+
+	// Every region starts at an offset the storage buffer binding accepts
+	GLint alignment = 1;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	regionSize = sizeof(ClusterLightData) * MAX_LIGHTS;
+	regionSize = (regionSize + alignment - 1) / alignment * alignment;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+
+	persistent = SupportsPersistentMapping();
+	if (persistent)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_SHADER_STORAGE_BUFFER, regionSize * LIGHT_BUFFER_REGIONS, NULL, flags);
+		mapped = (ClusterLightData*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, regionSize * LIGHT_BUFFER_REGIONS, flags);
+
+		if (mapped == NULL)
+		{
+			// Storage is immutable, so start over with a plain buffer
+			cout << "Failed to map the light buffer, lights are uploaded with glBufferSubData" << endl;
+			glDeleteBuffers(1, &buffer);
+			glGenBuffers(1, &buffer);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+			persistent = false;
+		}
+	}
+
+	if (!persistent)
+	{
+		glBufferData(GL_SHADER_STORAGE_BUFFER, regionSize, NULL, GL_DYNAMIC_DRAW);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	// Nothing is in the new buffer yet
+	region = 0;
+	for (GLuint i = 0; i < types.size(); ++i)
+	{
+		markDirty(i);
+	}
+
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHT_DATA_BINDING, buffer, 0, regionSize);
+}
+
+/* Add a light, returns its handle or MAX_LIGHTS when the buffer is full */
+///////////////////////////////////////////////////////////////////////////
+GLuint LightManager::Add(const LightDesc& desc)
+{
+	if (types.size() >= MAX_LIGHTS)
+	{
+		cout << "Cannot add more than " << MAX_LIGHTS << " lights" << endl;
+		return MAX_LIGHTS;
+	}
+
+	types.push_back((GLubyte)desc.type);
+	positions.push_back(desc.position);
+	directions.push_back(desc.type == LIGHT_POINT ? glm::vec3(0.0f) : glm::normalize(desc.direction));
+	colors.push_back(desc.color);
+	intensities.push_back(desc.intensity);
+	radii.push_back(desc.radius);
+	innerCones.push_back(cos(glm::radians(desc.innerCone)));
+	outerCones.push_back(cos(glm::radians(desc.outerCone)));
+	gizmoScales.push_back(desc.gizmoScale);
+
+	GLuint light = (GLuint)types.size() - 1;
+	markDirty(light);
+	gizmosDirty = gizmosDirty || desc.gizmoScale > 0.0f;
+	return light;
+}
+
+/* Move a light */
+//////////////////
+void LightManager::SetPosition(GLuint light, const glm::vec3& position)
+{
+	positions[light] = position;
+	markDirty(light);
+	gizmosDirty = gizmosDirty || gizmoScales[light] > 0.0f;
+}
+
+/* Aim a directional or spot light */
+/////////////////////////////////////
+void LightManager::SetDirection(GLuint light, const glm::vec3& direction)
+{
+	directions[light] = glm::normalize(direction);
+	markDirty(light);
+}
+
+/* Change a light's color and brightness */
+///////////////////////////////////////////
+void LightManager::SetColor(GLuint light, const glm::vec3& color, float intensity)
+{
+	colors[light] = color;
+	intensities[light] = intensity;
+	markDirty(light);
+}
+
+/* Write the lights changed since the region was last written, the rest of the region is still current  */
+/* A mapped buffer moves to the next region so the GPU keeps reading the one it was given               */
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool LightManager::Upload()
+{
+	if (dirty[region].begin == dirty[region].end)
+	{
+		return false;
+	}
+
+	if (buffer != 0 && persistent)
+	{
+		// Draws submitted so far read the current region, so fence them and move on
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		region = (region + 1) % LIGHT_BUFFER_REGIONS;
+
+		if (fences[region] != 0)
+		{
+			while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, LIGHT_FENCE_TIMEOUT) == GL_TIMEOUT_EXPIRED)
+			{
+			}
+			glDeleteSync(fences[region]);
+			fences[region] = 0;
+		}
+	}
+
+	DirtyRange& range = dirty[region];
+	if (buffer != 0 && persistent)
+	{
+		ClusterLightData* target = (ClusterLightData*)((GLubyte*)mapped + regionSize * region);
+		for (GLuint i = range.begin; i < range.end; ++i)
+		{
+			pack(i, target[i]);
+		}
+
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHT_DATA_BINDING, buffer, regionSize * region, regionSize);
+		gFrameStats.uploadedLights += range.end - range.begin;
+	}
+	else if (buffer != 0)
+	{
+		staging.resize(range.end - range.begin);
+		for (GLuint i = range.begin; i < range.end; ++i)
+		{
+			pack(i, staging[i - range.begin]);
+		}
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(ClusterLightData) * range.begin, sizeof(ClusterLightData) * staging.size(), staging.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		gFrameStats.uploadedLights += range.end - range.begin;
+	}
+
+	// Without a buffer the frame data carries the lights, there is nothing to write
+	range.begin = 0;
+	range.end = 0;
+	return true;
+}
+
+/* Put the directional lights, then the point lights, in the fixed slots of the frame data */
+/* The clustered shaders only read the directional ones                                    */
+/////////////////////////////////////////////////////////////////////////////////////////////
+void LightManager::FillFrameData(FrameData& frameData) const
+{
+	int slot = 0;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		GLubyte type = pass == 0 ? LIGHT_DIRECTIONAL : LIGHT_POINT;
+		for (GLuint i = 0; i < types.size() && slot < NR_LIGHTS; ++i)
+		{
+			if (types[i] != type)
+			{
+				continue;
+			}
+
+			LightData& light = frameData.lights[slot++];
+			light.position = glm::vec4(positions[i], 1.0f);
+			light.color = glm::vec4(colors[i], 1.0f);
+			light.direction = directions[i];
+			light.intensity = type == LIGHT_POINT ? intensities[i] : 0.0f;
+		}
+	}
+
+	// A black point light adds nothing
+	for (; slot < NR_LIGHTS; ++slot)
+	{
+		frameData.lights[slot].position = glm::vec4(0.0f);
+		frameData.lights[slot].color = glm::vec4(0.0f);
+		frameData.lights[slot].direction = glm::vec3(0.0f);
+		frameData.lights[slot].intensity = 0.0f;
+	}
+}
+
+/* Give mesh one instance per light that has a gizmo, returns true if they moved */
+///////////////////////////////////////////////////////////////////////////////////
+bool LightManager::UpdateGizmos(Mesh& mesh)
+{
+	if (!gizmosDirty)
+	{
+		return false;
+	}
+
+	gizmoModels.clear();
+	for (GLuint i = 0; i < types.size(); ++i)
+	{
+		if (gizmoScales[i] > 0.0f)
+		{
+			gizmoModels.push_back(glm::translate(positions[i]) * glm::scale(glm::vec3(gizmoScales[i])));
+		}
+	}
+
+	mesh.SetInstanceTransforms(gizmoModels.data(), (GLsizei)gizmoModels.size());
+	gizmosDirty = false;
+	return true;
+}
+
+/* Release the buffer, the lights are kept and written again by the next Create */
+//////////////////////////////////////////////////////////////////////////////////
+void LightManager::Destroy()
+{
+	if (mapped != NULL)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		mapped = NULL;
+	}
+
+	for (GLuint i = 0; i < LIGHT_BUFFER_REGIONS; ++i)
+	{
+		if (fences[i] != 0)
+		{
+			glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+	}
+
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+	persistent = false;
+}
+
+/* Get the number of lights */
+//////////////////////////////
+GLuint LightManager::GetCount() const
+{
+	return (GLuint)types.size();
+}
+
+/* Get the number of lights of one type */
+//////////////////////////////////////////
+GLuint LightManager::GetCount(LightType type) const
+{
+	return (GLuint)count(types.begin(), types.end(), (GLubyte)type);
+}
+
+/* Get the LightType of every light */
+//////////////////////////////////////
+const vector<GLubyte>& LightManager::GetTypes() const
+{
+	return types;
+}
+
+/* Get the world position of every light */
+///////////////////////////////////////////
+const vector<glm::vec3>& LightManager::GetPositions() const
+{
+	return positions;
+}
+
+/* Get the range of every light */
+///////////////////////////////////
+const vector<float>& LightManager::GetRadii() const
+{
+	return radii;
+}
+
+/* Destructor */
+////////////////
+LightManager::~LightManager()
+{
+	Destroy();
+}
+
+/* Add a light to every region's range of lights to write */
+////////////////////////////////////////////////////////////
+void LightManager::markDirty(GLuint light)
+{
+	for (GLuint i = 0; i < LIGHT_BUFFER_REGIONS; ++i)
+	{
+		if (dirty[i].begin == dirty[i].end)
+		{
+			dirty[i].begin = light;
+			dirty[i].end = light + 1;
+		}
+		else
+		{
+			dirty[i].begin = min(dirty[i].begin, light);
+			dirty[i].end = max(dirty[i].end, light + 1);
+		}
+	}
+}
+
+/* Pack one light in the layout the shaders read */
+///////////////////////////////////////////////////
+void LightManager::pack(GLuint light, ClusterLightData& data) const
+{
+	data.positionRadius = glm::vec4(positions[light], radii[light]);
+	data.directionCone = glm::vec4(directions[light], -1.0f);
+	data.colorCone = glm::vec4(colors[light] * intensities[light], 1.0f);
+
+	// Point lights keep a cone covering every direction
+	if (types[light] == LIGHT_SPOT)
+	{
+		data.directionCone.w = outerCones[light];
+		data.colorCone.w = 1.0f / max(innerCones[light] - outerCones[light], 0.0001f);
+	}
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "FrameData.h"
+#include "Mesh.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+using namespace std;
+
+// Most lights the light buffer is sized for
+const GLuint MAX_LIGHTS = 4096;
+
+// Shader storage binding point of the light buffer, after the indirect scene's object data
+const GLuint LIGHT_DATA_BINDING = 1;
+
+// Copies of the light buffer cycled through when it is persistently mapped,
+// so the CPU never writes a copy the GPU may still be reading
+const GLuint LIGHT_BUFFER_REGIONS = 3;
+
+// Share of its intensity at which a light is treated as having no effect
+const float LIGHT_CUTOFF = 1.0f / 256.0f;
+
+// Size of the lamp sphere drawn at a light
+const float LIGHT_GIZMO_SCALE = 0.3f;
+
+enum LightType
+{
+	LIGHT_POINT,
+	LIGHT_DIRECTIONAL,
+	LIGHT_SPOT
+};
+
+// Distance at which the shaders' attenuation falls below LIGHT_CUTOFF
+float LightRange(float intensity);
+
+/* A light to add to the manager, unused parameters are 0 */
+////////////////////////////////////////////////////////////
+struct LightDesc
+{
+	LightType type;
+	glm::vec3 position;         // Directional lights only use it to place their gizmo
+	glm::vec3 direction;        // Directional and spot lights
+	glm::vec3 color;
+	float intensity;
+	float radius;               // Point and spot lights have no effect past it
+	float innerCone, outerCone; // Spot cone half angles in degrees
+	float gizmoScale;           // 0 for no gizmo
+
+	static LightDesc Point(const glm::vec3& position, const glm::vec3& color, float intensity, float radius);
+	static LightDesc Directional(const glm::vec3& direction, const glm::vec3& color);
+	static LightDesc Spot(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& color, float intensity, float radius, float innerCone, float outerCone);
+};
+
+/* One light in std430 layout, matches struct ClusterLight in the clustered shaders */
+//////////////////////////////////////////////////////////////////////////////////////
+struct ClusterLightData
+{
+	glm::vec4 positionRadius;
+	glm::vec4 colorCone;     // Color times intensity, w scales the spot falloff
+	glm::vec4 directionCone; // Spot direction, w is the cosine of the outer cone
+};
+
+/* Owns every light of the scene as packed arrays, uploads only the lights that changed */
+/* and builds the instanced lamp gizmos                                                 */
+//////////////////////////////////////////////////////////////////////////////////////////
+class LightManager
+{
+public:
+	LightManager();
+
+	static bool SupportsPersistentMapping();
+
+	void Create();
+	GLuint Add(const LightDesc& desc);
+	void SetPosition(GLuint light, const glm::vec3& position);
+	void SetDirection(GLuint light, const glm::vec3& direction);
+	void SetColor(GLuint light, const glm::vec3& color, float intensity);
+
+	// Write changed lights into the buffer the next draws read, returns true if any changed
+	bool Upload();
+	void FillFrameData(FrameData& frameData) const;
+	bool UpdateGizmos(Mesh& mesh);
+	void Destroy();
+
+	GLuint GetCount() const;
+	GLuint GetCount(LightType type) const;
+	const vector<GLubyte>& GetTypes() const;
+	const vector<glm::vec3>& GetPositions() const;
+	const vector<float>& GetRadii() const;
+
+	~LightManager();
+
+private:
+	/* Lights [begin, end) changed since a buffer region was last written */
+	/////////////////////////////////////////////////////////////////////////
+	struct DirtyRange
+	{
+		GLuint begin, end;
+	};
+
+	void markDirty(GLuint light);
+	void pack(GLuint light, ClusterLightData& data) const;
+
+	// Packed light arrays, indexed by the handle Add returned
+	vector<GLubyte> types;
+	vector<glm::vec3> positions;
+	vector<glm::vec3> directions;
+	vector<glm::vec3> colors;
+	vector<float> intensities;
+	vector<float> radii;
+	vector<float> innerCones, outerCones; // Cosines
+	vector<float> gizmoScales;
+
+	GLuint buffer;
+	bool persistent;
+	ClusterLightData* mapped; // Start of the mapped buffer when persistent
+	GLsizeiptr regionSize;
+	GLuint region;            // Region the shaders read
+	GLsync fences[LIGHT_BUFFER_REGIONS];
+	DirtyRange dirty[LIGHT_BUFFER_REGIONS];
+
+	bool gizmosDirty;
+	vector<glm::mat4> gizmoModels;
+	vector<ClusterLightData> staging; // Dirty range packed for glBufferSubData
+};
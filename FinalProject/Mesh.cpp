@@ -1,288 +1,77 @@
 #include "Mesh.h"
+#include "FrameStats.h"
+#include "LevelOfDetail.h"
+#include "NormalMatrix.h"
 
-// Light color, position, direction, scale
-glm::vec3 gKeyLightColor(1.0f, 1.0f, 1.0f);
-glm::vec3 gKeyLightPosition(0.0f, 10.0f, 0.0f); // Use for point lights
-glm::vec3 gKeyLightDirection(-0.2f, -1.0f, -0.3f); // Use for directional lights
+#include <algorithm>
+#include <cmath>
+#include <iostream>
 
-glm::vec3 gFillLightColor(1.0f, 0.97f, 0.61f);
-glm::vec3 gFillLightPosition(7.0f, 1.0f, 0.0f); // Use for point lights
-
-glm::vec3 gFillLightColor2(1.0f, 0.97f, 0.61f);
-glm::vec3 gFillLightPosition2(0.0f, 1.0f, -7.0f); // Use for point lights
-
-glm::vec3 gLightScale(0.3f);
+/* Look up the per-draw uniform handles of a program once */
+//////////////////////////////////////////////////////////////
+void DrawUniforms::Resolve(const UniformTable& table)
+{
+	program = table.GetProgram();
+
+	model = table.Location("model");
+	normalMatrix = table.Location("normalMatrix");
+	objectColor = table.Location("objectColor");
+	positionScale = table.Location("positionScale");
+	positionOffset = table.Location("positionOffset");
+	octahedralNormals = table.Location("octahedralNormals");
+}
 
 /* Constructor */
 /////////////////
 Mesh::Mesh()
 {
-	vao = 0;
-	vbo = 0;
-	ibo = 0;
-	nVertices = 0;
+	layout = VertexLayout::PositionNormalUV();
+	quantization.positionScale = glm::vec3(1.0f);
+	quantization.positionOffset = glm::vec3(0.0f);
+	quantization.octahedralNormals = false;
+
+	arena = NULL;
+	allocation.baseVertex = 0;
+	allocation.firstIndex = 0;
+	allocation.vertexCount = 0;
+	allocation.indexCount = 0;
+	boundingSphere = glm::vec4(0.0f);
+	boundingBox.minimum = glm::vec3(0.0f);
+	boundingBox.maximum = glm::vec3(0.0f);
+
+	instanceVao = 0;
+	instanceVbo = 0;
+	nInstances = 0;
+}
+
+/* Generated geometry, reused so creating meshes stops allocating once it is large enough */
+/* One per thread so meshes can be prepared on worker threads                              */
+/////////////////////////////////////////////////////////////////////////////////////////////
+static MeshData& getGenerationScratch()
+{
+	static thread_local MeshData scratch;
+	return scratch;
 }
 
 /* Create the plane as the scene's base */
 //////////////////////////////////////////
 void Mesh::CreatePlane()
 {
-	GLfloat vertices[] =
-	{
-		// Vertex            // Normals          // Texture
-	   -5.0f,  0.0f, -4.0f,  0.0f, 70.0f, 0.0f,  0.0f, 1.0f, // Back Left
-		5.0f,  0.0f, -4.0f,  0.0f, 70.0f, 0.0f,  1.0f, 1.0f, // Back Right
-	   -5.0f,  0.0f,  3.0f,	 0.0f, 70.0f, 0.0f,  0.0f, 0.0f, // Front Left
-
-	   -5.0f,  0.0f,  3.0f,  0.0f, 70.0f, 0.0f,  0.0f, 0.0f, // Front Left
-		5.0f,  0.0f, -4.0f,  0.0f, 70.0f, 0.0f,  1.0f, 1.0f, // Back Right
-		5.0f,  0.0f,  3.0f,  0.0f, 70.0f, 0.0f,  1.0f, 0.0f, // Front Right
-	};
-
-	// Number of coordinates per vertex (x, y, z)
-	const GLuint floatsPerVertex = 3;
-	// Number of normals
-	const GLuint floatsPerNormal = 3;
-	// Number of texture coordinates
-	const GLuint floatsPerUV = 2;
-
-	// Stride between coordinates
-	GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
-	// Get size of vertices and indices for render params
-	GLuint sizeVertices = sizeof(vertices);
-
-	// Get number of indices
-	nVertices = sizeof(vertices) / (sizeof(vertices[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV));
-
-	// Create VAO to store VBO
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
-	// Create buffer object inside VAO
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeVertices, vertices, GL_STATIC_DRAW);
-
-	// Tell OpenGL how to interpret vertex data
-	glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-	glEnableVertexAttribArray(0);
-
-	// For normals
-	glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-	glEnableVertexAttribArray(1);
-
-	// For texture
-	glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (char*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-	glEnableVertexAttribArray(2);
+	Create(PrimitiveDesc::Plane());
 }
 
 /* Create a cube with a given length, height, and width */
 //////////////////////////////////////////////////////////
 void Mesh::CreateCube(float length, float height, float width)
 {
-	GLfloat vertices[] = {
-		// Vertex                  // Normals            // Texture
-		//--------------------------------------------------------------------------
-		// Front face
-		0.0f,    0.0f,    0.0f,    0.0f,  0.0f,  1.0f,   0.0f,  0.0f,  // Bottom left
-		length,  height,  0.0f,    0.0f,  0.0f,  1.0f,   1.0f,  1.0f,  // Top right
-		0.0f,    height,  0.0f,    0.0f,  0.0f,  1.0f,   0.0f,  1.0f,  // Top left
-
-		0.0f,    0.0f,    0.0f,    0.0f,  0.0f,  1.0f,   0.0f,  0.0f,  // Bottom left
-		length,  0.0f,    0.0f,    0.0f,  0.0f,  1.0f,   1.0f,  0.0f,  // Bottom right
-		length,  height,  0.0f,    0.0f,  0.0f,  1.0f,   1.0f,  1.0f,  // Top right
-		// Left face
-		0.0f,    0.0f,   -width,  -1.0f,  0.0f,  0.0f,   0.0f,  0.0f,  // Back bottom left
-		0.0f,    height,  0.0f,   -1.0f,  0.0f,  0.0f,   1.0f,  1.0f,  // Top left
-		0.0f,    height, -width,  -1.0f,  0.0f,  0.0f,   0.0f,  1.0f,  // Back top left
-
-		0.0f,    0.0f,   -width,  -1.0f,  0.0f,  0.0f,   0.0f,  0.0f,  // Back bottom left
-		0.0f,    0.0f,    0.0f,   -1.0f,  0.0f,  0.0f,   1.0f,  0.0f,  // Bottom left
-		0.0f,    height,  0.0f,   -1.0f,  0.0f,  0.0f,   1.0f,  1.0f,  // Top Left
-		// Back face
-		length,  0.0f,   -width,   0.0f,  0.0f, -1.0f,   0.0f,  0.0f,  // Back bottom right
-		0.0f,    height, -width,   0.0f,  0.0f, -1.0f,   1.0f,  1.0f,  // Back top left
-		length,  height, -width,   0.0f,  0.0f, -1.0f,   0.0f,  1.0f,  // Back top right
-
-		length,  0.0f,   -width,   0.0f,  0.0f, -1.0f,   0.0f,  0.0f,  // Back bottom right
-		0.0f,    0.0f,   -width,   0.0f,  0.0f, -1.0f,   1.0f,  0.0f,  // Back bottom left
-		0.0f,    height, -width,   0.0f,  0.0f, -1.0f,   1.0f,  1.0f,  // Back top left
-		// Right face
-		length,  0.0f,    0.0f,    1.0f,  0.0f,  0.0f,   0.0f,  0.0f,  // Bottom right
-		length,  height, -width,   1.0f,  0.0f,  0.0f,   1.0f,  1.0f,  // Back top right
-		length,  height,  0.0f,    1.0f,  0.0f,  0.0f,   0.0f,  1.0f,  // Top right
-
-		length,  0.0f,    0.0f,    1.0f,  0.0f,  0.0f,   0.0f,  0.0f,  // Bottom right
-		length,  0.0f,   -width,   1.0f,  0.0f,  0.0f,   1.0f,  0.0f,  // Back bottom right
-		length,  height, -width,   1.0f,  0.0f,  0.0f,   1.0f,  1.0f,  // Back top right
-		// Top face
-		0.0f,    height,  0.0f,    0.0f,  1.0f,  0.0f,   0.0f,  0.0f,  // Top Left
-		length,  height, -width,   0.0f,  1.0f,  0.0f,   1.0f,  1.0f,  // Back top right
-		0.0f,    height, -width,   0.0f,  1.0f,  0.0f,   0.0f,  1.0f,  // Back top left
-
-		0.0f,    height,  0.0f,    0.0f,  1.0f,  0.0f,   0.0f,  0.0f,  // Top Left
-		length,  height,  0.0f,    0.0f,  1.0f,  0.0f,   1.0f,  0.0f,  // Top right
-		length,  height, -width,   0.0f,  1.0f,  0.0f,   1.0f,  1.0f,  // Back top right
-		// Bottom face
-		0.0f,    0.0f,   -width,   0.0f,  0.0f, -1.0f,   0.0f,  0.0f,  // Back bottom left
-		length,  0.0f,    0.0f,    1.0f,  0.0f,  0.0f,   1.0f,  1.0f,  // Bottom right
-		0.0f,    0.0f,    0.0f,   -1.0f,  0.0f,  0.0f,   0.0f,  1.0f,  // Bottom left
-
-		0.0f,    0.0f,   -width,   0.0f,  0.0f, -1.0f,   0.0f,  0.0f,  // Back bottom left
-		length,  0.0f,   -width,   1.0f,  0.0f,  0.0f,   1.0f,  0.0f,  // Back bottom right
-		length,  0.0f,    0.0f,    1.0f,  0.0f,  0.0f,   1.0f,  1.0f,  // Bottom right
-	};
-	// Number of coordinates per vertex (x, y, z)
-	const GLuint floatsPerVertex = 3;
-	// Number of normals
-	const GLuint floatsPerNormal = 3;
-	// Number of texture coordinates
-	const GLuint floatsPerUV = 2;
-
-	// Stride between coordinates
-	GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
-	// Get size of vertices and indices for render params
-	GLuint sizeVertices = sizeof(vertices);
-
-	// Get number of indices
-	nVertices = sizeof(vertices) / (sizeof(vertices[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV));
-
-	// Create VAO to store VBO
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
-	// Create buffer object inside VAO
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeVertices, vertices, GL_STATIC_DRAW);
-
-	// Tell OpenGL how to interpret vertex data
-	glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-	glEnableVertexAttribArray(0);
-
-	// For normals
-	glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-	glEnableVertexAttribArray(1);
-
-	// For texture
-	glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (char*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-	glEnableVertexAttribArray(2);
+	Create(PrimitiveDesc::Cube(length, height, width));
 }
 
 /* Create a sphere with a given radius, number of sectors, and number of stacks */
 //////////////////////////////////////////////////////////////////////////////////
 void Mesh::CreateSphere(float radius, float sectorCount, float stackCount)
 {
-	const float PI = 3.1415926f;
-	float x, y, z, xy;                              // Vertex position
-	float nx, ny, nz, lengthInv = 1.0f / radius;    // Normal
-	float s, t;                                     // Texture coordinate
-
-	float sectorStep = 2 * PI / sectorCount;
-	float stackStep = PI / stackCount;
-	float sectorAngle, stackAngle;
-
-	vector<GLfloat> vertices;
-
-	for (int i = 0; i <= stackCount; ++i)
-	{
-		stackAngle = PI / 2 - i * stackStep;        // Starting from pi/2 to -pi/2
-		xy = radius * cosf(stackAngle);             // r * cos(u)
-		z = radius * sinf(stackAngle);              // r * sin(u)
-
-		// Add (sectorCount+1) vertices per stack
-		for (int j = 0; j <= sectorCount; ++j)
-		{
-			sectorAngle = j * sectorStep;           // Starting from 0 to 2pi
-
-			// Vertices
-			x = xy * cosf(sectorAngle);             // r * cos(u) * cos(v)
-			y = xy * sinf(sectorAngle);             // r * cos(u) * sin(v)
-			vertices.push_back(x);
-			vertices.push_back(y);
-			vertices.push_back(z);
-
-			// Normals
-			nx = x * lengthInv;
-			ny = y * lengthInv;
-			nz = z * lengthInv;
-			vertices.push_back(nx);
-			vertices.push_back(ny);
-			vertices.push_back(nz);
-
-			// Texture
-			s = (float)j / sectorCount;
-			t = (float)i / stackCount;
-			vertices.push_back(s);
-			vertices.push_back(t);
-		}
-	}
-
-	vector<GLuint> indices;
-	int k1, k2;
-	for (int i = 0; i < stackCount; ++i)
-	{
-		k1 = i * (sectorCount + 1);     // Beginning of current stack
-		k2 = k1 + sectorCount + 1;      // Beginning of next stack
-
-		for (int j = 0; j < sectorCount; ++j, ++k1, ++k2)
-		{
-			// Two triangles per sector excluding first and last stacks
-			if (i != 0)
-			{
-				indices.push_back(k1);
-				indices.push_back(k2);
-				indices.push_back(k1 + 1);
-			}
-
-			if (i != (stackCount - 1))
-			{
-				indices.push_back(k1 + 1);
-				indices.push_back(k2);
-				indices.push_back(k2 + 1);
-			}
-		}
-	}
-
-	// Number of coordinates per vertex (x, y, z)
-	const GLuint floatsPerVertex = 3;
-	// Number of normals
-	const GLuint floatsPerNormal = 3;
-	// Number of texture coordinates
-	const GLuint floatsPerUV = 2;
-
-	GLuint sizeVertices = sizeof(vector<GLfloat>) + (sizeof(GLfloat) * vertices.size());
-	GLuint sizeIndices = sizeof(vector<GLuint>) + (sizeof(GLuint) * indices.size());
-
-	GLfloat* vertexData = vertices.data();
-	GLuint* indexData = indices.data();
-
-	nVertices = sizeIndices;
-	GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
-
-	// Create VAO to store VBO
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeVertices, vertexData, GL_STATIC_DRAW);
-
-	glGenBuffers(1, &ibo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeIndices, indexData, GL_STATIC_DRAW);
-
-	// For vertex coordinates
-	glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-	glEnableVertexAttribArray(0);
-
-	// For normal coordinates
-	glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex)));
-	glEnableVertexAttribArray(1);
-
-	// For texture coordinates
-	glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-	glEnableVertexAttribArray(2);
+	Create(PrimitiveDesc::Sphere(radius, (int)sectorCount, (int)stackCount));
 }
 
 /* Create a cylinder with a given radius, number of sectors, height, and number of stacks */
@@ -290,683 +79,534 @@ void Mesh::CreateSphere(float radius, float sectorCount, float stackCount)
 ////////////////////////////////////////////////////////////////////////////////////////////
 void Mesh::CreateCylinder(float baseRadius, float topRadius, float sectorCount, float height, float stackCount)
 {
-	const float PI = 3.1415926f;
-	float sectorStep = 2 * PI / sectorCount;
-	float sectorAngle;  // Angle of each sector
-	vector<GLfloat> vertices;
-	GLfloat x, y, z, radius;
-
-	vector<GLfloat> unitVertices = getUnitCircleVertices(sectorStep, sectorCount);
-
-	// Compute the normal vector at 0 degree first
-	float zAngle = atan2(baseRadius - topRadius, height);
-	vector<GLfloat> normals = getCylinderNormals(sectorStep, sectorCount, zAngle);
+	Create(PrimitiveDesc::Cylinder(baseRadius, topRadius, (int)sectorCount, height, (int)stackCount));
+}
 
-	// Get vertices of cylinder sides
-	for (int i = 0; i <= stackCount; ++i)
+/* Generate, prepare and upload a primitive on the calling GL thread */
+///////////////////////////////////////////////////////////////////////
+void Mesh::Create(const PrimitiveDesc& desc)
+{
+	PreparedGeometry prepared;
+	if (Prepare(layout, desc, prepared))
 	{
-		z = -(height * 0.5f) + (float)i / stackCount * height;      // Vertex position z
-		radius = baseRadius + (float)i / stackCount * (topRadius - baseRadius); // Keep track of radius for different base sizes
-		float t = 1.0f - (float)i / stackCount;   // Top to bottom
-
-		for (int j = 0, k = 0; j <= sectorCount; ++j, k += 3)
-		{
-			x = unitVertices[k];
-			y = unitVertices[k + 1];
-			// Vertex coordinates
-			vertices.push_back(x * radius);
-			vertices.push_back(y * radius);
-			vertices.push_back(z);
-			// Normals
-			vertices.push_back(normals[k]);
-			vertices.push_back(normals[k + 1]);
-			vertices.push_back(normals[k + 2]);
-			// Texture coordinates
-			vertices.push_back((float)j / sectorCount);
-			vertices.push_back(t);
-		}
+		Upload(prepared);
 	}
+}
 
-	// Keep track of where the base top vertices start, used for indices
-	unsigned int baseVertexIndex = (unsigned int)vertices.size() / 8;
-
-	// Put vertices of base of cylinder
-	z = -height * 0.5f;
-
-	// Vertex coordinates
-	vertices.push_back(0);
-	vertices.push_back(0);
-	vertices.push_back(z);
-	// Normals
-	vertices.push_back(0);
-	vertices.push_back(0);
-	vertices.push_back(-1);
-	// Texture coordinates
-	vertices.push_back(0.5f);
-	vertices.push_back(0.5f);
-
-	for (int i = 0, j = 0; i < sectorCount; ++i, j += 3)
+/* Choose how vertices are stored, call before creating the mesh */
+/////////////////////////////////////////////////////////////////////
+void Mesh::SetVertexLayout(const VertexLayout& layout)
+{
+	this->layout = layout;
+}
+
+/* Prepare and upload vertex and index data in the mesh's vertex layout */
+//////////////////////////////////////////////////////////////////////////
+void Mesh::Upload(const VertexLayout& sourceLayout, const void* vertices, GLsizei vertexCount, const GLuint* indices, GLsizei indexCount)
+{
+	PreparedGeometry prepared;
+	if (Prepare(layout, sourceLayout, vertices, vertexCount, indices, indexCount, prepared))
 	{
-		x = unitVertices[j];
-		y = unitVertices[j + 1];
-		// Vertex coordinates
-		vertices.push_back(x * baseRadius);
-		vertices.push_back(y * baseRadius);
-		vertices.push_back(z);
-		// Normals
-		vertices.push_back(0);
-		vertices.push_back(0);
-		vertices.push_back(-1);
-		// Texture coordinates
-		vertices.push_back(-x * 0.5f + 0.5f);
-		vertices.push_back(-y * 0.5f + 0.5f);
+		Upload(prepared);
 	}
+}
 
-	// Keep track of where the base base vertices start, used for indices
-	unsigned int topVertexIndex = (unsigned int)vertices.size() / 8;
-
-	// Get vertices of top of cylinder
-	z = height * 0.5f;
-	// Vertex coordinates
-	vertices.push_back(0);
-	vertices.push_back(0);
-	vertices.push_back(z);
-	// Normals
-	vertices.push_back(0);
-	vertices.push_back(0);
-	vertices.push_back(1);
-	// Texture coordinates
-	vertices.push_back(0.5f);
-	vertices.push_back(0.5f);
-
-	for (int i = 0, j = 0; i < sectorCount; ++i, j += 3)
+/* Generate a primitive and prepare it for a mesh with the given layout, safe on any thread */
+//////////////////////////////////////////////////////////////////////////////////////////////
+bool Mesh::Prepare(const VertexLayout& layout, const PrimitiveDesc& desc, PreparedGeometry& prepared)
+{
+	if (desc.lodCount > 1)
 	{
-		x = unitVertices[j];
-		y = unitVertices[j + 1];
-		// Vertex coordinates
-		vertices.push_back(x * topRadius);
-		vertices.push_back(y * topRadius);
-		vertices.push_back(z);
-		// Normals
-		vertices.push_back(0);
-		vertices.push_back(0);
-		vertices.push_back(1);
-		// Texture coordinates
-		vertices.push_back(x * 0.5f + 0.5f);
-		vertices.push_back(-y * 0.5f + 0.5f);
+		return prepareLods(layout, desc, prepared);
 	}
 
-	// Get indices for drawing
-	vector<GLuint> indices = getCylinderIndices(stackCount, sectorCount, baseVertexIndex, topVertexIndex);
-
-	// Number of coordinates per vertex (x, y, z)
-	const GLuint floatsPerVertex = 3;
-	// Number of normals
-	const GLuint floatsPerNormal = 3;
-	// Number of texture coordinates
-	const GLuint floatsPerUV = 2;
-
-	GLuint sizeVertices = sizeof(vector<GLfloat>) + (sizeof(GLfloat) * vertices.size());
-	GLuint sizeIndices = sizeof(vector<GLuint>) + (sizeof(GLuint) * indices.size());
-
-	GLfloat* vertexData = vertices.data();
-	GLuint* indexData = indices.data();
-
-	nVertices = sizeIndices;
-	GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
-
-	// Create VAO to store VBO
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeVertices, vertexData, GL_STATIC_DRAW);
-
-	glGenBuffers(1, &ibo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeIndices, indexData, GL_STATIC_DRAW);
-
-	// For vertex coordinates
-	glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-	glEnableVertexAttribArray(0);
-
-	// For texture coordinates
-	glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex)));
-	glEnableVertexAttribArray(1);
+	MeshData& data = getGenerationScratch();
+	GeneratePrimitive(desc, data);
 
-	// For texture coordinates
-	glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-	glEnableVertexAttribArray(2);
+	return Prepare(layout, VertexLayout::PositionNormalUV(), data.vertices.data(), data.GetVertexCount(), data.indices.data(), data.GetIndexCount(), prepared);
 }
 
-/* Get unit circle vertices for a cylinder */
-/////////////////////////////////////////////
-vector<GLfloat> Mesh::getUnitCircleVertices(float sectorStep, float sectorCount)
+/* Whether positions are three floats at the start of every vertex */
+/////////////////////////////////////////////////////////////////////
+static bool hasFloatPositions(const VertexLayout& layout)
 {
-	float sectorAngle;
-	vector<GLfloat> unitVerts;
+	const VertexAttribute& position = layout.attributes[0];
+	return position.location == 0 && position.type == GL_FLOAT && position.components == 3 && position.offset == 0;
+}
 
-	// Get vertices of unit circle
-	for (int i = 0; i <= sectorCount; ++i)
+/* Check that vertices in sourceLayout can be stored in layout */
+/////////////////////////////////////////////////////////////////
+static bool canConvert(const VertexLayout& layout, const VertexLayout& sourceLayout)
+{
+	if (!layout.Matches(sourceLayout) && (!layout.Matches(VertexLayout::PackedPositionNormalUV()) || !sourceLayout.Matches(VertexLayout::PositionNormalUV())))
 	{
-		sectorAngle = i * sectorStep;
-		unitVerts.push_back(cos(sectorAngle)); // x
-		unitVerts.push_back(sin(sectorAngle)); // y
-		unitVerts.push_back(0);                // z
+		cout << "Cannot convert vertices to the mesh's vertex layout" << endl;
+		return false;
 	}
 
-	return unitVerts;
+	return true;
 }
 
-/* Get normals for a cylinder */
-////////////////////////////////
-vector<GLfloat> Mesh::getCylinderNormals(float sectorStep, float sectorCount, float zAngle)
+/* CPU side of an upload, safe on any thread:                            */
+/* duplicate vertices are welded, non-indexed meshes get an index list,  */
+/* triangles and vertices are reordered for the post-transform cache     */
+/* and float vertices are packed when layout is PackedPositionNormalUV   */
+///////////////////////////////////////////////////////////////////////////
+bool Mesh::Prepare(const VertexLayout& layout, const VertexLayout& sourceLayout, const void* vertices, GLsizei vertexCount,
+	const GLuint* indices, GLsizei indexCount, PreparedGeometry& prepared)
 {
-	float sectorAngle;
-
-	// Compute the normal vector at 0 degree first
-	float x0 = cos(zAngle);
-	float y0 = 0;
-	float z0 = sin(zAngle);
-
-	// Rotate (x0, y0, z0) per sector angle
-	std::vector<GLfloat> norms;
-	for (int i = 0; i <= sectorCount; ++i)
+	if (!canConvert(layout, sourceLayout))
 	{
-		sectorAngle = i * sectorStep;
-		norms.push_back(cos(sectorAngle) * x0 - sin(sectorAngle) * y0);   // nx
-		norms.push_back(sin(sectorAngle) * x0 + cos(sectorAngle) * y0);   // ny
-		norms.push_back(z0);  // nz
+		return false;
 	}
 
-	return norms;
-}
+	// Work on copies, welding rewrites both lists
+	const unsigned char* source = (const unsigned char*)vertices;
+	prepared.vertices.assign(source, source + (size_t)vertexCount * sourceLayout.stride);
+	prepared.indices.assign(indices, indices + indexCount);
 
-/* Get indices for a cylinder */
-////////////////////////////////
-vector<GLuint> Mesh::getCylinderIndices(float stackCount, float sectorCount, int baseVertexIndex, int topVertexIndex)
-{
-	vector<GLuint> idx;
-	GLuint k1, k2;
-	// Get indices for sides
-	for (int i = 0; i < stackCount; ++i)
-	{
-		k1 = i * (sectorCount + 1);     // Bebinning of current stack
-		k2 = k1 + sectorCount + 1;      // Beginning of next stack
+	vertexCount = WeldVertices(prepared.vertices.data(), vertexCount, sourceLayout.stride, prepared.indices, &prepared.weldStats);
+	indexCount = (GLsizei)prepared.indices.size();
 
-		for (int j = 0; j < sectorCount; ++j, ++k1, ++k2)
-		{
-			// 2 triangles
-			idx.push_back(k1);
-			idx.push_back(k1 + 1);
-			idx.push_back(k2);
-
-			idx.push_back(k2);
-			idx.push_back(k1 + 1);
-			idx.push_back(k2 + 1);
-		}
-	}
+	// Triangles in cache friendly clusters, outward facing clusters first, vertices in first use order
+	prepared.cacheBefore = AnalyzeVertexCache(prepared.indices.data(), indexCount, vertexCount);
 
-	// Keep track of where the base top indices start
-	unsigned int baseIndex = (unsigned int)idx.size();
+	vector<GLuint> clusters;
+	OptimizeVertexCache(prepared.indices, vertexCount, &clusters);
 
-	// Get indices for base
-	for (int i = 0, k = baseVertexIndex + 1; i < sectorCount; ++i, ++k)
+	if (hasFloatPositions(sourceLayout))
 	{
-		if (i < (sectorCount - 1))
-		{
-			idx.push_back(baseVertexIndex);
-			idx.push_back(k + 1);
-			idx.push_back(k);
-		}
-		else // Last triangle
-		{
-			idx.push_back(baseVertexIndex);
-			idx.push_back(baseVertexIndex + 1);
-			idx.push_back(k);
-		}
+		OptimizeOverdraw(prepared.indices, prepared.vertices.data(), vertexCount, sourceLayout.stride, clusters);
 	}
 
-	// Keep track of where the base top indices start
-	unsigned int topIndex = (unsigned int)idx.size();
+	vertexCount = OptimizeVertexFetch(prepared.vertices.data(), vertexCount, sourceLayout.stride, prepared.indices);
+	prepared.vertices.resize((size_t)vertexCount * sourceLayout.stride);
+	prepared.cacheAfter = AnalyzeVertexCache(prepared.indices.data(), indexCount, vertexCount);
 
-	for (int i = 0, k = topVertexIndex + 1; i < sectorCount; ++i, ++k)
-	{
-		if (i < (sectorCount - 1))
-		{
-			idx.push_back(topVertexIndex);
-			idx.push_back(k);
-			idx.push_back(k + 1);
-		}
-		else
-		{
-			idx.push_back(topVertexIndex);
-			idx.push_back(k);
-			idx.push_back(topVertexIndex + 1);
-		}
-	}
+	prepared.vertexCount = vertexCount;
+	prepared.lods.assign(1, MeshLod());
+	prepared.lods[0].firstIndex = 0;
+	prepared.lods[0].indexCount = indexCount;
 
-	return idx;
+	finishPrepare(layout, sourceLayout, prepared);
+	return true;
 }
 
-/* Draw the plane */
-////////////////////
-void Mesh::RenderPlane(GLuint shaderId, GLuint textureId, GLint width, GLint height, Camera camera, bool perspective, GLfloat* orthoCoords)
+/* Prepare every detail level of a primitive on its own, then append them into one vertex and index range */
+/* Weld and cache statistics are those of the finest level                                                 */
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool Mesh::prepareLods(const VertexLayout& layout, const PrimitiveDesc& desc, PreparedGeometry& prepared)
 {
-	// Set shader
-	glUseProgram(shaderId);
-
-	// Scale the object
-	glm::mat4 scale = glm::scale(glm::vec3(1.0f, 1.0f, 1.0f));
-	// Rotate object
-	glm::mat4 rotation = glm::rotate(glm::radians(0.0f), glm::vec3(0.0, 1.0f, 0.0f));
-	// Move object 
-	glm::mat4 translation = glm::translate(glm::vec3(0.0f, 0.0f, 0.0f));
-	// Model matrix
-	glm::mat4 model = translation * rotation * scale;
+	const VertexLayout sourceLayout = VertexLayout::PositionNormalUV();
+	if (!canConvert(layout, sourceLayout))
+	{
+		return false;
+	}
 
-	// Transform the camera for view space
-	glm::mat4 view = camera.GetViewMatrix();
+	MeshData& data = getGenerationScratch();
+	PreparedGeometry level;
 
-	glm::mat4 projection;
+	prepared.vertices.clear();
+	prepared.indices.clear();
+	prepared.lods.clear();
 
-	// Create a perspective projection for clip space
-	if (perspective)
-	{
-		projection = glm::perspective(glm::radians(camera.Zoom), (GLfloat)width / (GLfloat)height, 0.1f, 100.0f);
-	}
-	else
+	// Levels that would repeat the one before are left out, GetLodCount reports only distinct levels
+	int lodCount = LodLevelCount(desc);
+	for (int i = 0; i < lodCount; ++i)
 	{
-		projection = glm::ortho(orthoCoords[0], orthoCoords[1], orthoCoords[2], orthoCoords[3], 0.0f, 1000.0f);
-	}
+		GeneratePrimitive(LodLevel(desc, i), data);
+		Prepare(sourceLayout, sourceLayout, data.vertices.data(), data.GetVertexCount(), data.indices.data(), data.GetIndexCount(), level);
+
+		GLuint baseVertex = (GLuint)(prepared.vertices.size() / sourceLayout.stride);
 
-	// Set uniform variables for the shaders
-	setUniforms(model, view, projection, shaderId, camera, true);
+		MeshLod lod;
+		lod.firstIndex = (GLuint)prepared.indices.size();
+		lod.indexCount = (GLsizei)level.indices.size();
+		prepared.lods.push_back(lod);
 
-	// Activate VBOs within VAO
-	glBindVertexArray(vao);
+		prepared.vertices.insert(prepared.vertices.end(), level.vertices.begin(), level.vertices.end());
+		for (size_t j = 0; j < level.indices.size(); ++j)
+		{
+			prepared.indices.push_back(level.indices[j] + baseVertex);
+		}
 
-	// Bind textures
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, textureId);
+		if (i == 0)
+		{
+			prepared.weldStats = level.weldStats;
+			prepared.cacheBefore = level.cacheBefore;
+			prepared.cacheAfter = level.cacheAfter;
+		}
+	}
 
-	// Draw
-	glDrawArrays(GL_TRIANGLES, 0, nVertices);
+	prepared.vertexCount = (GLsizei)(prepared.vertices.size() / sourceLayout.stride);
 
-	// Deactivate VAO
-	glBindVertexArray(0);
-	glUseProgram(0);
+	finishPrepare(layout, sourceLayout, prepared);
+	return true;
 }
 
-/* Draw the cube that creates the scene's box */
-////////////////////////////////////////////////
-void Mesh::RenderBox(GLuint shaderId, GLuint textureId, GLint width, GLint height, Camera camera, bool perspective, GLfloat* orthoCoords)
+/* Bound the prepared vertices and pack them when layout is PackedPositionNormalUV */
+/////////////////////////////////////////////////////////////////////////////////////
+void Mesh::finishPrepare(const VertexLayout& layout, const VertexLayout& sourceLayout, PreparedGeometry& prepared)
 {
-	// Set shader
-	glUseProgram(shaderId);
+	prepared.layout = layout;
+	prepared.quantization.positionScale = glm::vec3(1.0f);
+	prepared.quantization.positionOffset = glm::vec3(0.0f);
+	prepared.quantization.octahedralNormals = false;
+	prepared.boundingSphere = glm::vec4(0.0f);
+	prepared.boundingBox.minimum = glm::vec3(0.0f);
+	prepared.boundingBox.maximum = glm::vec3(0.0f);
+
+	if (!hasFloatPositions(sourceLayout) || prepared.vertexCount == 0)
+	{
+		return;
+	}
 
-	// Scale the object
-	glm::mat4 scale = glm::scale(glm::vec3(1.0f, 1.0f, 1.0f));
-	// Rotate object
-	glm::mat4 rotation = glm::rotate(glm::radians(35.0f), glm::vec3(0.0, -1.0f, 0.0f));
-	// Move object 
-	glm::mat4 translation = glm::translate(glm::vec3(0.75f, 0.0f, -1.0f));
-	// Model matrix
-	glm::mat4 model = translation * rotation * scale;
+	// Bounding box, then a sphere around its center
+	GLsizei floatStride = sourceLayout.stride / sizeof(GLfloat);
+	const GLfloat* vertices = (const GLfloat*)prepared.vertices.data();
 
-	// Transform the camera for view space
-	glm::mat4 view = camera.GetViewMatrix();
+	glm::vec3 minimum(vertices[0], vertices[1], vertices[2]);
+	glm::vec3 maximum = minimum;
+	for (GLsizei i = 1; i < prepared.vertexCount; ++i)
+	{
+		glm::vec3 position = glm::make_vec3(vertices + i * floatStride);
+		minimum = glm::min(minimum, position);
+		maximum = glm::max(maximum, position);
+	}
 
-	glm::mat4 projection;
+	prepared.boundingBox.minimum = minimum;
+	prepared.boundingBox.maximum = maximum;
 
-	// Create a perspective projection for clip space
-	if (perspective)
+	glm::vec3 center = (minimum + maximum) * 0.5f;
+	float radiusSquared = 0.0f;
+	for (GLsizei i = 0; i < prepared.vertexCount; ++i)
 	{
-		projection = glm::perspective(glm::radians(camera.Zoom), (GLfloat)width / (GLfloat)height, 0.1f, 100.0f);
+		glm::vec3 offset = glm::make_vec3(vertices + i * floatStride) - center;
+		radiusSquared = max(radiusSquared, glm::dot(offset, offset));
 	}
-	else
+	prepared.boundingSphere = glm::vec4(center, sqrt(radiusSquared));
+
+	if (!layout.Matches(sourceLayout))
 	{
-		projection = glm::ortho(orthoCoords[0], orthoCoords[1], orthoCoords[2], orthoCoords[3], 0.0f, 1000.0f);
+		vector<unsigned char> floatVertices;
+		floatVertices.swap(prepared.vertices);
+		prepared.vertices.resize((size_t)prepared.vertexCount * sizeof(PackedVertex));
+		packVertices((const GLfloat*)floatVertices.data(), prepared.vertexCount, (PackedVertex*)prepared.vertices.data(), prepared.quantization);
 	}
+}
 
-	// Set uniform variables for the shaders
-	setUniforms(model, view, projection, shaderId, camera, true);
-
-	// Activate VBOs within VAO
-	glBindVertexArray(vao);
-
-	// Bind textures
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, textureId);
-
-	// Draw
-	glDrawArrays(GL_TRIANGLES, 0, nVertices);
-
-	// Deactivate VAO
-	glBindVertexArray(0);
-
-	glUseProgram(0);
+/* Print vertex counts and cache behaviour of prepared geometry */
+//////////////////////////////////////////////////////////////////
+void Mesh::PrintReport(const PreparedGeometry& prepared)
+{
+	cout << "Mesh welded from " << prepared.weldStats.verticesBefore << " to " << prepared.weldStats.verticesAfter << " vertices, cache hit ratio "
+		<< prepared.weldStats.cacheHitRatioBefore << " -> " << prepared.weldStats.cacheHitRatioAfter << endl;
+	cout << "Mesh ACMR " << prepared.cacheBefore.acmr << " -> " << prepared.cacheAfter.acmr
+		<< ", ATVR " << prepared.cacheBefore.atvr << " -> " << prepared.cacheAfter.atvr << endl;
 }
 
-/* Draw the cube that create's the scene's notepad */
-/////////////////////////////////////////////////////
-void Mesh::RenderNotepad(GLuint shaderId, GLuint textureId, GLint width, GLint height, Camera camera, bool perspective, GLfloat* orthoCoords)
+/* GPU side of an upload, copies prepared geometry into a shared arena */
+/////////////////////////////////////////////////////////////////////////
+void Mesh::Upload(const PreparedGeometry& prepared)
 {
-	// Set shader
-	glUseProgram(shaderId);
+	ClearMesh();
 
-	// Scale the object
-	glm::mat4 scale = glm::scale(glm::vec3(1.0f, 1.0f, 1.0f));
-	// Rotate object
-	glm::mat4 rotation = glm::rotate(glm::radians(45.0f), glm::vec3(0.0, 1.0f, 0.0f));
-	// Move object 
-	glm::mat4 translation = glm::translate(glm::vec3(-2.0f, 0.0f, 2.0f));
-	// Model matrix
-	glm::mat4 model = translation * rotation * scale;
+	layout = prepared.layout;
+	quantization = prepared.quantization;
+	lods = prepared.lods;
+	boundingSphere = prepared.boundingSphere;
+	boundingBox = prepared.boundingBox;
 
-	// Transform the camera for view space
-	glm::mat4 view = camera.GetViewMatrix();
+	GLsizei vertexCount = prepared.vertexCount;
+	GLsizei indexCount = (GLsizei)prepared.indices.size();
 
-	glm::mat4 projection;
+	// Indices are relative to the base vertex, so small meshes use half the index bandwidth
+	GLenum indexType = vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	arena = GeometryArena::Acquire(layout, indexType, vertexCount, indexCount);
 
-	// Create a perspective projection for clip space
-	if (perspective)
+	bool allocated;
+	if (indexType == GL_UNSIGNED_SHORT)
 	{
-		projection = glm::perspective(glm::radians(camera.Zoom), (GLfloat)width / (GLfloat)height, 0.1f, 100.0f);
+		vector<GLushort> shortIndices(prepared.indices.begin(), prepared.indices.end());
+		allocated = arena->Allocate(prepared.vertices.data(), vertexCount, shortIndices.data(), indexCount, allocation);
 	}
 	else
 	{
-		projection = glm::ortho(orthoCoords[0], orthoCoords[1], orthoCoords[2], orthoCoords[3], 0.0f, 1000.0f);
+		allocated = arena->Allocate(prepared.vertices.data(), vertexCount, prepared.indices.data(), indexCount, allocation);
 	}
 
-	// Set uniform variables for the shaders
-	setUniforms(model, view, projection, shaderId, camera, true);
-
-	// Activate VBOs within VAO
-	glBindVertexArray(vao);
-
-	// Bind textures
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, textureId);
-
-	// Draw
-	glDrawArrays(GL_TRIANGLES, 0, nVertices);
-
-	// Deactivate VAO
-	glBindVertexArray(0);
-
-	glUseProgram(0);
+	if (!allocated)
+	{
+		cout << "Failed to allocate " << vertexCount << " vertices in the geometry arena" << endl;
+		arena = NULL;
+	}
 }
 
-/* Draw the sphere AND the light sources */
-///////////////////////////////////////////
-void Mesh::RenderSphere(GLuint shaderId, GLuint lightShader, GLuint textureId, GLint width, GLint height, Camera camera, bool perspective, GLfloat* orthoCoords)
+/* Upload per-instance model and normal matrices for DrawInstanced */
+//////////////////////////////////////////////////////////////////////
+void Mesh::SetInstanceTransforms(const glm::mat4* models, GLsizei count)
 {
-	/*
-	 * Draw the sphere
-	 */
-
-	// Set shader
-	glUseProgram(shaderId);
-
-	// Scale the object
-	glm::mat4 scale = glm::scale(glm::vec3(1.0f, 1.0f, 1.0f));
-	// Rotate object
-	glm::mat4 rotation = glm::rotate(glm::radians(45.0f), glm::vec3(1.0, 0.0f, 0.0f));
-	// Move object 
-	glm::mat4 translation = glm::translate(glm::vec3(0.0f, 0.49f, -1.5f));
-	// Model matrix
-	glm::mat4 model = translation * rotation * scale;
-
-	// Transform the camera for view space
-	glm::mat4 view = camera.GetViewMatrix();
-
-	glm::mat4 projection;
-
-	if (perspective)
+	// Instanced draws use their own VAO so single draws keep the identity transform
+	if (instanceVao == 0)
 	{
-		// Create a perspective projection for clip space
-		projection = glm::perspective(glm::radians(camera.Zoom), (GLfloat)width / (GLfloat)height, 0.1f, 100.0f);
+		glGenBuffers(1, &instanceVbo);
+		instanceVao = arena->CreateVertexArray(instanceVbo);
 	}
-	else
-	{
-		// Create orthographic projection
-		projection = glm::ortho(orthoCoords[0], orthoCoords[1], orthoCoords[2], orthoCoords[3], 0.0f, 1000.0f);
-	}
-
-	// Set uniform variables for the shaders
-	setUniforms(model, view, projection, shaderId, camera, true);
-
-	// Activate VBOs within VAO
-	glBindVertexArray(vao);
-
-	// Bind textures
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, textureId);
-
-	// Draw
-	glDrawElements(GL_TRIANGLES, nVertices, GL_UNSIGNED_INT, NULL);
 
-	/*
-	 * Draw the directional light
-	 */
+	// Every instance's normal matrix in one batch, the vertex shader no longer inverts per vertex
+	instanceNormals.resize(count);
+	ComputeNormalMatrices(models, instanceNormals.data(), count);
 
-	glUseProgram(lightShader);
+	instanceData.resize(count);
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		instanceData[i].model = models[i];
+		instanceData[i].normalMatrix = instanceNormals[i];
+	}
 
-	//Transform the smaller cube used as a visual que for the light source
-	model = glm::translate(gKeyLightPosition) * glm::scale(gLightScale);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceTransform) * count, instanceData.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-	// Get location of uniform variables in vertex shader
-	GLint modelLoc = glGetUniformLocation(shaderId, "model");
-	GLint viewLoc = glGetUniformLocation(shaderId, "view");
-	GLint projLoc = glGetUniformLocation(shaderId, "projection");
+	nInstances = count;
 
-	// Reference matrix uniforms from the Lamp Shader program
-	modelLoc = glGetUniformLocation(lightShader, "model");
-	viewLoc = glGetUniformLocation(lightShader, "view");
-	projLoc = glGetUniformLocation(lightShader, "projection");
+	instanceSpheres.resize(count);
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		instanceSpheres[i] = TransformBoundingSphere(boundingSphere, models[i]);
+	}
+}
 
-	// Pass matrix data to the Lamp Shader program's matrix uniforms
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-	glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+/* Get the VAO for single draws, shared by every mesh in the same arena */
+/////////////////////////////////////////////////////////////////////////
+GLuint Mesh::GetVertexArray() const
+{
+	return arena != NULL ? arena->GetVertexArray() : 0;
+}
 
-	// Draw
-	glDrawElements(GL_TRIANGLES, nVertices, GL_UNSIGNED_INT, NULL);
+/* Get the arena holding the mesh, NULL before Upload */
+/////////////////////////////////////////////////////////
+const GeometryArena* Mesh::GetArena() const
+{
+	return arena;
+}
 
-	/*
-	 * Draw the point light
-	 */
+/* Get the offset added to every index */
+/////////////////////////////////////////
+GLint Mesh::GetBaseVertex() const
+{
+	return allocation.baseVertex;
+}
 
-	glUseProgram(lightShader);
+/* Get the position of a detail level's first index inside the arena's index buffer */
+///////////////////////////////////////////////////////////////////////////////////////
+GLuint Mesh::GetFirstIndex(GLuint lod) const
+{
+	return allocation.firstIndex + lods[lod].firstIndex;
+}
 
-	//Transform the smaller cube used as a visual que for the light source
-	model = glm::translate(gFillLightPosition) * glm::scale(gLightScale);
+/* Get the number of vertices */
+////////////////////////////////
+GLsizei Mesh::GetVertexCount() const
+{
+	return allocation.vertexCount;
+}
 
-	// Reference matrix uniforms from the Lamp Shader program
-	modelLoc = glGetUniformLocation(lightShader, "model");
-	viewLoc = glGetUniformLocation(lightShader, "view");
-	projLoc = glGetUniformLocation(lightShader, "projection");
+/* Get the number of indices of a detail level */
+//////////////////////////////////////////////////
+GLsizei Mesh::GetIndexCount(GLuint lod) const
+{
+	return lods[lod].indexCount;
+}
 
-	// Pass matrix data to the Lamp Shader program's matrix uniforms
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-	glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+/* Get the number of detail levels, 0 before Upload */
+/////////////////////////////////////////////////////////
+GLuint Mesh::GetLodCount() const
+{
+	return (GLuint)lods.size();
+}
 
-	// Draw
-	glDrawElements(GL_TRIANGLES, nVertices, GL_UNSIGNED_INT, NULL);
+/* Get the object space center and radius that bound every vertex */
+//////////////////////////////////////////////////////////////////////
+const glm::vec4& Mesh::GetBoundingSphere() const
+{
+	return boundingSphere;
+}
 
-	/*
-	 * Draw the point light
-	 */
+/* Get the object space box around every vertex */
+///////////////////////////////////////////////////
+const BoundingBox& Mesh::GetBoundingBox() const
+{
+	return boundingBox;
+}
 
-	glUseProgram(lightShader);
+/* Get the world space bounds of every instance set by SetInstanceTransforms */
+///////////////////////////////////////////////////////////////////////////////
+const vector<glm::vec4>& Mesh::GetInstanceBoundingSpheres() const
+{
+	return instanceSpheres;
+}
 
-	//Transform the smaller cube used as a visual que for the light source
-	model = glm::translate(gFillLightPosition2) * glm::scale(gLightScale);
+/* Get the layout vertices are stored in */
+////////////////////////////////////////////
+const VertexLayout& Mesh::GetVertexLayout() const
+{
+	return layout;
+}
 
-	// Reference matrix uniforms from the Lamp Shader program
-	modelLoc = glGetUniformLocation(lightShader, "model");
-	viewLoc = glGetUniformLocation(lightShader, "view");
-	projLoc = glGetUniformLocation(lightShader, "projection");
+/* Get how to read the stored vertices back */
+///////////////////////////////////////////////
+const VertexQuantization& Mesh::GetQuantization() const
+{
+	return quantization;
+}
 
-	// Pass matrix data to the Lamp Shader program's matrix uniforms
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-	glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+/* Get the VAO with per-instance transforms, 0 before SetInstanceTransforms */
+//////////////////////////////////////////////////////////////////////////////
+GLuint Mesh::GetInstanceVertexArray() const
+{
+	return instanceVao;
+}
 
-	// Draw
-	glDrawElements(GL_TRIANGLES, nVertices, GL_UNSIGNED_INT, NULL);
+/* Issue the draw call for a detail level, GetVertexArray() must be bound */
+/////////////////////////////////////////////////////////////////////////////
+void Mesh::DrawBound(GLuint lod) const
+{
+	if (arena == NULL)
+	{
+		return;
+	}
 
-	// Deactivate VAO
-	glBindVertexArray(0);
+	++gFrameStats.drawCalls;
+	gFrameStats.triangles += lods[lod].indexCount / 3;
+	gFrameStats.fullDetailTriangles += lods[0].indexCount / 3;
 
-	glUseProgram(0);
+	void* firstIndex = (void*)((size_t)GetFirstIndex(lod) * arena->GetIndexSize());
+	glDrawElementsBaseVertex(GL_TRIANGLES, lods[lod].indexCount, arena->GetIndexType(), firstIndex, allocation.baseVertex);
 }
 
-/* Draw the cylinder that create's the pencil body */
-/////////////////////////////////////////////////////
-void Mesh::RenderPencilBody(GLuint shaderId, GLuint textureId, GLint width, GLint height, Camera camera, bool perspective, GLfloat* orthoCoords)
+/* Issue one draw call for every instance at a detail level, GetInstanceVertexArray() must be bound */
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+void Mesh::DrawBoundInstanced(GLuint lod) const
 {
-	glUseProgram(shaderId);
-	// Scale the object
-	glm::mat4 scale = glm::scale(glm::vec3(1.0f, 1.0f, 1.0f));
-	// Rotate object
-	glm::mat4 rotation = glm::rotate(glm::radians(80.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-	// Move object 
-	glm::mat4 translation = glm::translate(glm::vec3(-1.5f, 0.4f, 0.0f));
-	// Model matrix
-	glm::mat4 model = translation * rotation * scale;
+	if (arena == NULL)
+	{
+		return;
+	}
 
-	// Transform the camera for view space
-	glm::mat4 view = camera.GetViewMatrix();
+	++gFrameStats.drawCalls;
+	gFrameStats.triangles += lods[lod].indexCount / 3 * nInstances;
+	gFrameStats.fullDetailTriangles += lods[0].indexCount / 3 * nInstances;
 
-	glm::mat4 projection;
+	void* firstIndex = (void*)((size_t)GetFirstIndex(lod) * arena->GetIndexSize());
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lods[lod].indexCount, arena->GetIndexType(), firstIndex, nInstances, allocation.baseVertex);
+}
 
-	// Create a perspective projection for clip space
-	if (perspective)
+/* Encode a direction on the octahedron, both components in [-1, 1] */
+///////////////////////////////////////////////////////////////////////
+static glm::vec2 encodeOctahedral(glm::vec3 normal)
+{
+	float length = fabs(normal.x) + fabs(normal.y) + fabs(normal.z);
+	if (length == 0.0f)
 	{
-		projection = glm::perspective(glm::radians(camera.Zoom), (GLfloat)width / (GLfloat)height, 0.1f, 100.0f);
+		return glm::vec2(0.0f);
 	}
-	else
+	normal /= length;
+
+	// Fold the lower hemisphere over the diagonals
+	glm::vec2 encoded(normal.x, normal.y);
+	if (normal.z < 0.0f)
 	{
-		projection = glm::ortho(orthoCoords[0], orthoCoords[1], orthoCoords[2], orthoCoords[3], 0.0f, 1000.0f);
+		encoded.x = (1.0f - fabs(normal.y)) * (normal.x >= 0.0f ? 1.0f : -1.0f);
+		encoded.y = (1.0f - fabs(normal.x)) * (normal.y >= 0.0f ? 1.0f : -1.0f);
 	}
 
-	// Set uniform variables for the shaders
-	setUniforms(model, view, projection, shaderId, camera, true);
-
-	// Activate VBOs within VAO
-	glBindVertexArray(vao);
-
-	// Bind textures
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, textureId);
-	
-	// Draw
-	glDrawElements(GL_TRIANGLES, nVertices, GL_UNSIGNED_INT, NULL);
-
-	// Deactivate VAO
-	glBindVertexArray(0);
-	glUseProgram(0);
+	return encoded;
 }
 
-/* Draw the cylinder (cone) the create's the pencil tip */
+/* Quantize a value in [-1, 1] to a signed 10 bit field */
 //////////////////////////////////////////////////////////
-void Mesh::RenderPencilTip(GLuint shaderId, GLuint textureId, GLint width, GLint height, Camera camera, bool perspective, GLfloat* orthoCoords)
+static GLuint packSnorm10(float value)
 {
-	glUseProgram(shaderId);
-	// Scale the object
-	glm::mat4 scale = glm::scale(glm::vec3(1.0f, 1.0f, 1.0f));
-	// Rotate object
-	glm::mat4 rotation = glm::rotate(glm::radians(80.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-	// Move object 
-	glm::mat4 translation = glm::translate(glm::vec3(0.962f, 0.4f, 0.434f));
-	// Model matrix
-	glm::mat4 model = translation * rotation * scale;
-
-	// Transform the camera for view space
-	glm::mat4 view = camera.GetViewMatrix();
+	value = min(max(value, -1.0f), 1.0f);
+	return (GLuint)(GLint)floorf(value * 511.0f + 0.5f) & 0x3FF;
+}
 
-	glm::mat4 projection;
+/* Convert position/normal/uv floats to PackedVertex, positions relative to the bounds */
+/////////////////////////////////////////////////////////////////////////////////////////
+void Mesh::packVertices(const GLfloat* vertices, GLsizei vertexCount, PackedVertex* packed, VertexQuantization& quantization)
+{
+	const int FLOATS_PER_VERTEX = 8;
 
-	// Create a perspective projection for clip space
-	if (perspective)
+	// Bounding box of the positions
+	glm::vec3 minimum(0.0f), maximum(0.0f);
+	for (GLsizei i = 0; i < vertexCount; ++i)
 	{
-		projection = glm::perspective(glm::radians(camera.Zoom), (GLfloat)width / (GLfloat)height, 0.1f, 100.0f);
+		glm::vec3 position = glm::make_vec3(vertices + i * FLOATS_PER_VERTEX);
+		minimum = i == 0 ? position : glm::min(minimum, position);
+		maximum = i == 0 ? position : glm::max(maximum, position);
 	}
-	else
+
+	// Positions are stored in [-1, 1] across the box, flat axes keep a scale of 1
+	glm::vec3 center = (minimum + maximum) * 0.5f;
+	glm::vec3 halfExtent = (maximum - minimum) * 0.5f;
+	for (int axis = 0; axis < 3; ++axis)
 	{
-		projection = glm::ortho(orthoCoords[0], orthoCoords[1], orthoCoords[2], orthoCoords[3], 0.0f, 1000.0f);
+		if (halfExtent[axis] == 0.0f)
+		{
+			halfExtent[axis] = 1.0f;
+		}
 	}
 
-	// Set uniform variables for the shaders
-	setUniforms(model, view, projection, shaderId, camera, true);
-
-	// Activate VBOs within VAO
-	glBindVertexArray(vao);
-
-	// Bind textures
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, textureId);
-
-	// Draw
-	glDrawElements(GL_TRIANGLES, nVertices, GL_UNSIGNED_INT, NULL);
-
-	// Deactivate VAO
-	glBindVertexArray(0);
-	glUseProgram(0);
-}
-
-/* Set the uniform variables for an object to render */
-///////////////////////////////////////////////////////
-void Mesh::setUniforms(glm::mat4 model, glm::mat4 view, glm::mat4 projection, GLuint shaderId, Camera camera, bool hasTexture)
-{
-	// Get location of uniform variables in vertex shader
-	GLint modelLoc = glGetUniformLocation(shaderId, "model");
-	GLint viewLoc = glGetUniformLocation(shaderId, "view");
-	GLint projLoc = glGetUniformLocation(shaderId, "projection");
-
-	// Pass the matrices to the vertex shader
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-	glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+	for (GLsizei i = 0; i < vertexCount; ++i)
+	{
+		const GLfloat* vertex = vertices + i * FLOATS_PER_VERTEX;
+		PackedVertex& out = packed[i];
 
-	// Get location of uniform variables in fragment shader
-	GLint objectColorLoc = glGetUniformLocation(shaderId, "objectColor");
-	GLint viewPositionLoc = glGetUniformLocation(shaderId, "viewPosition");
-	GLint hasTextureLoc = glGetUniformLocation(shaderId, "hasTexture");
+		glm::vec3 position = (glm::make_vec3(vertex) - center) / halfExtent;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float value = min(max(position[axis], -1.0f), 1.0f);
+			out.position[axis] = (GLshort)floorf(value * 32767.0f + 0.5f);
+		}
+		out.padding = 0;
 
-	// Handle multiple lights
-	// Point light
-	glUniform3f(glGetUniformLocation(shaderId, "lights[0].position"), gFillLightPosition.x, gFillLightPosition.y, gFillLightPosition.z);
-	glUniform3f(glGetUniformLocation(shaderId, "lights[0].color"), gFillLightColor.r, gFillLightColor.g, gFillLightColor.b);
-	glUniform1f(glGetUniformLocation(shaderId, "lights[0].intensity"), 1.0f);
-	// Point light
-	glUniform3f(glGetUniformLocation(shaderId, "lights[1].position"), gFillLightPosition2.x, gFillLightPosition2.y, gFillLightPosition2.z);
-	glUniform3f(glGetUniformLocation(shaderId, "lights[1].color"), gFillLightColor2.r, gFillLightColor2.g, gFillLightColor2.b);
-	glUniform1f(glGetUniformLocation(shaderId, "lights[1].intensity"), 1.0f);
-	// Directional light
-	glUniform3f(glGetUniformLocation(shaderId, "lights[2].direction"), gKeyLightDirection.x, gKeyLightDirection.y, gKeyLightDirection.z);
-	glUniform3f(glGetUniformLocation(shaderId, "lights[2].color"), gKeyLightColor.r, gKeyLightColor.g, gKeyLightColor.b);
+		glm::vec2 normal = encodeOctahedral(glm::make_vec3(vertex + 3));
+		out.normal = packSnorm10(normal.x) | (packSnorm10(normal.y) << 10);
 
+		for (int axis = 0; axis < 2; ++axis)
+		{
+			float value = min(max(vertex[6 + axis], 0.0f), 1.0f);
+			out.uv[axis] = (GLushort)floorf(value * 65535.0f + 0.5f);
+		}
+	}
 
-	// Pass the data to the fragment shader
-	glUniform3f(objectColorLoc, 1.0f, 1.0f, 1.0f);
-	const glm::vec3 cameraPosition = camera.Position;
-	glUniform3f(viewPositionLoc, cameraPosition.x, cameraPosition.y, cameraPosition.z);
-	glUniform1i(hasTextureLoc, hasTexture);
+	quantization.positionScale = halfExtent;
+	quantization.positionOffset = center;
+	quantization.octahedralNormals = true;
 }
 
 /* Reset the mesh */
 ////////////////////
 void Mesh::ClearMesh()
 {
-	glDeleteVertexArrays(1, &vao);
-	glDeleteBuffers(1, &vbo);
-	glDeleteBuffers(1, &ibo);
-	nVertices = 0;
+	if (arena != NULL)
+	{
+		arena->Free(allocation);
+		arena = NULL;
+	}
+
+	glDeleteVertexArrays(1, &instanceVao);
+	glDeleteBuffers(1, &instanceVbo);
+	instanceVao = 0;
+	instanceVbo = 0;
+	allocation.vertexCount = 0;
+	allocation.indexCount = 0;
+	lods.clear();
+	nInstances = 0;
+	instanceSpheres.clear();
+	instanceNormals.clear();
+	instanceData.clear();
 }
 
 /* Destructor */
@@ -1,6 +1,12 @@
 #pragma once
 
-#include "dependencies/camera.h"
+#include "BoundingBox.h"
+#include "FrameData.h"
+#include "GeometryArena.h"
+#include "MeshOptimizer.h"
+#include "Primitives.h"
+#include "UniformTable.h"
+#include "VertexLayout.h"
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -10,34 +16,123 @@
 
 using namespace std;
 
+/* Per-draw uniform handles of a shader program, -1 when the program lacks one */
+///////////////////////////////////////////////////////////////////////////////////
+struct DrawUniforms
+{
+	GLuint program;
+	GLint model, normalMatrix;
+	GLint objectColor;
+	GLint positionScale, positionOffset, octahedralNormals;
+
+	void Resolve(const UniformTable& table);
+};
+
+/* Program, texture and color an object is drawn with */
+/////////////////////////////////////////////////////////
+struct Material
+{
+	DrawUniforms uniforms;
+	GLuint textureId; // 0 when untextured
+	glm::vec3 color;
+};
+
+/* Maps a mesh's stored vertices back to object space, identity for float layouts */
+/////////////////////////////////////////////////////////////////////////////////////
+struct VertexQuantization
+{
+	glm::vec3 positionScale;
+	glm::vec3 positionOffset;
+	bool octahedralNormals;
+};
+
+/* Index range of one detail level, relative to the mesh's first index */
+//////////////////////////////////////////////////////////////////////////
+struct MeshLod
+{
+	GLuint firstIndex;
+	GLsizei indexCount;
+};
+
+/* Geometry ready for Upload: welded, cache optimized and in the mesh's vertex layout */
+//////////////////////////////////////////////////////////////////////////////////////////
+struct PreparedGeometry
+{
+	VertexLayout layout;
+	VertexQuantization quantization;
+	vector<unsigned char> vertices;
+	vector<GLuint> indices;
+	GLsizei vertexCount;
+	vector<MeshLod> lods;     // Finest level first, every level shares the vertices
+	glm::vec4 boundingSphere; // Object space center and radius
+	BoundingBox boundingBox;  // Object space
+
+	WeldStats weldStats;
+	VertexCacheStats cacheBefore, cacheAfter;
+};
+
 class Mesh
 {
 public:
 	Mesh();
 
+	void SetVertexLayout(const VertexLayout& layout);
+	const VertexLayout& GetVertexLayout() const;
 	void CreatePlane();
 	void CreateCube(float length, float height, float width);
 	void CreateSphere(float radius, float sectorCount, float stackCount);
 	void CreateCylinder(float baseRadius, float topRadius, float sectorCount, float height, float stackCount);
-	void RenderPlane(GLuint shaderId, GLuint textureId, GLint width, GLint height, Camera camera, bool perspective, GLfloat* orthoCoords);
-	void RenderBox(GLuint shaderId, GLuint textureId, GLint width, GLint height, Camera camera, bool perspective, GLfloat* orthoCoords);
-	void RenderNotepad(GLuint shaderId, GLuint textureId, GLint width, GLint height, Camera camera, bool perspective, GLfloat* orthoCoords);
-	void RenderSphere(GLuint shaderId, GLuint lightShader, GLuint textureId, GLint width, GLint height, Camera camera, bool perspective, GLfloat* orthoCoords);
-	void RenderPencilBody(GLuint shaderId, GLuint textureId, GLint width, GLint height, Camera camera, bool perspective, GLfloat* orthoCoords);
-	void RenderPencilTip(GLuint shaderId, GLuint textureId, GLint width, GLint height, Camera camera, bool perspective, GLfloat* orthoCoords);
+	void Create(const PrimitiveDesc& desc);
+	void Upload(const VertexLayout& sourceLayout, const void* vertices, GLsizei vertexCount, const GLuint* indices, GLsizei indexCount);
+	void Upload(const PreparedGeometry& prepared);
+	void SetInstanceTransforms(const glm::mat4* models, GLsizei count);
+	GLuint GetVertexArray() const;
+	const GeometryArena* GetArena() const;
+	GLint GetBaseVertex() const;
+	GLuint GetFirstIndex(GLuint lod) const;
+	GLsizei GetVertexCount() const;
+	GLsizei GetIndexCount(GLuint lod) const;
+	GLuint GetLodCount() const;
+	const glm::vec4& GetBoundingSphere() const;
+	const BoundingBox& GetBoundingBox() const;
+	const vector<glm::vec4>& GetInstanceBoundingSpheres() const;
+	const VertexQuantization& GetQuantization() const;
+	GLuint GetInstanceVertexArray() const;
+	void DrawBound(GLuint lod) const;
+	void DrawBoundInstanced(GLuint lod) const;
 	void ClearMesh();
 
+	static bool Prepare(const VertexLayout& layout, const PrimitiveDesc& desc, PreparedGeometry& prepared);
+	static bool Prepare(const VertexLayout& layout, const VertexLayout& sourceLayout, const void* vertices, GLsizei vertexCount,
+		const GLuint* indices, GLsizei indexCount, PreparedGeometry& prepared);
+	static void PrintReport(const PreparedGeometry& prepared);
+
 	~Mesh();
 
 private:
-	vector<GLfloat> getUnitCircleVertices(float sectorStep, float sectorCount);
-	vector<GLfloat> getCylinderNormals(float sectorStep, float sectorCount, float zAngle);
-	vector<GLuint> getCylinderIndices(float stackCount, float sectorCount, int baseVertexIndex, int topIndexVertex);
-	void setUniforms(glm::mat4 model, glm::mat4 view, glm::mat4 projection, GLuint shaderId, Camera camera, bool hasTexture);
-
-	GLuint vao;
-	GLuint vbo;
-	GLuint ibo;
-	GLuint nVertices;
+	static bool prepareLods(const VertexLayout& layout, const PrimitiveDesc& desc, PreparedGeometry& prepared);
+	static void finishPrepare(const VertexLayout& layout, const VertexLayout& sourceLayout, PreparedGeometry& prepared);
+	static void packVertices(const GLfloat* vertices, GLsizei vertexCount, PackedVertex* packed, VertexQuantization& quantization);
+
+	// Layout the vertices are stored in and how to read them back
+	VertexLayout layout;
+	VertexQuantization quantization;
+
+	// Vertex and index ranges inside a shared arena
+	GeometryArena* arena;
+	GeometryAllocation allocation;
+
+	// Detail levels inside the allocation, bounds for level selection and culling
+	vector<MeshLod> lods;
+	glm::vec4 boundingSphere;
+	BoundingBox boundingBox;
+
+	// Per-instance transforms for DrawInstanced
+	GLuint instanceVao;
+	GLuint instanceVbo;
+	GLsizei nInstances;
+	vector<glm::vec4> instanceSpheres; // World space bounds of every instance
+	vector<glm::mat3> instanceNormals;
+	vector<InstanceTransform> instanceData; // Staging for the instance buffer
 };
 
@@ -0,0 +1,70 @@
+#include "MeshBatch.h"
+
+#include <iostream>
+
+/* Queue a primitive for a mesh */
+//////////////////////////////////
+void MeshBatch::Add(const shared_ptr<Mesh>& mesh, const PrimitiveDesc& desc)
+{
+	Entry entry;
+	entry.mesh = mesh;
+	entry.desc = desc;
+	entry.ready = false;
+	entries.push_back(entry);
+}
+
+/* Generate, weld, cache optimize and pack every entry on the job pool */
+/////////////////////////////////////////////////////////////////////////
+void MeshBatch::Generate(JobPool& pool)
+{
+	pool.ParallelFor(entries.size(), [this](size_t i)
+		{
+			Entry& entry = entries[i];
+			entry.ready = Mesh::Prepare(entry.mesh->GetVertexLayout(), entry.desc, entry.prepared);
+		});
+}
+
+/* Upload every prepared entry and report the batch once */
+//////////////////////////////////////////////////////////////
+void MeshBatch::Upload()
+{
+	size_t uploaded = 0;
+	GLsizei verticesBefore = 0, verticesAfter = 0, indexCount = 0;
+	float missesBefore = 0.0f, missesAfter = 0.0f;
+
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		Entry& entry = entries[i];
+		if (!entry.ready)
+		{
+			continue;
+		}
+
+		entry.mesh->Upload(entry.prepared);
+
+		// ACMR is per triangle, so weight each mesh by its triangle count
+		float triangles = entry.prepared.indices.size() / 3.0f;
+		verticesBefore += entry.prepared.weldStats.verticesBefore;
+		verticesAfter += entry.prepared.vertexCount;
+		indexCount += (GLsizei)entry.prepared.indices.size();
+		missesBefore += entry.prepared.cacheBefore.acmr * triangles;
+		missesAfter += entry.prepared.cacheAfter.acmr * triangles;
+		++uploaded;
+	}
+
+	if (indexCount > 0)
+	{
+		float triangles = indexCount / 3.0f;
+		cout << "Uploaded " << uploaded << " meshes, " << verticesBefore << " -> " << verticesAfter << " vertices, "
+			<< indexCount << " indices, ACMR " << missesBefore / triangles << " -> " << missesAfter / triangles << endl;
+	}
+
+	entries.clear();
+}
+
+/* Get the number of queued meshes */
+/////////////////////////////////////
+size_t MeshBatch::GetSize() const
+{
+	return entries.size();
+}
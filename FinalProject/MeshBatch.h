@@ -0,0 +1,38 @@
+#pragma once
+
+#include "JobPool.h"
+#include "Mesh.h"
+
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+/* Meshes generated together, CPU work in parallel and GPU uploads in one pass */
+/////////////////////////////////////////////////////////////////////////////////
+class MeshBatch
+{
+public:
+	// Queue a primitive for mesh, the mesh's vertex layout is read when generating
+	// The batch keeps the mesh alive until it is destroyed
+	void Add(const shared_ptr<Mesh>& mesh, const PrimitiveDesc& desc);
+
+	// Generate and prepare every queued primitive, safe to call without a GL context
+	void Generate(JobPool& pool);
+
+	// Upload the prepared geometry, call on the GL thread after Generate
+	void Upload();
+
+	size_t GetSize() const;
+
+private:
+	struct Entry
+	{
+		shared_ptr<Mesh> mesh;
+		PrimitiveDesc desc;
+		PreparedGeometry prepared;
+		bool ready;
+	};
+
+	vector<Entry> entries;
+};
@@ -0,0 +1,427 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+/* FNV-1a over a vertex's bytes */
+//////////////////////////////////
+static uint32_t hashVertex(const unsigned char* vertex, GLsizei stride)
+{
+	uint32_t hash = 2166136261u;
+	for (GLsizei i = 0; i < stride; ++i)
+	{
+		hash ^= vertex[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/* Merge bitwise identical vertices and remap the indices to the survivors */
+/* Vertices are compacted in place, returns the new vertex count           */
+/* An empty index list is treated as a non-indexed triangle list           */
+/////////////////////////////////////////////////////////////////////////////
+GLsizei WeldVertices(void* vertices, GLsizei vertexCount, GLsizei stride, vector<GLuint>& indices, WeldStats* stats)
+{
+	unsigned char* bytes = (unsigned char*)vertices;
+
+	if (indices.empty())
+	{
+		indices.resize(vertexCount);
+		for (GLsizei i = 0; i < vertexCount; ++i)
+		{
+			indices[i] = (GLuint)i;
+		}
+	}
+
+	if (stats != NULL)
+	{
+		stats->verticesBefore = vertexCount;
+		stats->cacheHitRatioBefore = VertexCacheHitRatio(indices.data(), (GLsizei)indices.size(), vertexCount);
+	}
+
+	// Open addressing table of surviving vertices, at most half full
+	GLsizei tableSize = 1;
+	while (tableSize < vertexCount * 2)
+	{
+		tableSize *= 2;
+	}
+	vector<GLint> table(tableSize, -1);
+
+	vector<GLuint> remap(vertexCount);
+	GLsizei uniqueCount = 0;
+
+	for (GLsizei i = 0; i < vertexCount; ++i)
+	{
+		const unsigned char* vertex = bytes + (size_t)i * stride;
+		GLsizei slot = hashVertex(vertex, stride) & (tableSize - 1);
+
+		while (table[slot] >= 0 && memcmp(bytes + (size_t)table[slot] * stride, vertex, stride) != 0)
+		{
+			slot = (slot + 1) & (tableSize - 1);
+		}
+
+		if (table[slot] < 0)
+		{
+			// First occurrence, move it down to the next free spot
+			if (uniqueCount != i)
+			{
+				memcpy(bytes + (size_t)uniqueCount * stride, vertex, stride);
+			}
+			table[slot] = uniqueCount;
+			++uniqueCount;
+		}
+
+		remap[i] = (GLuint)table[slot];
+	}
+
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		indices[i] = remap[indices[i]];
+	}
+
+	if (stats != NULL)
+	{
+		stats->verticesAfter = uniqueCount;
+		stats->cacheHitRatioAfter = VertexCacheHitRatio(indices.data(), (GLsizei)indices.size(), uniqueCount);
+	}
+
+	return uniqueCount;
+}
+
+/* Fraction of indices served by a FIFO post-transform cache of VERTEX_CACHE_SIZE */
+////////////////////////////////////////////////////////////////////////////////////
+float VertexCacheHitRatio(const GLuint* indices, GLsizei indexCount, GLsizei vertexCount)
+{
+	return AnalyzeVertexCache(indices, indexCount, vertexCount).hitRatio;
+}
+
+/* Transforms, hits and distinct vertices of a FIFO cache of VERTEX_CACHE_SIZE */
+/////////////////////////////////////////////////////////////////////////////////
+VertexCacheStats AnalyzeVertexCache(const GLuint* indices, GLsizei indexCount, GLsizei vertexCount)
+{
+	VertexCacheStats stats = { 0.0f, 0.0f, 0.0f };
+	if (indexCount == 0)
+	{
+		return stats;
+	}
+
+	vector<GLsizei> cachedAt(vertexCount, -VERTEX_CACHE_SIZE - 1);
+	vector<bool> referenced(vertexCount, false);
+	GLsizei entries = 0;
+	GLsizei referencedCount = 0;
+
+	for (GLsizei i = 0; i < indexCount; ++i)
+	{
+		GLuint index = indices[i];
+		if (entries - cachedAt[index] > VERTEX_CACHE_SIZE)
+		{
+			cachedAt[index] = entries;
+			++entries;
+		}
+		if (!referenced[index])
+		{
+			referenced[index] = true;
+			++referencedCount;
+		}
+	}
+
+	// Every cache entry is one vertex shader invocation
+	stats.hitRatio = (float)(indexCount - entries) / indexCount;
+	stats.acmr = (float)entries / (indexCount / 3);
+	stats.atvr = (float)entries / referencedCount;
+	return stats;
+}
+
+/* Pick the next fanning vertex: the most recently cached candidate that will stay cached */
+/* Falls back to the dead-end stack, then to the next vertex with triangles left         */
+/////////////////////////////////////////////////////////////////////////////////////////////
+static GLint nextFanningVertex(const vector<GLuint>& candidates, const vector<GLuint>& liveTriangles, const vector<GLsizei>& cachedAt,
+	GLsizei timestamp, vector<GLuint>& deadEnds, GLsizei& cursor, GLsizei vertexCount, bool& cacheFlushed)
+{
+	GLint best = -1;
+	GLsizei bestPriority = -1;
+
+	for (size_t i = 0; i < candidates.size(); ++i)
+	{
+		GLuint vertex = candidates[i];
+		if (liveTriangles[vertex] == 0)
+		{
+			continue;
+		}
+
+		// Vertices whose fan would push them out of the cache are not worth following
+		GLsizei priority = 0;
+		if (timestamp - cachedAt[vertex] + 2 * (GLsizei)liveTriangles[vertex] <= VERTEX_CACHE_SIZE)
+		{
+			priority = timestamp - cachedAt[vertex];
+		}
+
+		if (priority > bestPriority)
+		{
+			best = (GLint)vertex;
+			bestPriority = priority;
+		}
+	}
+
+	if (best >= 0)
+	{
+		return best;
+	}
+
+	// Nothing adjacent is left, the cache contents are lost from here on
+	cacheFlushed = true;
+
+	while (!deadEnds.empty())
+	{
+		GLuint vertex = deadEnds.back();
+		deadEnds.pop_back();
+		if (liveTriangles[vertex] > 0)
+		{
+			return (GLint)vertex;
+		}
+	}
+
+	while (cursor < vertexCount)
+	{
+		if (liveTriangles[cursor] > 0)
+		{
+			return (GLint)cursor;
+		}
+		++cursor;
+	}
+
+	return -1;
+}
+
+/* Reorder triangles for the post-transform cache (Tipsify, Sander et al. 2007) */
+/* Optionally returns the first triangle of every cluster for OptimizeOverdraw  */
+//////////////////////////////////////////////////////////////////////////////////
+void OptimizeVertexCache(vector<GLuint>& indices, GLsizei vertexCount, vector<GLuint>* clusters)
+{
+	GLsizei triangleCount = (GLsizei)indices.size() / 3;
+
+	// Triangles using each vertex, stored as offsets into one list
+	vector<GLuint> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		++liveTriangles[indices[i]];
+	}
+
+	vector<GLuint> adjacencyOffsets(vertexCount + 1, 0);
+	for (GLsizei v = 0; v < vertexCount; ++v)
+	{
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+	}
+
+	vector<GLuint> adjacency(indices.size());
+	vector<GLuint> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (GLsizei t = 0; t < triangleCount; ++t)
+	{
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			GLuint vertex = indices[t * 3 + corner];
+			adjacency[fill[vertex]++] = (GLuint)t;
+		}
+	}
+
+	vector<GLsizei> cachedAt(vertexCount, 0);
+	vector<bool> emitted(triangleCount, false);
+	vector<GLuint> deadEnds;
+	vector<GLuint> candidates;
+	vector<GLuint> output;
+
+	// Reserve the worst case so no list grows while fanning
+	GLuint maxTriangles = 0;
+	for (GLsizei v = 0; v < vertexCount; ++v)
+	{
+		maxTriangles = max(maxTriangles, liveTriangles[v]);
+	}
+	deadEnds.reserve(indices.size());
+	candidates.reserve((size_t)maxTriangles * 3);
+	output.reserve(indices.size());
+
+	GLsizei timestamp = VERTEX_CACHE_SIZE + 1;
+	GLsizei cursor = 1;
+	GLint fanning = vertexCount > 0 ? 0 : -1;
+	bool cacheFlushed = true;
+
+	if (clusters != NULL)
+	{
+		clusters->clear();
+		clusters->reserve(triangleCount);
+	}
+
+	while (fanning >= 0)
+	{
+		if (cacheFlushed && clusters != NULL)
+		{
+			clusters->push_back((GLuint)output.size() / 3);
+		}
+		cacheFlushed = false;
+
+		// Emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (GLuint a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; ++a)
+		{
+			GLuint triangle = adjacency[a];
+			if (emitted[triangle])
+			{
+				continue;
+			}
+
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				GLuint vertex = indices[triangle * 3 + corner];
+				output.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				--liveTriangles[vertex];
+
+				if (timestamp - cachedAt[vertex] > VERTEX_CACHE_SIZE)
+				{
+					cachedAt[vertex] = timestamp;
+					++timestamp;
+				}
+			}
+
+			emitted[triangle] = true;
+		}
+
+		fanning = nextFanningVertex(candidates, liveTriangles, cachedAt, timestamp, deadEnds, cursor, vertexCount, cacheFlushed);
+	}
+
+	indices.swap(output);
+}
+
+/* Sort clusters so triangles facing out from the mesh center draw first (Sander et al. 2007) */
+/* The order is kept only while the ACMR stays within OVERDRAW_ACMR_THRESHOLD                 */
+/* Positions are read as three floats at the start of each vertex                             */
+////////////////////////////////////////////////////////////////////////////////////////////////
+void OptimizeOverdraw(vector<GLuint>& indices, const void* vertices, GLsizei vertexCount, GLsizei stride, const vector<GLuint>& clusters)
+{
+	const unsigned char* bytes = (const unsigned char*)vertices;
+	GLuint triangleCount = (GLuint)indices.size() / 3;
+
+	if (clusters.size() < 2)
+	{
+		return;
+	}
+
+	// Mesh centroid, averaged over the triangle corners
+	float meshCenter[3] = { 0.0f, 0.0f, 0.0f };
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		const GLfloat* position = (const GLfloat*)(bytes + (size_t)indices[i] * stride);
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			meshCenter[axis] += position[axis] / indices.size();
+		}
+	}
+
+	// Outward facing clusters get a high sort value
+	struct Cluster
+	{
+		GLuint firstTriangle, triangleCount;
+		float sortValue;
+	};
+	vector<Cluster> sorted(clusters.size());
+
+	for (size_t c = 0; c < clusters.size(); ++c)
+	{
+		Cluster& cluster = sorted[c];
+		cluster.firstTriangle = clusters[c];
+		cluster.triangleCount = (c + 1 < clusters.size() ? clusters[c + 1] : triangleCount) - clusters[c];
+
+		float center[3] = { 0.0f, 0.0f, 0.0f };
+		float normal[3] = { 0.0f, 0.0f, 0.0f };
+		for (GLuint t = cluster.firstTriangle; t < cluster.firstTriangle + cluster.triangleCount; ++t)
+		{
+			const GLfloat* p0 = (const GLfloat*)(bytes + (size_t)indices[t * 3] * stride);
+			const GLfloat* p1 = (const GLfloat*)(bytes + (size_t)indices[t * 3 + 1] * stride);
+			const GLfloat* p2 = (const GLfloat*)(bytes + (size_t)indices[t * 3 + 2] * stride);
+
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+
+			// Area weighted normal
+			normal[0] += e1[1] * e2[2] - e1[2] * e2[1];
+			normal[1] += e1[2] * e2[0] - e1[0] * e2[2];
+			normal[2] += e1[0] * e2[1] - e1[1] * e2[0];
+
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				center[axis] += (p0[axis] + p1[axis] + p2[axis]) / (3.0f * cluster.triangleCount);
+			}
+		}
+
+		cluster.sortValue = 0.0f;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			cluster.sortValue += (center[axis] - meshCenter[axis]) * normal[axis];
+		}
+	}
+
+	// Stable insertion by sort value keeps equal clusters in cache order
+	for (size_t i = 1; i < sorted.size(); ++i)
+	{
+		Cluster cluster = sorted[i];
+		size_t j = i;
+		while (j > 0 && sorted[j - 1].sortValue < cluster.sortValue)
+		{
+			sorted[j] = sorted[j - 1];
+			--j;
+		}
+		sorted[j] = cluster;
+	}
+
+	vector<GLuint> output;
+	output.reserve(indices.size());
+	for (size_t c = 0; c < sorted.size(); ++c)
+	{
+		const Cluster& cluster = sorted[c];
+		output.insert(output.end(), indices.begin() + cluster.firstTriangle * 3, indices.begin() + (cluster.firstTriangle + cluster.triangleCount) * 3);
+	}
+
+	float acmrBefore = AnalyzeVertexCache(indices.data(), (GLsizei)indices.size(), vertexCount).acmr;
+	float acmrAfter = AnalyzeVertexCache(output.data(), (GLsizei)output.size(), vertexCount).acmr;
+	if (acmrAfter <= acmrBefore * OVERDRAW_ACMR_THRESHOLD)
+	{
+		indices.swap(output);
+	}
+}
+
+/* Store vertices in the order the indices first use them, drops unused vertices */
+/* Vertices are rearranged in place, returns the new vertex count                */
+///////////////////////////////////////////////////////////////////////////////////
+GLsizei OptimizeVertexFetch(void* vertices, GLsizei vertexCount, GLsizei stride, vector<GLuint>& indices)
+{
+	unsigned char* bytes = (unsigned char*)vertices;
+
+	const GLuint UNUSED = 0xFFFFFFFF;
+	vector<GLuint> remap(vertexCount, UNUSED);
+	GLuint nextVertex = 0;
+
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		GLuint& target = remap[indices[i]];
+		if (target == UNUSED)
+		{
+			target = nextVertex++;
+		}
+		indices[i] = target;
+	}
+
+	vector<unsigned char> reordered((size_t)nextVertex * stride);
+	for (GLsizei v = 0; v < vertexCount; ++v)
+	{
+		if (remap[v] != UNUSED)
+		{
+			memcpy(reordered.data() + (size_t)remap[v] * stride, bytes + (size_t)v * stride, stride);
+		}
+	}
+	memcpy(bytes, reordered.data(), reordered.size());
+
+	return (GLsizei)nextVertex;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+
+using namespace std;
+
+// Entries in the simulated post-transform vertex cache
+const GLsizei VERTEX_CACHE_SIZE = 16;
+
+/* Vertex counts and cache behaviour before and after welding */
+////////////////////////////////////////////////////////////////
+struct WeldStats
+{
+	GLsizei verticesBefore, verticesAfter;
+	float cacheHitRatioBefore, cacheHitRatioAfter;
+};
+
+/* Post-transform cache behaviour of an index list */
+//////////////////////////////////////////////////////
+struct VertexCacheStats
+{
+	float hitRatio; // Indices served from the cache
+	float acmr;     // Average cache miss ratio, transformed vertices per triangle
+	float atvr;     // Average transform to vertex ratio, 1.0 is ideal
+};
+
+// Clusters may raise the ACMR by this factor when they are sorted against overdraw
+const float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+GLsizei WeldVertices(void* vertices, GLsizei vertexCount, GLsizei stride, vector<GLuint>& indices, WeldStats* stats);
+void OptimizeVertexCache(vector<GLuint>& indices, GLsizei vertexCount, vector<GLuint>* clusters);
+void OptimizeOverdraw(vector<GLuint>& indices, const void* vertices, GLsizei vertexCount, GLsizei stride, const vector<GLuint>& clusters);
+GLsizei OptimizeVertexFetch(void* vertices, GLsizei vertexCount, GLsizei stride, vector<GLuint>& indices);
+float VertexCacheHitRatio(const GLuint* indices, GLsizei indexCount, GLsizei vertexCount);
+VertexCacheStats AnalyzeVertexCache(const GLuint* indices, GLsizei indexCount, GLsizei vertexCount);
@@ -0,0 +1,78 @@
+#include "NormalMatrix.h"
+
+// Each SSE lane inverts one matrix, so four are inverted per pass
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NORMAL_MATRIX_SSE
+#include <emmintrin.h>
+#endif
+
+/* Inverse transpose of one model matrix */
+///////////////////////////////////////////
+glm::mat3 NormalMatrix(const glm::mat4& model)
+{
+	// Each column of the inverse transpose is the cross product of the other two columns, over the determinant
+	glm::vec3 a(model[0]), b(model[1]), c(model[2]);
+	glm::mat3 cofactors(glm::cross(b, c), glm::cross(c, a), glm::cross(a, b));
+	float determinant = glm::dot(a, cofactors[0]);
+
+	// A flattened matrix keeps its cofactors, the shaders normalize the result anyway
+	return determinant != 0.0f ? cofactors * (1.0f / determinant) : cofactors;
+}
+
+/* Inverse transpose of many model matrices */
+//////////////////////////////////////////////
+void ComputeNormalMatrices(const glm::mat4* models, glm::mat3* normals, size_t count)
+{
+	size_t i = 0;
+
+#ifdef NORMAL_MATRIX_SSE
+	const __m128 one = _mm_set1_ps(1.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		// Element [column][row] of all four matrices, one matrix per lane
+		__m128 m[3][3];
+		for (int column = 0; column < 3; ++column)
+		{
+			for (int row = 0; row < 3; ++row)
+			{
+				m[column][row] = _mm_setr_ps(models[i][column][row], models[i + 1][column][row], models[i + 2][column][row], models[i + 3][column][row]);
+			}
+		}
+
+		// Same cross products as NormalMatrix
+		__m128 n[3][3];
+		for (int column = 0; column < 3; ++column)
+		{
+			const __m128* p = m[(column + 1) % 3];
+			const __m128* q = m[(column + 2) % 3];
+			n[column][0] = _mm_sub_ps(_mm_mul_ps(p[1], q[2]), _mm_mul_ps(p[2], q[1]));
+			n[column][1] = _mm_sub_ps(_mm_mul_ps(p[2], q[0]), _mm_mul_ps(p[0], q[2]));
+			n[column][2] = _mm_sub_ps(_mm_mul_ps(p[0], q[1]), _mm_mul_ps(p[1], q[0]));
+		}
+
+		// Lanes with a zero determinant divide by one instead
+		__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][0], n[0][0]), _mm_mul_ps(m[0][1], n[0][1])), _mm_mul_ps(m[0][2], n[0][2]));
+		__m128 flat = _mm_cmpeq_ps(determinant, _mm_setzero_ps());
+		__m128 scale = _mm_div_ps(one, _mm_or_ps(_mm_andnot_ps(flat, determinant), _mm_and_ps(flat, one)));
+
+		float lanes[4];
+		for (int column = 0; column < 3; ++column)
+		{
+			for (int row = 0; row < 3; ++row)
+			{
+				_mm_storeu_ps(lanes, _mm_mul_ps(n[column][row], scale));
+				for (int lane = 0; lane < 4; ++lane)
+				{
+					normals[i + lane][column][row] = lanes[lane];
+				}
+			}
+		}
+	}
+#endif
+
+	// Whatever is left over, or everything without SSE
+	for (; i < count; ++i)
+	{
+		normals[i] = NormalMatrix(models[i]);
+	}
+}
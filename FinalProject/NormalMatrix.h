@@ -0,0 +1,11 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+// Inverse transpose of a model matrix's upper 3x3, keeps normals perpendicular to surfaces under non-uniform scale
+glm::mat3 NormalMatrix(const glm::mat4& model);
+
+// Fill normals[i] with NormalMatrix(models[i]), four matrices per SIMD pass
+void ComputeNormalMatrices(const glm::mat4* models, glm::mat3* normals, size_t count);
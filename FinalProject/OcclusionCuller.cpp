@@ -0,0 +1,282 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Four pixels of a row are rasterized per instruction
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_SSE
+#include <emmintrin.h>
+#endif
+
+// Pixels this far outside an edge still count as covered
+const float EDGE_BIAS = 1.0f / 1024.0f;
+
+// Corner order of a box is x, then y, then z as the low, middle and high bit
+static const int BOX_FACES[6][4] =
+{
+	{ 0, 2, 6, 4 }, // -x
+	{ 1, 5, 7, 3 }, // +x
+	{ 0, 4, 5, 1 }, // -y
+	{ 2, 3, 7, 6 }, // +y
+	{ 0, 1, 3, 2 }, // -z
+	{ 4, 6, 7, 5 }, // +z
+};
+
+/* Project the corners of a box, false when a corner is behind the near plane */
+/* Screen positions are in pixels of the depth buffer, z is depth in [0, 1]  */
+////////////////////////////////////////////////////////////////////////////////
+static bool projectBox(const glm::mat4& transform, const glm::vec3& minimum, const glm::vec3& maximum, glm::vec3 corners[8])
+{
+	for (int i = 0; i < 8; ++i)
+	{
+		glm::vec3 corner(i & 1 ? maximum.x : minimum.x, i & 2 ? maximum.y : minimum.y, i & 4 ? maximum.z : minimum.z);
+		glm::vec4 clip = transform * glm::vec4(corner, 1.0f);
+
+		// Nothing is clipped, so boxes crossing the near plane are left to the GPU
+		if (clip.w <= 0.0f || clip.z < -clip.w)
+		{
+			return false;
+		}
+
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		corners[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH, (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT, ndc.z * 0.5f + 0.5f);
+	}
+
+	return true;
+}
+
+/* Constructor, allocates the depth buffer and every pyramid level */
+/////////////////////////////////////////////////////////////////////
+OcclusionCuller::OcclusionCuller()
+{
+	int width = OCCLUSION_WIDTH, height = OCCLUSION_HEIGHT;
+	while (true)
+	{
+		levels.push_back(vector<float>(width * height, 1.0f));
+		levelWidths.push_back(width);
+		levelHeights.push_back(height);
+
+		if (width == 1 && height == 1)
+		{
+			break;
+		}
+		width = max(width / 2, 1);
+		height = max(height / 2, 1);
+	}
+
+	viewProjection = glm::mat4(1.0f);
+	occluderCount = 0;
+}
+
+/* Clear the depth buffer to the far plane */
+/////////////////////////////////////////////
+void OcclusionCuller::Begin(const glm::mat4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+	fill(levels[0].begin(), levels[0].end(), 1.0f);
+	occluderCount = 0;
+}
+
+/* Rasterize every face of a box, boxes crossing the near plane are skipped */
+//////////////////////////////////////////////////////////////////////////////
+void OcclusionCuller::AddOccluder(const BoundingBox& box, const glm::mat4& model)
+{
+	glm::vec3 corners[8];
+	if (!projectBox(viewProjection * model, box.minimum, box.maximum, corners))
+	{
+		return;
+	}
+
+	for (int face = 0; face < 6; ++face)
+	{
+		const int* quad = BOX_FACES[face];
+		rasterizeTriangle(corners[quad[0]], corners[quad[1]], corners[quad[2]]);
+		rasterizeTriangle(corners[quad[0]], corners[quad[2]], corners[quad[3]]);
+	}
+
+	++occluderCount;
+}
+
+/* Write a triangle's farthest depth into every pixel whose center it covers */
+/* Using the farthest depth keeps the buffer behind the true surface          */
+////////////////////////////////////////////////////////////////////////////////
+void OcclusionCuller::rasterizeTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+	// Both windings are drawn, back faces lose the depth test against front faces
+	float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if (area == 0.0f)
+	{
+		return;
+	}
+	const glm::vec3& v1 = area > 0.0f ? b : c;
+	const glm::vec3& v2 = area > 0.0f ? c : b;
+
+	float depth = max(a.z, max(b.z, c.z));
+	if (depth >= 1.0f)
+	{
+		return;
+	}
+
+	int minX = max((int)floor(min(a.x, min(v1.x, v2.x))), 0);
+	int maxX = min((int)ceil(max(a.x, max(v1.x, v2.x))), OCCLUSION_WIDTH - 1);
+	int minY = max((int)floor(min(a.y, min(v1.y, v2.y))), 0);
+	int maxY = min((int)ceil(max(a.y, max(v1.y, v2.y))), OCCLUSION_HEIGHT - 1);
+	if (minX > maxX || minY > maxY)
+	{
+		return;
+	}
+
+	// Edge functions A * x + B * y + C, positive inside
+	const glm::vec3* edges[3][2] = { { &a, &v1 }, { &v1, &v2 }, { &v2, &a } };
+	float edgeA[3], edgeB[3], edgeC[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		const glm::vec3& p0 = *edges[i][0];
+		const glm::vec3& p1 = *edges[i][1];
+		edgeA[i] = p0.y - p1.y;
+		edgeB[i] = p1.x - p0.x;
+		edgeC[i] = -(edgeA[i] * p0.x + edgeB[i] * p0.y);
+
+		// Widen by a sliver of a pixel so rounding never opens a crack along shared edges
+		edgeC[i] += EDGE_BIAS * (fabs(edgeA[i]) + fabs(edgeB[i]));
+	}
+
+	float* buffer = levels[0].data();
+
+#ifdef OCCLUSION_SSE
+	__m128 triangleDepth = _mm_set1_ps(depth);
+	__m128 zero = _mm_setzero_ps();
+	__m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	__m128 a0 = _mm_set1_ps(edgeA[0]), a1 = _mm_set1_ps(edgeA[1]), a2 = _mm_set1_ps(edgeA[2]);
+
+	// Rows start on a multiple of four, the width is one too
+	int startX = minX & ~3;
+	for (int y = minY; y <= maxY; ++y)
+	{
+		float pixelY = y + 0.5f;
+		__m128 rowC0 = _mm_set1_ps(edgeB[0] * pixelY + edgeC[0]);
+		__m128 rowC1 = _mm_set1_ps(edgeB[1] * pixelY + edgeC[1]);
+		__m128 rowC2 = _mm_set1_ps(edgeB[2] * pixelY + edgeC[2]);
+		float* row = buffer + y * OCCLUSION_WIDTH;
+
+		for (int x = startX; x <= maxX; x += 4)
+		{
+			__m128 pixelX = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+			__m128 e0 = _mm_add_ps(_mm_mul_ps(a0, pixelX), rowC0);
+			__m128 e1 = _mm_add_ps(_mm_mul_ps(a1, pixelX), rowC1);
+			__m128 e2 = _mm_add_ps(_mm_mul_ps(a2, pixelX), rowC2);
+			__m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+
+			__m128 old = _mm_loadu_ps(row + x);
+			__m128 candidate = _mm_or_ps(_mm_and_ps(inside, triangleDepth), _mm_andnot_ps(inside, old));
+			_mm_storeu_ps(row + x, _mm_min_ps(old, candidate));
+		}
+	}
+#else
+	for (int y = minY; y <= maxY; ++y)
+	{
+		float pixelY = y + 0.5f;
+		float* row = buffer + y * OCCLUSION_WIDTH;
+
+		for (int x = minX; x <= maxX; ++x)
+		{
+			float pixelX = x + 0.5f;
+			bool inside = true;
+			for (int i = 0; i < 3; ++i)
+			{
+				inside = inside && edgeA[i] * pixelX + edgeB[i] * pixelY + edgeC[i] >= 0.0f;
+			}
+			if (inside)
+			{
+				row[x] = min(row[x], depth);
+			}
+		}
+	}
+#endif
+}
+
+/* Build each pyramid level from the farthest depth of 2x2 texels of the level below */
+///////////////////////////////////////////////////////////////////////////////////////
+void OcclusionCuller::Finish()
+{
+	for (size_t level = 1; level < levels.size(); ++level)
+	{
+		const vector<float>& source = levels[level - 1];
+		vector<float>& target = levels[level];
+		int sourceWidth = levelWidths[level - 1], sourceHeight = levelHeights[level - 1];
+		int width = levelWidths[level], height = levelHeights[level];
+
+		for (int y = 0; y < height; ++y)
+		{
+			int y0 = min(y * 2, sourceHeight - 1), y1 = min(y * 2 + 1, sourceHeight - 1);
+			for (int x = 0; x < width; ++x)
+			{
+				int x0 = min(x * 2, sourceWidth - 1), x1 = min(x * 2 + 1, sourceWidth - 1);
+				target[y * width + x] = max(max(source[y0 * sourceWidth + x0], source[y0 * sourceWidth + x1]),
+					max(source[y1 * sourceWidth + x0], source[y1 * sourceWidth + x1]));
+			}
+		}
+	}
+}
+
+/* Compare a box's nearest depth with the farthest occluder depth over its screen rectangle */
+/* The rectangle is read from the level where it spans at most 4x4 texels                  */
+//////////////////////////////////////////////////////////////////////////////////////////////
+bool OcclusionCuller::IsOccluded(const BoundingBox& worldBox) const
+{
+	if (occluderCount == 0)
+	{
+		return false;
+	}
+
+	glm::vec3 corners[8];
+	if (!projectBox(viewProjection, worldBox.minimum, worldBox.maximum, corners))
+	{
+		return false;
+	}
+
+	glm::vec3 minimum = corners[0], maximum = corners[0];
+	for (int i = 1; i < 8; ++i)
+	{
+		minimum = glm::min(minimum, corners[i]);
+		maximum = glm::max(maximum, corners[i]);
+	}
+
+	// Off screen boxes are the frustum culler's business
+	if (maximum.x < 0.0f || maximum.y < 0.0f || minimum.x >= OCCLUSION_WIDTH || minimum.y >= OCCLUSION_HEIGHT)
+	{
+		return false;
+	}
+
+	int x0 = max((int)minimum.x, 0), x1 = min((int)maximum.x, OCCLUSION_WIDTH - 1);
+	int y0 = max((int)minimum.y, 0), y1 = min((int)maximum.y, OCCLUSION_HEIGHT - 1);
+
+	size_t level = 0;
+	while (level + 1 < levels.size() && (x1 - x0 > 3 || y1 - y0 > 3))
+	{
+		x0 >>= 1; x1 >>= 1;
+		y0 >>= 1; y1 >>= 1;
+		++level;
+	}
+
+	const vector<float>& depths = levels[level];
+	int width = levelWidths[level];
+	float farthest = 0.0f;
+	for (int y = y0; y <= y1; ++y)
+	{
+		for (int x = x0; x <= x1; ++x)
+		{
+			farthest = max(farthest, depths[y * width + x]);
+		}
+	}
+
+	return minimum.z > farthest;
+}
+
+/* Get the number of occluders rasterized since Begin */
+/////////////////////////////////////////////////////////
+GLuint OcclusionCuller::GetOccluderCount() const
+{
+	return occluderCount;
+}
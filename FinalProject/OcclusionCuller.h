@@ -0,0 +1,48 @@
+#pragma once
+
+#include "BoundingBox.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+using namespace std;
+
+// Resolution of the software depth buffer, the width is a multiple of the SIMD width
+const int OCCLUSION_WIDTH = 256;
+const int OCCLUSION_HEIGHT = 128;
+
+/* Software occlusion: occluder boxes are rasterized into a small depth buffer,           */
+/* a max depth pyramid is built from it and object bounds are tested against the pyramid */
+/* Everything runs on the CPU, results err on the side of drawing                        */
+///////////////////////////////////////////////////////////////////////////////////////////
+class OcclusionCuller
+{
+public:
+	OcclusionCuller();
+
+	// Clear the depth buffer for a new view
+	void Begin(const glm::mat4& viewProjection);
+
+	// Rasterize the twelve triangles of an object space box moved by model
+	void AddOccluder(const BoundingBox& box, const glm::mat4& model);
+
+	// Build the pyramid, call after the last occluder and before testing
+	void Finish();
+
+	// Whether a world space box is behind the occluders
+	bool IsOccluded(const BoundingBox& worldBox) const;
+
+	GLuint GetOccluderCount() const;
+
+private:
+	void rasterizeTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+
+	glm::mat4 viewProjection;
+
+	// Level 0 is the depth buffer, each further level keeps the farthest depth of 2x2 texels
+	vector<vector<float> > levels;
+	vector<int> levelWidths, levelHeights;
+
+	GLuint occluderCount;
+};
@@ -0,0 +1,165 @@
+#include "PrimitiveCache.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+/* FNV-1a over a 32 bit value */
+////////////////////////////////
+static void hashWord(uint32_t& hash, uint32_t word)
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		hash ^= (word >> (i * 8)) & 0xff;
+		hash *= 16777619u;
+	}
+}
+
+/* Hash a float by its bits, -0.0 and 0.0 make the same primitive */
+////////////////////////////////////////////////////////////////////
+static void hashFloat(uint32_t& hash, float value)
+{
+	if (value == 0.0f)
+	{
+		value = 0.0f;
+	}
+
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	hashWord(hash, bits);
+}
+
+/* Constructor, every cached mesh is stored in layout */
+/////////////////////////////////////////////////////////
+PrimitiveCache::PrimitiveCache(const VertexLayout& layout)
+{
+	this->layout = layout;
+	hits = 0;
+	misses = 0;
+	verticesShared = 0;
+}
+
+/* Get or create the mesh for a primitive */
+/////////////////////////////////////////////
+shared_ptr<Mesh> PrimitiveCache::Acquire(const PrimitiveDesc& desc)
+{
+	shared_ptr<Mesh> mesh = find(desc);
+	if (!mesh)
+	{
+		mesh = insert(desc);
+		mesh->Create(desc);
+	}
+
+	return mesh;
+}
+
+/* Get the mesh for a primitive, queueing it in a batch when it is new */
+/////////////////////////////////////////////////////////////////////////
+shared_ptr<Mesh> PrimitiveCache::Acquire(const PrimitiveDesc& desc, MeshBatch& batch)
+{
+	shared_ptr<Mesh> mesh = find(desc);
+	if (!mesh)
+	{
+		mesh = insert(desc);
+		batch.Add(mesh, desc);
+	}
+
+	return mesh;
+}
+
+/* Release meshes only the cache still references */
+/////////////////////////////////////////////////////
+size_t PrimitiveCache::Purge()
+{
+	size_t purged = 0;
+
+	for (auto it = meshes.begin(); it != meshes.end();)
+	{
+		// Meshes held by a handle or waiting in a batch stay cached
+		if (it->second.use_count() == 1)
+		{
+			it = meshes.erase(it);
+			++purged;
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	return purged;
+}
+
+/* Release the cache's references to every mesh */
+///////////////////////////////////////////////////
+void PrimitiveCache::Clear()
+{
+	meshes.clear();
+}
+
+/* Get the number of cached meshes */
+/////////////////////////////////////
+size_t PrimitiveCache::GetSize() const
+{
+	return meshes.size();
+}
+
+/* Print how often requests were served from the cache */
+/////////////////////////////////////////////////////////
+void PrimitiveCache::PrintStats() const
+{
+	cout << "Primitive cache: " << meshes.size() << " meshes, " << hits << " hits, " << misses << " misses, "
+		<< verticesShared << " vertices not duplicated" << endl;
+}
+
+/* Look up a cached mesh and count the request */
+/////////////////////////////////////////////////
+shared_ptr<Mesh> PrimitiveCache::find(const PrimitiveDesc& desc)
+{
+	auto it = meshes.find(desc);
+	if (it == meshes.end())
+	{
+		++misses;
+		return shared_ptr<Mesh>();
+	}
+
+	++hits;
+	verticesShared += CountPrimitive(desc).vertexCount;
+	return it->second;
+}
+
+/* Add an empty mesh in the cache's layout */
+/////////////////////////////////////////////
+shared_ptr<Mesh> PrimitiveCache::insert(const PrimitiveDesc& desc)
+{
+	shared_ptr<Mesh> mesh = make_shared<Mesh>();
+	mesh->SetVertexLayout(layout);
+	meshes[desc] = mesh;
+	return mesh;
+}
+
+/* Hash every parameter, unused ones are 0 */
+/////////////////////////////////////////////
+size_t PrimitiveCache::DescHash::operator()(const PrimitiveDesc& desc) const
+{
+	uint32_t hash = 2166136261u;
+	hashWord(hash, (uint32_t)desc.type);
+	hashFloat(hash, desc.radius);
+	hashFloat(hash, desc.topRadius);
+	hashFloat(hash, desc.length);
+	hashFloat(hash, desc.height);
+	hashFloat(hash, desc.width);
+	hashWord(hash, (uint32_t)desc.sectorCount);
+	hashWord(hash, (uint32_t)desc.stackCount);
+	hashWord(hash, (uint32_t)desc.lodCount);
+	return hash;
+}
+
+/* Primitives are equal when they generate the same geometry */
+///////////////////////////////////////////////////////////////
+bool PrimitiveCache::DescEqual::operator()(const PrimitiveDesc& a, const PrimitiveDesc& b) const
+{
+	return a.type == b.type && a.radius == b.radius && a.topRadius == b.topRadius
+		&& a.length == b.length && a.height == b.height && a.width == b.width
+		&& a.sectorCount == b.sectorCount && a.stackCount == b.stackCount && a.lodCount == b.lodCount;
+}
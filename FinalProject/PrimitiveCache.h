@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Mesh.h"
+#include "MeshBatch.h"
+#include "Primitives.h"
+#include "VertexLayout.h"
+
+#include <memory>
+#include <unordered_map>
+
+using namespace std;
+
+/* Shares one mesh between every request for the same primitive parameters */
+/* Meshes live as long as the cache or any handle to them                   */
+//////////////////////////////////////////////////////////////////////////////
+class PrimitiveCache
+{
+public:
+	PrimitiveCache(const VertexLayout& layout);
+
+	// Return the cached mesh, creating it now on a miss
+	shared_ptr<Mesh> Acquire(const PrimitiveDesc& desc);
+
+	// Return the cached mesh, on a miss it is empty until batch is generated and uploaded
+	shared_ptr<Mesh> Acquire(const PrimitiveDesc& desc, MeshBatch& batch);
+
+	// Drop meshes nobody else holds, their arena ranges are freed
+	size_t Purge();
+	void Clear();
+
+	size_t GetSize() const;
+	void PrintStats() const;
+
+private:
+	struct DescHash
+	{
+		size_t operator()(const PrimitiveDesc& desc) const;
+	};
+
+	struct DescEqual
+	{
+		bool operator()(const PrimitiveDesc& a, const PrimitiveDesc& b) const;
+	};
+
+	shared_ptr<Mesh> find(const PrimitiveDesc& desc);
+	shared_ptr<Mesh> insert(const PrimitiveDesc& desc);
+
+	VertexLayout layout;
+	unordered_map<PrimitiveDesc, shared_ptr<Mesh>, DescHash, DescEqual> meshes;
+
+	size_t hits;
+	size_t misses;
+	size_t verticesShared; // Vertices that would have been uploaded again without the cache
+};
@@ -0,0 +1,496 @@
+#include "Primitives.h"
+
+#include <algorithm>
+#include <cmath>
+
+// SSE2 is part of every x64 target, 32 bit builds need /arch:SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PRIMITIVES_SSE
+#include <emmintrin.h>
+#endif
+
+const float PI = 3.1415926f;
+
+/* Get the number of vertices */
+////////////////////////////////
+GLsizei MeshData::GetVertexCount() const
+{
+	return (GLsizei)(vertices.size() / PRIMITIVE_FLOATS_PER_VERTEX);
+}
+
+/* Get the number of indices */
+///////////////////////////////
+GLsizei MeshData::GetIndexCount() const
+{
+	return (GLsizei)indices.size();
+}
+
+/* Desk plane */
+////////////////
+PrimitiveDesc PrimitiveDesc::Plane()
+{
+	PrimitiveDesc desc = { PRIMITIVE_PLANE, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0, 0, 1 };
+	return desc;
+}
+
+/* Box with one corner at the origin, extending to +x, +y and -z */
+///////////////////////////////////////////////////////////////////
+PrimitiveDesc PrimitiveDesc::Cube(float length, float height, float width)
+{
+	PrimitiveDesc desc = { PRIMITIVE_CUBE, 0.0f, 0.0f, length, height, width, 0, 0, 1 };
+	return desc;
+}
+
+/* UV sphere */
+///////////////
+PrimitiveDesc PrimitiveDesc::Sphere(float radius, int sectorCount, int stackCount)
+{
+	PrimitiveDesc desc = { PRIMITIVE_SPHERE, radius, 0.0f, 0.0f, 0.0f, 0.0f, sectorCount, stackCount, 1 };
+	return desc;
+}
+
+/* Capped cylinder, a different top radius makes a cone */
+//////////////////////////////////////////////////////////
+PrimitiveDesc PrimitiveDesc::Cylinder(float baseRadius, float topRadius, int sectorCount, float height, int stackCount)
+{
+	PrimitiveDesc desc = { PRIMITIVE_CYLINDER, baseRadius, topRadius, 0.0f, height, 0.0f, sectorCount, stackCount, 1 };
+	return desc;
+}
+
+/* Trig tables reused by every primitive generated on this thread */
+//////////////////////////////////////////////////////////////////////
+struct TrigScratch
+{
+	vector<float> sectorCosines, sectorSines;
+	vector<float> stackCosines, stackSines;
+};
+
+/* Get this thread's tables, safe to generate on several threads at once */
+////////////////////////////////////////////////////////////////////////////
+static TrigScratch& getTrigScratch()
+{
+	static thread_local TrigScratch scratch;
+	return scratch;
+}
+
+/* Cosine and sine of count + 1 evenly spaced angles, evaluated once per primitive */
+/* The tables only allocate when they grow past their largest size so far          */
+/////////////////////////////////////////////////////////////////////////////////////
+static void buildTrigTable(int count, float step, float start, vector<float>& cosines, vector<float>& sines)
+{
+	cosines.resize(count + 1);
+	sines.resize(count + 1);
+
+	for (int i = 0; i <= count; ++i)
+	{
+		float angle = start + i * step;
+		cosines[i] = cosf(angle);
+		sines[i] = sinf(angle);
+	}
+}
+
+/* Vertices and indices of the plane */
+////////////////////////////////////////
+PrimitiveCounts CountPlane()
+{
+	PrimitiveCounts counts = { 4, 6 };
+	return counts;
+}
+
+/* Vertices and indices of a cube, four corners per face */
+///////////////////////////////////////////////////////////
+PrimitiveCounts CountCube()
+{
+	PrimitiveCounts counts = { 24, 36 };
+	return counts;
+}
+
+/* Vertices and indices of a UV sphere */
+/////////////////////////////////////////
+PrimitiveCounts CountSphere(int sectorCount, int stackCount)
+{
+	// One ring of (sectorCount + 1) vertices per stack, the pole stacks have one triangle per sector
+	PrimitiveCounts counts;
+	counts.vertexCount = (stackCount + 1) * (sectorCount + 1);
+	counts.indexCount = stackCount > 1 ? 6 * sectorCount * (stackCount - 1) : 0;
+	return counts;
+}
+
+/* Vertices and indices of a capped cylinder */
+///////////////////////////////////////////////
+PrimitiveCounts CountCylinder(int sectorCount, int stackCount)
+{
+	// Side rings, then a center and sectorCount rim vertices for each cap
+	PrimitiveCounts counts;
+	counts.vertexCount = (stackCount + 1) * (sectorCount + 1) + 2 * (sectorCount + 1);
+	counts.indexCount = 6 * sectorCount * stackCount + 6 * sectorCount;
+	return counts;
+}
+
+/* Vertices and indices of any primitive */
+////////////////////////////////////////////
+PrimitiveCounts CountPrimitive(const PrimitiveDesc& desc)
+{
+	switch (desc.type)
+	{
+	case PRIMITIVE_PLANE:
+		return CountPlane();
+	case PRIMITIVE_CUBE:
+		return CountCube();
+	case PRIMITIVE_SPHERE:
+		return CountSphere(desc.sectorCount, desc.stackCount);
+	default:
+		return CountCylinder(desc.sectorCount, desc.stackCount);
+	}
+}
+
+/* Halve the sector and stack counts once per level, flat primitives have a single level */
+/* Counts stop at the smallest closed shape                                              */
+////////////////////////////////////////////////////////////////////////////////////////////
+PrimitiveDesc LodLevel(const PrimitiveDesc& desc, int level)
+{
+	PrimitiveDesc lod = desc;
+	lod.lodCount = 1;
+
+	if (desc.type == PRIMITIVE_SPHERE)
+	{
+		lod.sectorCount = max(desc.sectorCount >> level, 3);
+		lod.stackCount = max(desc.stackCount >> level, 2);
+	}
+	else if (desc.type == PRIMITIVE_CYLINDER)
+	{
+		lod.sectorCount = max(desc.sectorCount >> level, 3);
+		lod.stackCount = max(desc.stackCount >> level, 1);
+	}
+
+	return lod;
+}
+
+/* Count the requested levels that each cut both vertices and indices */
+/* Once the clamped counts stop shrinking every further level repeats */
+////////////////////////////////////////////////////////////////////////
+int LodLevelCount(const PrimitiveDesc& desc)
+{
+	int lodCount = min(max(desc.lodCount, 1), MAX_PRIMITIVE_LODS);
+	PrimitiveCounts previous = CountPrimitive(desc);
+
+	for (int level = 1; level < lodCount; ++level)
+	{
+		PrimitiveCounts counts = CountPrimitive(LodLevel(desc, level));
+		if (counts.vertexCount >= previous.vertexCount || counts.indexCount >= previous.indexCount)
+		{
+			return level;
+		}
+		previous = counts;
+	}
+
+	return lodCount;
+}
+
+/* Write one ring of sectorCount + 1 vertices of radius around the z axis            */
+/* Normals are (cos * normalXY * normalScale, sin * normalXY * normalScale, normalZ) */
+///////////////////////////////////////////////////////////////////////////////////////
+static void writeRing(GLfloat* out, const float* cosines, const float* sines, int sectorCount,
+	float radius, float z, float normalXY, float normalScale, float normalZ, float t)
+{
+	int count = sectorCount + 1;
+	int j = 0;
+
+#ifdef PRIMITIVES_SSE
+	// Four vertices per iteration, transposed from component vectors into interleaved vertices
+	const __m128 radius4 = _mm_set1_ps(radius);
+	const __m128 normalXY4 = _mm_set1_ps(normalXY);
+	const __m128 normalScale4 = _mm_set1_ps(normalScale);
+	const __m128 sectors4 = _mm_set1_ps((float)sectorCount);
+	const __m128 step4 = _mm_set1_ps(4.0f);
+	__m128 column = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+
+	for (; j + 4 <= count; j += 4)
+	{
+		__m128 cosine = _mm_loadu_ps(cosines + j);
+		__m128 sine = _mm_loadu_ps(sines + j);
+
+		__m128 x = _mm_mul_ps(cosine, radius4);
+		__m128 y = _mm_mul_ps(sine, radius4);
+		__m128 vz = _mm_set1_ps(z);
+		__m128 nx = _mm_mul_ps(_mm_mul_ps(cosine, normalXY4), normalScale4);
+		__m128 ny = _mm_mul_ps(_mm_mul_ps(sine, normalXY4), normalScale4);
+		__m128 nz = _mm_set1_ps(normalZ);
+		__m128 s = _mm_div_ps(column, sectors4);
+		__m128 vt = _mm_set1_ps(t);
+		column = _mm_add_ps(column, step4);
+
+		// Rows become (x, y, z, nx) and (ny, nz, s, t) of each vertex
+		_MM_TRANSPOSE4_PS(x, y, vz, nx);
+		_MM_TRANSPOSE4_PS(ny, nz, s, vt);
+
+		GLfloat* vertex = out + j * PRIMITIVE_FLOATS_PER_VERTEX;
+		_mm_storeu_ps(vertex, x);
+		_mm_storeu_ps(vertex + 4, ny);
+		_mm_storeu_ps(vertex + 8, y);
+		_mm_storeu_ps(vertex + 12, nz);
+		_mm_storeu_ps(vertex + 16, vz);
+		_mm_storeu_ps(vertex + 20, s);
+		_mm_storeu_ps(vertex + 24, nx);
+		_mm_storeu_ps(vertex + 28, vt);
+	}
+#endif
+
+	// Scalar fallback and the vertices left over from the vector loop
+	for (; j < count; ++j)
+	{
+		GLfloat* vertex = out + j * PRIMITIVE_FLOATS_PER_VERTEX;
+		vertex[0] = cosines[j] * radius;
+		vertex[1] = sines[j] * radius;
+		vertex[2] = z;
+		vertex[3] = cosines[j] * normalXY * normalScale;
+		vertex[4] = sines[j] * normalXY * normalScale;
+		vertex[5] = normalZ;
+		vertex[6] = (float)j / sectorCount;
+		vertex[7] = t;
+	}
+}
+
+/* Write one vertex */
+//////////////////////
+static GLfloat* writeVertex(GLfloat* out, float x, float y, float z, float nx, float ny, float nz, float s, float t)
+{
+	out[0] = x;
+	out[1] = y;
+	out[2] = z;
+	out[3] = nx;
+	out[4] = ny;
+	out[5] = nz;
+	out[6] = s;
+	out[7] = t;
+	return out + PRIMITIVE_FLOATS_PER_VERTEX;
+}
+
+/* Generate the plane as the scene's base */
+/////////////////////////////////////////////
+void GeneratePlane(GLfloat* vertices, GLuint* indices)
+{
+	const GLfloat planeVertices[] =
+	{
+		// Vertex            // Normals          // Texture
+	   -5.0f,  0.0f, -4.0f,  0.0f, 70.0f, 0.0f,  0.0f, 1.0f, // Back Left
+		5.0f,  0.0f, -4.0f,  0.0f, 70.0f, 0.0f,  1.0f, 1.0f, // Back Right
+	   -5.0f,  0.0f,  3.0f,	 0.0f, 70.0f, 0.0f,  0.0f, 0.0f, // Front Left
+		5.0f,  0.0f,  3.0f,  0.0f, 70.0f, 0.0f,  1.0f, 0.0f, // Front Right
+	};
+
+	const GLuint planeIndices[] =
+	{
+		0, 1, 2,
+		2, 1, 3,
+	};
+
+	copy(planeVertices, planeVertices + sizeof(planeVertices) / sizeof(GLfloat), vertices);
+	copy(planeIndices, planeIndices + sizeof(planeIndices) / sizeof(GLuint), indices);
+}
+
+/* Generate a cube with a given length, height, and width */
+////////////////////////////////////////////////////////////
+void GenerateCube(float length, float height, float width, GLfloat* vertices, GLuint* indices)
+{
+	const GLfloat cubeVertices[] = {
+		// Vertex                  // Normals            // Texture
+		//--------------------------------------------------------------------------
+		// Front face
+		0.0f,    0.0f,    0.0f,    0.0f,  0.0f,  1.0f,   0.0f,  0.0f,  // Bottom left
+		length,  height,  0.0f,    0.0f,  0.0f,  1.0f,   1.0f,  1.0f,  // Top right
+		0.0f,    height,  0.0f,    0.0f,  0.0f,  1.0f,   0.0f,  1.0f,  // Top left
+		length,  0.0f,    0.0f,    0.0f,  0.0f,  1.0f,   1.0f,  0.0f,  // Bottom right
+		// Left face
+		0.0f,    0.0f,   -width,  -1.0f,  0.0f,  0.0f,   0.0f,  0.0f,  // Back bottom left
+		0.0f,    height,  0.0f,   -1.0f,  0.0f,  0.0f,   1.0f,  1.0f,  // Top left
+		0.0f,    height, -width,  -1.0f,  0.0f,  0.0f,   0.0f,  1.0f,  // Back top left
+		0.0f,    0.0f,    0.0f,   -1.0f,  0.0f,  0.0f,   1.0f,  0.0f,  // Bottom left
+		// Back face
+		length,  0.0f,   -width,   0.0f,  0.0f, -1.0f,   0.0f,  0.0f,  // Back bottom right
+		0.0f,    height, -width,   0.0f,  0.0f, -1.0f,   1.0f,  1.0f,  // Back top left
+		length,  height, -width,   0.0f,  0.0f, -1.0f,   0.0f,  1.0f,  // Back top right
+		0.0f,    0.0f,   -width,   0.0f,  0.0f, -1.0f,   1.0f,  0.0f,  // Back bottom left
+		// Right face
+		length,  0.0f,    0.0f,    1.0f,  0.0f,  0.0f,   0.0f,  0.0f,  // Bottom right
+		length,  height, -width,   1.0f,  0.0f,  0.0f,   1.0f,  1.0f,  // Back top right
+		length,  height,  0.0f,    1.0f,  0.0f,  0.0f,   0.0f,  1.0f,  // Top right
+		length,  0.0f,   -width,   1.0f,  0.0f,  0.0f,   1.0f,  0.0f,  // Back bottom right
+		// Top face
+		0.0f,    height,  0.0f,    0.0f,  1.0f,  0.0f,   0.0f,  0.0f,  // Top Left
+		length,  height, -width,   0.0f,  1.0f,  0.0f,   1.0f,  1.0f,  // Back top right
+		0.0f,    height, -width,   0.0f,  1.0f,  0.0f,   0.0f,  1.0f,  // Back top left
+		length,  height,  0.0f,    0.0f,  1.0f,  0.0f,   1.0f,  0.0f,  // Top right
+		// Bottom face
+		0.0f,    0.0f,   -width,   0.0f, -1.0f,  0.0f,   0.0f,  0.0f,  // Back bottom left
+		length,  0.0f,    0.0f,    0.0f, -1.0f,  0.0f,   1.0f,  1.0f,  // Bottom right
+		0.0f,    0.0f,    0.0f,    0.0f, -1.0f,  0.0f,   0.0f,  1.0f,  // Bottom left
+		length,  0.0f,   -width,   0.0f, -1.0f,  0.0f,   1.0f,  0.0f,  // Back bottom right
+	};
+
+	copy(cubeVertices, cubeVertices + sizeof(cubeVertices) / sizeof(GLfloat), vertices);
+
+	// Four corners per face, two triangles each
+	for (GLuint face = 0; face < 6; ++face)
+	{
+		GLuint corner = face * 4;
+		GLuint faceIndices[] = { corner, corner + 1, corner + 2, corner, corner + 3, corner + 1 };
+		copy(faceIndices, faceIndices + 6, indices + face * 6);
+	}
+}
+
+/* Generate a UV sphere around the origin, poles on the z axis */
+/////////////////////////////////////////////////////////////////
+void GenerateSphere(float radius, int sectorCount, int stackCount, GLfloat* vertices, GLuint* indices)
+{
+	float lengthInv = 1.0f / radius;
+
+	TrigScratch& scratch = getTrigScratch();
+	buildTrigTable(sectorCount, 2 * PI / sectorCount, 0.0f, scratch.sectorCosines, scratch.sectorSines);
+	buildTrigTable(stackCount, -PI / stackCount, PI / 2, scratch.stackCosines, scratch.stackSines); // From pi/2 to -pi/2
+
+	for (int i = 0; i <= stackCount; ++i)
+	{
+		float xy = radius * scratch.stackCosines[i]; // r * cos(u)
+		float z = radius * scratch.stackSines[i];    // r * sin(u)
+
+		GLfloat* ring = vertices + (size_t)i * (sectorCount + 1) * PRIMITIVE_FLOATS_PER_VERTEX;
+		writeRing(ring, scratch.sectorCosines.data(), scratch.sectorSines.data(), sectorCount, xy, z, xy, lengthInv, z * lengthInv, (float)i / stackCount);
+	}
+
+	GLuint* index = indices;
+	for (int i = 0; i < stackCount; ++i)
+	{
+		GLuint k1 = i * (sectorCount + 1);     // Beginning of current stack
+		GLuint k2 = k1 + sectorCount + 1;      // Beginning of next stack
+
+		for (int j = 0; j < sectorCount; ++j, ++k1, ++k2)
+		{
+			// Two triangles per sector excluding first and last stacks
+			if (i != 0)
+			{
+				*index++ = k1;
+				*index++ = k2;
+				*index++ = k1 + 1;
+			}
+
+			if (i != (stackCount - 1))
+			{
+				*index++ = k1 + 1;
+				*index++ = k2;
+				*index++ = k2 + 1;
+			}
+		}
+	}
+}
+
+/* Generate a capped cylinder or cone around the z axis, centered on the origin */
+//////////////////////////////////////////////////////////////////////////////////
+void GenerateCylinder(float baseRadius, float topRadius, int sectorCount, float height, int stackCount, GLfloat* vertices, GLuint* indices)
+{
+	TrigScratch& scratch = getTrigScratch();
+	const vector<float>& cosines = scratch.sectorCosines;
+	const vector<float>& sines = scratch.sectorSines;
+	buildTrigTable(sectorCount, 2 * PI / sectorCount, 0.0f, scratch.sectorCosines, scratch.sectorSines);
+
+	// Side normals lean by the slope of the side, (x0, 0, z0) rotated per sector
+	float zAngle = atan2f(baseRadius - topRadius, height);
+	float x0 = cosf(zAngle);
+	float z0 = sinf(zAngle);
+
+	// Cap vertices follow the side rings
+	GLuint baseVertexIndex = (GLuint)((stackCount + 1) * (sectorCount + 1));
+	GLuint topVertexIndex = baseVertexIndex + sectorCount + 1;
+
+	for (int i = 0; i <= stackCount; ++i)
+	{
+		float z = -(height * 0.5f) + (float)i / stackCount * height;
+		float radius = baseRadius + (float)i / stackCount * (topRadius - baseRadius);
+		float t = 1.0f - (float)i / stackCount;   // Top to bottom
+
+		GLfloat* ring = vertices + (size_t)i * (sectorCount + 1) * PRIMITIVE_FLOATS_PER_VERTEX;
+		writeRing(ring, cosines.data(), sines.data(), sectorCount, radius, z, x0, 1.0f, z0, t);
+	}
+
+	// Base cap faces -z
+	float z = -height * 0.5f;
+	GLfloat* vertex = vertices + (size_t)baseVertexIndex * PRIMITIVE_FLOATS_PER_VERTEX;
+	vertex = writeVertex(vertex, 0.0f, 0.0f, z, 0.0f, 0.0f, -1.0f, 0.5f, 0.5f);
+	for (int i = 0; i < sectorCount; ++i)
+	{
+		vertex = writeVertex(vertex, cosines[i] * baseRadius, sines[i] * baseRadius, z, 0.0f, 0.0f, -1.0f,
+			-cosines[i] * 0.5f + 0.5f, -sines[i] * 0.5f + 0.5f);
+	}
+
+	// Top cap faces +z
+	z = height * 0.5f;
+	vertex = writeVertex(vertex, 0.0f, 0.0f, z, 0.0f, 0.0f, 1.0f, 0.5f, 0.5f);
+	for (int i = 0; i < sectorCount; ++i)
+	{
+		vertex = writeVertex(vertex, cosines[i] * topRadius, sines[i] * topRadius, z, 0.0f, 0.0f, 1.0f,
+			cosines[i] * 0.5f + 0.5f, -sines[i] * 0.5f + 0.5f);
+	}
+
+	// Two triangles per sector of every stack
+	GLuint* index = indices;
+	for (int i = 0; i < stackCount; ++i)
+	{
+		GLuint k1 = i * (sectorCount + 1);     // Beginning of current stack
+		GLuint k2 = k1 + sectorCount + 1;      // Beginning of next stack
+
+		for (int j = 0; j < sectorCount; ++j, ++k1, ++k2)
+		{
+			*index++ = k1;
+			*index++ = k1 + 1;
+			*index++ = k2;
+
+			*index++ = k2;
+			*index++ = k1 + 1;
+			*index++ = k2 + 1;
+		}
+	}
+
+	// Cap fans, the last triangle wraps back to the first rim vertex
+	for (int i = 0; i < sectorCount; ++i)
+	{
+		GLuint k = baseVertexIndex + 1 + i;
+		GLuint next = i < sectorCount - 1 ? k + 1 : baseVertexIndex + 1;
+		*index++ = baseVertexIndex;
+		*index++ = next;
+		*index++ = k;
+	}
+
+	for (int i = 0; i < sectorCount; ++i)
+	{
+		GLuint k = topVertexIndex + 1 + i;
+		GLuint next = i < sectorCount - 1 ? k + 1 : topVertexIndex + 1;
+		*index++ = topVertexIndex;
+		*index++ = k;
+		*index++ = next;
+	}
+}
+
+/* Generate any primitive into data, sized to its exact counts */
+/////////////////////////////////////////////////////////////////
+void GeneratePrimitive(const PrimitiveDesc& desc, MeshData& data)
+{
+	PrimitiveCounts counts = CountPrimitive(desc);
+	data.vertices.resize((size_t)counts.vertexCount * PRIMITIVE_FLOATS_PER_VERTEX);
+	data.indices.resize(counts.indexCount);
+
+	switch (desc.type)
+	{
+	case PRIMITIVE_PLANE:
+		GeneratePlane(data.vertices.data(), data.indices.data());
+		break;
+	case PRIMITIVE_CUBE:
+		GenerateCube(desc.length, desc.height, desc.width, data.vertices.data(), data.indices.data());
+		break;
+	case PRIMITIVE_SPHERE:
+		GenerateSphere(desc.radius, desc.sectorCount, desc.stackCount, data.vertices.data(), data.indices.data());
+		break;
+	default:
+		GenerateCylinder(desc.radius, desc.topRadius, desc.sectorCount, desc.height, desc.stackCount, data.vertices.data(), data.indices.data());
+		break;
+	}
+}
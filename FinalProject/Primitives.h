@@ -0,0 +1,77 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+
+using namespace std;
+
+// Generated vertices are PositionNormalUV: position, normal, texture coordinate
+const int PRIMITIVE_FLOATS_PER_VERTEX = 8;
+
+// Most detail levels a primitive can generate, each halves the sector and stack counts
+const int MAX_PRIMITIVE_LODS = 4;
+
+enum PrimitiveType
+{
+	PRIMITIVE_PLANE,
+	PRIMITIVE_CUBE,
+	PRIMITIVE_SPHERE,
+	PRIMITIVE_CYLINDER
+};
+
+/* Which primitive to generate and its parameters, unused parameters are 0 */
+/////////////////////////////////////////////////////////////////////////////
+struct PrimitiveDesc
+{
+	PrimitiveType type;
+	float radius, topRadius;     // Sphere radius, cylinder base and top radius
+	float length, height, width; // Cube size, cylinder height
+	int sectorCount, stackCount;
+	int lodCount;                // Detail levels to generate, 1 for a single level
+
+	static PrimitiveDesc Plane();
+	static PrimitiveDesc Cube(float length, float height, float width);
+	static PrimitiveDesc Sphere(float radius, int sectorCount, int stackCount);
+	static PrimitiveDesc Cylinder(float baseRadius, float topRadius, int sectorCount, float height, int stackCount);
+};
+
+/* Exact size of a primitive, known before generating it */
+////////////////////////////////////////////////////////////
+struct PrimitiveCounts
+{
+	GLsizei vertexCount;
+	GLsizei indexCount;
+};
+
+/* CPU side geometry of a generated primitive */
+////////////////////////////////////////////////
+struct MeshData
+{
+	vector<GLfloat> vertices;
+	vector<GLuint> indices;
+
+	GLsizei GetVertexCount() const;
+	GLsizei GetIndexCount() const;
+};
+
+PrimitiveCounts CountPlane();
+PrimitiveCounts CountCube();
+PrimitiveCounts CountSphere(int sectorCount, int stackCount);
+PrimitiveCounts CountCylinder(int sectorCount, int stackCount);
+PrimitiveCounts CountPrimitive(const PrimitiveDesc& desc);
+
+// Parameters of one level of a primitive's detail chain, level 0 is desc itself
+PrimitiveDesc LodLevel(const PrimitiveDesc& desc, int level);
+
+// Levels of desc worth generating, ends at the first level no smaller than the one before
+int LodLevelCount(const PrimitiveDesc& desc);
+
+// Fill caller storage sized by the matching Count function, vertices holds vertexCount * PRIMITIVE_FLOATS_PER_VERTEX floats
+void GeneratePlane(GLfloat* vertices, GLuint* indices);
+void GenerateCube(float length, float height, float width, GLfloat* vertices, GLuint* indices);
+void GenerateSphere(float radius, int sectorCount, int stackCount, GLfloat* vertices, GLuint* indices);
+void GenerateCylinder(float baseRadius, float topRadius, int sectorCount, float height, int stackCount, GLfloat* vertices, GLuint* indices);
+
+// Size data to the exact counts, a reused MeshData only allocates when it has to grow
+void GeneratePrimitive(const PrimitiveDesc& desc, MeshData& data);
@@ -0,0 +1,149 @@
+#include "RenderQueue.h"
+#include "FrameStats.h"
+
+#include <algorithm>
+
+// Depth range quantized into the low bits of the key, matches the far plane
+const float MAX_SORT_DEPTH = 100.0f;
+const uint64_t DEPTH_BITS = 20;
+
+/* Order packets by key */
+///////////////////////////
+static bool comparePackets(const DrawPacket& a, const DrawPacket& b)
+{
+	return a.key < b.key;
+}
+
+/* Drop last frame's packets */
+///////////////////////////////
+void RenderQueue::Clear()
+{
+	packets.clear();
+}
+
+/* Queue a draw for this frame */
+/////////////////////////////////
+void RenderQueue::Push(const Mesh* mesh, const Material* material, const glm::mat4& model, const glm::mat3& normalMatrix, bool instanced, GLuint lod, float viewDepth)
+{
+	DrawPacket packet;
+	packet.mesh = mesh;
+	packet.material = material;
+	packet.model = model;
+	packet.normalMatrix = normalMatrix;
+	packet.instanced = instanced;
+	packet.lod = lod;
+
+	GLuint vertexArray = instanced ? mesh->GetInstanceVertexArray() : mesh->GetVertexArray();
+	packet.key = makeKey(material->uniforms.program, material->textureId, vertexArray, viewDepth);
+
+	packets.push_back(packet);
+}
+
+/* Sort by state and submit, skipping binds that are already current */
+/////////////////////////////////////////////////////////////////////////
+void RenderQueue::Flush()
+{
+	sort(packets.begin(), packets.end(), comparePackets);
+
+	GLuint currentProgram = 0;
+	GLuint currentTexture = 0;
+	GLuint currentVertexArray = 0;
+	const Material* currentMaterial = NULL;
+	const Mesh* currentMesh = NULL;
+
+	glActiveTexture(GL_TEXTURE0);
+
+	for (size_t i = 0; i < packets.size(); ++i)
+	{
+		const DrawPacket& packet = packets[i];
+		const Material& material = *packet.material;
+
+		// Set shader
+		if (material.uniforms.program != currentProgram)
+		{
+			glUseProgram(material.uniforms.program);
+			currentProgram = material.uniforms.program;
+			currentMesh = NULL;
+			++gFrameStats.stateChanges;
+		}
+		else
+		{
+			++gFrameStats.elidedStateChanges;
+		}
+
+		// Uniforms keep their values, so color only changes with the material
+		if (packet.material != currentMaterial)
+		{
+			glUniform3f(material.uniforms.objectColor, material.color.r, material.color.g, material.color.b);
+			currentMaterial = packet.material;
+		}
+		glUniformMatrix4fv(material.uniforms.model, 1, GL_FALSE, glm::value_ptr(packet.model));
+		glUniformMatrix3fv(material.uniforms.normalMatrix, 1, GL_FALSE, glm::value_ptr(packet.normalMatrix));
+
+		// Dequantization of packed vertices only changes with the mesh
+		if (packet.mesh != currentMesh)
+		{
+			const VertexQuantization& quantization = packet.mesh->GetQuantization();
+			glUniform3fv(material.uniforms.positionScale, 1, glm::value_ptr(quantization.positionScale));
+			glUniform3fv(material.uniforms.positionOffset, 1, glm::value_ptr(quantization.positionOffset));
+			glUniform1i(material.uniforms.octahedralNormals, quantization.octahedralNormals);
+			currentMesh = packet.mesh;
+		}
+
+		// Activate VBOs within VAO
+		GLuint vertexArray = packet.instanced ? packet.mesh->GetInstanceVertexArray() : packet.mesh->GetVertexArray();
+		if (vertexArray != currentVertexArray)
+		{
+			glBindVertexArray(vertexArray);
+			currentVertexArray = vertexArray;
+			++gFrameStats.stateChanges;
+		}
+		else
+		{
+			++gFrameStats.elidedStateChanges;
+		}
+
+		// Bind textures, untextured materials leave the last texture bound
+		if (material.textureId != 0)
+		{
+			if (material.textureId != currentTexture)
+			{
+				glBindTexture(GL_TEXTURE_2D, material.textureId);
+				currentTexture = material.textureId;
+				++gFrameStats.stateChanges;
+			}
+			else
+			{
+				++gFrameStats.elidedStateChanges;
+			}
+		}
+
+		// Draw
+		if (packet.instanced)
+		{
+			packet.mesh->DrawBoundInstanced(packet.lod);
+		}
+		else
+		{
+			packet.mesh->DrawBound(packet.lod);
+		}
+	}
+
+	// Deactivate VAO
+	glBindVertexArray(0);
+	glUseProgram(0);
+}
+
+/* Build the sort key: program, texture, VAO, then front to back depth */
+/* GL names are masked to their field, a collision only affects order  */
+//////////////////////////////////////////////////////////////////////////
+uint64_t RenderQueue::makeKey(GLuint program, GLuint textureId, GLuint vertexArray, float viewDepth)
+{
+	float depth = min(max(viewDepth / MAX_SORT_DEPTH, 0.0f), 1.0f);
+	uint64_t depthBits = (uint64_t)(depth * ((1 << DEPTH_BITS) - 1));
+
+	return ((uint64_t)(program & 0xFFF) << 52) |
+		((uint64_t)(textureId & 0xFFFF) << 36) |
+		((uint64_t)(vertexArray & 0xFFFF) << DEPTH_BITS) |
+		depthBits;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Mesh.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+/* One draw collected for the frame, ordered by its sort key */
+///////////////////////////////////////////////////////////////
+struct DrawPacket
+{
+	uint64_t key;
+	const Mesh* mesh;
+	const Material* material;
+	glm::mat4 model;
+	glm::mat3 normalMatrix;
+	bool instanced;
+	GLuint lod;
+};
+
+/* Collects a frame's draws, sorts them by state and submits them with minimal binds */
+/////////////////////////////////////////////////////////////////////////////////////////
+class RenderQueue
+{
+public:
+	void Clear();
+	void Push(const Mesh* mesh, const Material* material, const glm::mat4& model, const glm::mat3& normalMatrix, bool instanced, GLuint lod, float viewDepth);
+	void Flush();
+
+private:
+	static uint64_t makeKey(GLuint program, GLuint textureId, GLuint vertexArray, float viewDepth);
+
+	vector<DrawPacket> packets;
+};
@@ -0,0 +1,354 @@
+#include "Scene.h"
+#include "FrameStats.h"
+#include "LevelOfDetail.h"
+#include "NormalMatrix.h"
+
+#include <algorithm>
+#include <limits>
+
+/* Constructor */
+/////////////////
+Scene::Scene()
+{
+	hierarchyDirty = true;
+}
+
+/* Register a mesh, returns its handle */
+/////////////////////////////////////////
+GLuint Scene::AddMesh(const Mesh* mesh)
+{
+	meshes.push_back(mesh);
+	return (GLuint)meshes.size() - 1;
+}
+
+/* Register a material, returns its handle */
+/////////////////////////////////////////////
+GLuint Scene::AddMaterial(const Material& material)
+{
+	materials.push_back(material);
+	return (GLuint)materials.size() - 1;
+}
+
+/* Add an object to draw, returns its handle */
+///////////////////////////////////////////////
+GLuint Scene::AddItem(GLuint meshHandle, GLuint materialHandle, const glm::mat4& model)
+{
+	DrawItem item;
+	item.meshHandle = meshHandle;
+	item.materialHandle = materialHandle;
+	item.modelMatrix = model;
+	item.normalMatrix = glm::mat3(1.0f);
+	item.instanced = false;
+	item.batched = false;
+	item.lod = 0;
+	item.occluder = false;
+
+	items.push_back(item);
+	culler.Add(glm::vec4(0.0f), glm::vec3(0.0f), glm::vec3(0.0f));
+	worldBoxes.push_back(BoundingBox());
+	visible.push_back(1);
+	hierarchyDirty = true;
+	movedItems.push_back((GLuint)items.size() - 1);
+	updateBounds((GLuint)items.size() - 1);
+	return (GLuint)items.size() - 1;
+}
+
+/* Add every instance of a mesh as one item, returns its handle */
+//////////////////////////////////////////////////////////////////
+GLuint Scene::AddInstancedItem(GLuint meshHandle, GLuint materialHandle)
+{
+	DrawItem item;
+	item.meshHandle = meshHandle;
+	item.materialHandle = materialHandle;
+	item.modelMatrix = glm::mat4(1.0f);
+	item.normalMatrix = glm::mat3(1.0f);
+	item.instanced = true;
+	item.batched = false;
+	item.lod = 0;
+	item.occluder = false;
+
+	items.push_back(item);
+	culler.Add(glm::vec4(0.0f), glm::vec3(0.0f), glm::vec3(0.0f));
+	worldBoxes.push_back(BoundingBox());
+	visible.push_back(1);
+	hierarchyDirty = true;
+	movedItems.push_back((GLuint)items.size() - 1);
+	updateBounds((GLuint)items.size() - 1);
+	return (GLuint)items.size() - 1;
+}
+
+/* Move an object, the only time its model matrix is rebuilt */
+///////////////////////////////////////////////////////////////
+void Scene::SetTransform(GLuint itemHandle, const glm::mat4& model)
+{
+	items[itemHandle].modelMatrix = model;
+	movedItems.push_back(itemHandle);
+	updateBounds(itemHandle);
+}
+
+/* Hand an item over to an IndirectScene, or give it back to the queue */
+/////////////////////////////////////////////////////////////////////////
+void Scene::SetBatched(GLuint itemHandle, bool batched)
+{
+	items[itemHandle].batched = batched;
+}
+
+/* Let an item hide the items behind it */
+///////////////////////////////////////////
+void Scene::SetOccluder(GLuint itemHandle, bool occluder)
+{
+	items[itemHandle].occluder = occluder;
+}
+
+/* Recompute the normal matrices of every item added or moved since the last call in one batch */
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Scene::UpdateNormalMatrices()
+{
+	if (movedItems.empty())
+	{
+		return;
+	}
+
+	movedModels.resize(movedItems.size());
+	movedNormals.resize(movedItems.size());
+	for (size_t i = 0; i < movedItems.size(); ++i)
+	{
+		movedModels[i] = items[movedItems[i]].modelMatrix;
+	}
+
+	ComputeNormalMatrices(movedModels.data(), movedNormals.data(), movedItems.size());
+
+	for (size_t i = 0; i < movedItems.size(); ++i)
+	{
+		items[movedItems[i]].normalMatrix = movedNormals[i];
+	}
+	movedItems.clear();
+}
+
+/* Test every item against the view frustum and then the occluders, batched ones included */
+/* Large scenes walk the hierarchy, small ones test every item                            */
+////////////////////////////////////////////////////////////////////////////////////////////
+void Scene::Cull(const glm::mat4& viewProjection)
+{
+	if (items.size() < SCENE_HIERARCHY_MIN_ITEMS)
+	{
+		culler.SetViewProjection(viewProjection);
+		culler.Cull();
+
+		for (GLuint i = 0; i < items.size(); ++i)
+		{
+			visible[i] = culler.IsVisible(i);
+		}
+
+		gFrameStats.visibleObjects += culler.GetVisibleCount();
+		gFrameStats.culledObjects += culler.GetCulledCount();
+	}
+	else
+	{
+		if (hierarchyDirty)
+		{
+			buildHierarchy();
+		}
+
+		glm::vec4 planes[6];
+		ExtractFrustumPlanes(viewProjection, planes);
+		hierarchy.QueryFrustum(planes, queryResults);
+
+		fill(visible.begin(), visible.end(), 0);
+		for (size_t i = 0; i < queryResults.size(); ++i)
+		{
+			visible[queryResults[i]] = 1;
+		}
+
+		gFrameStats.visibleObjects += (GLuint)queryResults.size();
+		gFrameStats.culledObjects += (GLuint)(items.size() - queryResults.size());
+	}
+
+	occlusion.Begin(viewProjection);
+	cullOccluded();
+}
+
+/* Check whether an item passed the last Cull, items are visible before the first */
+/////////////////////////////////////////////////////////////////////////////////////
+bool Scene::IsVisible(GLuint itemHandle) const
+{
+	return visible[itemHandle] != 0;
+}
+
+/* Get the item whose world box a ray enters first, NO_ITEM when it misses */
+/////////////////////////////////////////////////////////////////////////////
+GLuint Scene::Pick(const glm::vec3& origin, const glm::vec3& direction)
+{
+	if (hierarchyDirty)
+	{
+		buildHierarchy();
+	}
+
+	uint32_t primitive;
+	float distance;
+	if (!hierarchy.Raycast(origin, direction, numeric_limits<float>::max(), primitive, distance))
+	{
+		return NO_ITEM;
+	}
+
+	return primitive;
+}
+
+/* Print the hierarchy, if culling or picking built one */
+//////////////////////////////////////////////////////////
+void Scene::PrintStats() const
+{
+	hierarchy.PrintStats();
+}
+
+/* Queue every item that is not batched with its distance from the camera */
+/* and a detail level picked from its projected size                       */
+//////////////////////////////////////////////////////////////////////////////
+void Scene::Enqueue(RenderQueue& queue, const glm::mat4& view, const glm::mat4& projection)
+{
+	UpdateNormalMatrices();
+
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		DrawItem& item = items[i];
+		if (item.batched || !IsVisible((GLuint)i))
+		{
+			continue;
+		}
+
+		// Instances share one draw, so the largest instance on screen decides the level
+		const Mesh* mesh = meshes[item.meshHandle];
+		float projectedSize = 0.0f;
+		if (item.instanced)
+		{
+			const vector<glm::vec4>& spheres = mesh->GetInstanceBoundingSpheres();
+			for (size_t j = 0; j < spheres.size(); ++j)
+			{
+				projectedSize = max(projectedSize, ProjectedSize(spheres[j], view, projection));
+			}
+		}
+		else
+		{
+			projectedSize = ProjectedSize(TransformBoundingSphere(mesh->GetBoundingSphere(), item.modelMatrix), view, projection);
+		}
+		item.lod = SelectLod(projectedSize, item.lod, mesh->GetLodCount());
+
+		// View space looks down -z, so depth is the negated z of the object's origin
+		glm::vec4 viewPosition = view * item.modelMatrix[3];
+		queue.Push(mesh, &materials[item.materialHandle], item.modelMatrix, item.normalMatrix, item.instanced, item.lod, -viewPosition.z);
+	}
+}
+
+/* Get the number of items */
+//////////////////////////////
+GLuint Scene::GetItemCount() const
+{
+	return (GLuint)items.size();
+}
+
+/* Get an item by handle */
+///////////////////////////
+const DrawItem& Scene::GetItem(GLuint itemHandle) const
+{
+	return items[itemHandle];
+}
+
+/* Get a mesh by handle */
+//////////////////////////
+const Mesh* Scene::GetMesh(GLuint meshHandle) const
+{
+	return meshes[meshHandle];
+}
+
+/* Get a material by handle */
+//////////////////////////////
+const Material& Scene::GetMaterial(GLuint materialHandle) const
+{
+	return materials[materialHandle];
+}
+
+/* Recompute an item's world space bounds for the culler                */
+/* Instanced items are bounded by the spheres of all of their instances */
+//////////////////////////////////////////////////////////////////////////
+void Scene::updateBounds(GLuint itemHandle)
+{
+	const DrawItem& item = items[itemHandle];
+	const Mesh* mesh = meshes[item.meshHandle];
+
+	glm::vec4 sphere;
+	glm::vec3 boxCenter, boxExtent;
+
+	if (item.instanced)
+	{
+		const vector<glm::vec4>& spheres = mesh->GetInstanceBoundingSpheres();
+		glm::vec3 minimum(0.0f), maximum(0.0f);
+		for (size_t i = 0; i < spheres.size(); ++i)
+		{
+			glm::vec3 center(spheres[i]);
+			minimum = i == 0 ? center - glm::vec3(spheres[i].w) : glm::min(minimum, center - glm::vec3(spheres[i].w));
+			maximum = i == 0 ? center + glm::vec3(spheres[i].w) : glm::max(maximum, center + glm::vec3(spheres[i].w));
+		}
+
+		boxCenter = (minimum + maximum) * 0.5f;
+		boxExtent = (maximum - minimum) * 0.5f;
+		sphere = glm::vec4(boxCenter, glm::length(boxExtent));
+	}
+	else
+	{
+		const BoundingBox& box = mesh->GetBoundingBox();
+		TransformBoundingBox(box.minimum, box.maximum, item.modelMatrix, boxCenter, boxExtent);
+		sphere = TransformBoundingSphere(mesh->GetBoundingSphere(), item.modelMatrix);
+	}
+
+	culler.SetBounds(itemHandle, sphere, boxCenter, boxExtent);
+
+	worldBoxes[itemHandle].minimum = boxCenter - boxExtent;
+	worldBoxes[itemHandle].maximum = boxCenter + boxExtent;
+	if (!hierarchyDirty)
+	{
+		hierarchy.Refit(itemHandle, worldBoxes[itemHandle]);
+	}
+}
+
+/* Rasterize the visible occluders, then hide visible items entirely behind them */
+////////////////////////////////////////////////////////////////////////////////////
+void Scene::cullOccluded()
+{
+	for (GLuint i = 0; i < items.size(); ++i)
+	{
+		if (items[i].occluder && visible[i])
+		{
+			occlusion.AddOccluder(meshes[items[i].meshHandle]->GetBoundingBox(), items[i].modelMatrix);
+		}
+	}
+
+	if (occlusion.GetOccluderCount() == 0)
+	{
+		return;
+	}
+	occlusion.Finish();
+
+	// Occluders are never hidden themselves, they only hide other items
+	for (GLuint i = 0; i < items.size(); ++i)
+	{
+		if (items[i].occluder || !visible[i])
+		{
+			continue;
+		}
+
+		++gFrameStats.occlusionTests;
+		if (occlusion.IsOccluded(worldBoxes[i]))
+		{
+			visible[i] = 0;
+			++gFrameStats.occludedObjects;
+		}
+	}
+}
+
+/* Rebuild the hierarchy over every item's world box */
+////////////////////////////////////////////////////////
+void Scene::buildHierarchy()
+{
+	hierarchy.Build(worldBoxes);
+	hierarchyDirty = false;
+}
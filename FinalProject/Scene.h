@@ -0,0 +1,87 @@
+#pragma once
+
+#include "BoundingVolumeHierarchy.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "Mesh.h"
+#include "RenderQueue.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+using namespace std;
+
+/* One object in the scene, refers to its mesh and material by handle */
+/////////////////////////////////////////////////////////////////////////
+struct DrawItem
+{
+	GLuint meshHandle;
+	GLuint materialHandle;
+	glm::mat4 modelMatrix;
+	glm::mat3 normalMatrix; // Inverse transpose of modelMatrix, refreshed by UpdateNormalMatrices
+	bool instanced; // Draw the mesh's instance transforms instead of modelMatrix
+	bool batched;   // Drawn by an IndirectScene instead of the render queue
+	GLuint lod;     // Detail level drawn last frame
+	bool occluder;  // Rasterized into the occlusion buffer, its mesh's box should be solid
+};
+
+// Item count from which culling walks a hierarchy instead of testing every item
+const GLuint SCENE_HIERARCHY_MIN_ITEMS = 256;
+
+// Returned by Pick when the ray hits nothing
+const GLuint NO_ITEM = 0xFFFFFFFF;
+
+/* Flat list of draw items built once and queued every frame */
+///////////////////////////////////////////////////////////////
+class Scene
+{
+public:
+	Scene();
+
+	GLuint AddMesh(const Mesh* mesh);
+	GLuint AddMaterial(const Material& material);
+	GLuint AddItem(GLuint meshHandle, GLuint materialHandle, const glm::mat4& model);
+	GLuint AddInstancedItem(GLuint meshHandle, GLuint materialHandle);
+	void SetTransform(GLuint itemHandle, const glm::mat4& model);
+	void SetBatched(GLuint itemHandle, bool batched);
+	void SetOccluder(GLuint itemHandle, bool occluder);
+	void UpdateNormalMatrices();
+	void Cull(const glm::mat4& viewProjection);
+	bool IsVisible(GLuint itemHandle) const;
+	GLuint Pick(const glm::vec3& origin, const glm::vec3& direction);
+	void PrintStats() const;
+	void Enqueue(RenderQueue& queue, const glm::mat4& view, const glm::mat4& projection);
+
+	GLuint GetItemCount() const;
+	const DrawItem& GetItem(GLuint itemHandle) const;
+	const Mesh* GetMesh(GLuint meshHandle) const;
+	const Material& GetMaterial(GLuint materialHandle) const;
+
+private:
+	vector<const Mesh*> meshes;
+	vector<Material> materials;
+	vector<DrawItem> items;
+
+	// Items added or moved since their normal matrix was last computed, gathered for one batch
+	vector<GLuint> movedItems;
+	vector<glm::mat4> movedModels;
+	vector<glm::mat3> movedNormals;
+
+	// World space bounds of every item, indexed by item handle
+	FrustumCuller culler;
+	vector<BoundingBox> worldBoxes;
+
+	// Built on first use, refit when an item moves and rebuilt when items are added
+	BoundingVolumeHierarchy hierarchy;
+	bool hierarchyDirty;
+	vector<uint32_t> queryResults;
+
+	// Items that passed the frustum and occlusion tests of the last Cull
+	vector<unsigned char> visible;
+	OcclusionCuller occlusion;
+
+	void updateBounds(GLuint itemHandle);
+	void buildHierarchy();
+	void cullOccluded();
+};
@@ -0,0 +1,185 @@
+#include "ShaderCache.h"
+
+#include <iostream>
+#include <sstream>
+
+/* Pack the permutation into one word, light counts stay below 256 */
+//////////////////////////////////////////////////////////////////////
+GLuint ShaderPermutation::GetKey() const
+{
+	return features | directionalLights << 8 | pointLights << 16;
+}
+
+/* Source lines defining every switch of the permutation */
+///////////////////////////////////////////////////////////
+string ShaderPermutation::GetDefines() const
+{
+	// Features are constant bools, so the compiler drops the branches they guard
+	ostringstream defines;
+	defines << "#define TEXTURED " << ((features & SHADER_TEXTURED) != 0 ? "true" : "false") << "\n";
+	defines << "#define SPOT_LIGHTS " << ((features & SHADER_SPOT_LIGHTS) != 0 ? "true" : "false") << "\n";
+	defines << "#define NR_DIRECTIONAL_LIGHTS " << directionalLights << "\n";
+	defines << "#define NR_POINT_LIGHTS " << pointLights << "\n";
+	return defines.str();
+}
+
+/* Put the defines right after the #version line, which has to come first */
+////////////////////////////////////////////////////////////////////////////
+static string injectDefines(const char* source, const string& defines)
+{
+	string injected(source);
+	size_t versionEnd = injected.find('\n');
+	injected.insert(versionEnd == string::npos ? injected.size() : versionEnd + 1, defines);
+	return injected;
+}
+
+/* Compile shaders and check for errors */
+//////////////////////////////////////////
+bool CreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId)
+{
+	// For error reporting
+	int success = 0;
+	char infoLog[512];
+
+	programId = glCreateProgram();
+
+	// Create vertex shader and fragment shader objects
+	GLuint vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
+	GLuint fragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
+
+	// Retrive the shader source
+	glShaderSource(vertexShaderId, 1, &vtxShaderSource, NULL);
+	glShaderSource(fragmentShaderId, 1, &fragShaderSource, NULL);
+
+	// Compile vertex shader
+	glCompileShader(vertexShaderId);
+	// Check for errors
+	glGetShaderiv(vertexShaderId, GL_COMPILE_STATUS, &success);
+	if (!success)
+	{
+		glGetShaderInfoLog(vertexShaderId, sizeof(infoLog), NULL, infoLog);
+		cout << "Vertex shader compilation failed." << infoLog << endl;
+		return false;
+	}
+
+	// Compile fragment shader
+	glCompileShader(fragmentShaderId);
+	glGetShaderiv(fragmentShaderId, GL_COMPILE_STATUS, &success);
+	if (!success)
+	{
+		glGetShaderInfoLog(fragmentShaderId, sizeof(infoLog), NULL, infoLog);
+		cout << "Fragment shader compilation failed." << infoLog << endl;
+		return false;
+	}
+
+	// Attach both shaders to the program
+	glAttachShader(programId, vertexShaderId);
+	glAttachShader(programId, fragmentShaderId);
+
+	glLinkProgram(programId);
+	// Check for errors
+	glGetProgramiv(programId, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glGetProgramInfoLog(programId, sizeof(infoLog), NULL, infoLog);
+		cout << "Error linking shader program." << infoLog << endl;
+		return false;
+	}
+
+	// Use shader program
+	glUseProgram(programId);
+
+	return true;
+}
+
+/* Release shader */
+////////////////////
+void DestroyShaderProgram(GLuint programId)
+{
+	glDeleteProgram(programId);
+}
+
+/* Constructor */
+/////////////////
+ShaderCache::ShaderCache()
+{
+	hits = 0;
+	misses = 0;
+}
+
+/* Return the cached program, compiling this variant now on a miss */
+//////////////////////////////////////////////////////////////////////
+GLuint ShaderCache::Acquire(const char* vertexSource, const char* fragmentSource, const ShaderPermutation& permutation)
+{
+	ProgramKey key = { vertexSource, fragmentSource, permutation.GetKey() };
+	auto it = programs.find(key);
+	if (it != programs.end())
+	{
+		++hits;
+		return it->second;
+	}
+	++misses;
+
+	string defines = permutation.GetDefines();
+	string vertex = injectDefines(vertexSource, defines);
+	string fragment = injectDefines(fragmentSource, defines);
+
+	// A variant that fails is remembered as 0, so it is not compiled again
+	GLuint programId = 0;
+	if (!CreateShaderProgram(vertex.c_str(), fragment.c_str(), programId))
+	{
+		DestroyShaderProgram(programId);
+		programId = 0;
+	}
+
+	programs[key] = programId;
+	return programId;
+}
+
+/* Release every program */
+///////////////////////////
+void ShaderCache::Clear()
+{
+	for (auto it = programs.begin(); it != programs.end(); ++it)
+	{
+		DestroyShaderProgram(it->second);
+	}
+	programs.clear();
+}
+
+/* Get the number of variants built */
+//////////////////////////////////////
+size_t ShaderCache::GetSize() const
+{
+	return programs.size();
+}
+
+/* Print how many variants were built and how often they were reused */
+///////////////////////////////////////////////////////////////////////
+void ShaderCache::PrintStats() const
+{
+	cout << "Shader cache: " << programs.size() << " programs, " << hits << " hits, " << misses << " misses" << endl;
+}
+
+/* Destructor */
+////////////////
+ShaderCache::~ShaderCache()
+{
+	Clear();
+}
+
+/* Hash the source pointers and permutation key */
+///////////////////////////////////////////////////
+size_t ShaderCache::KeyHash::operator()(const ProgramKey& key) const
+{
+	size_t seed = std::hash<const char*>()(key.vertexSource);
+	seed = seed * 31 + std::hash<const char*>()(key.fragmentSource);
+	return seed * 31 + key.permutation;
+}
+
+/* Programs are equal when built from the same sources and permutation */
+/////////////////////////////////////////////////////////////////////////
+bool ShaderCache::KeyEqual::operator()(const ProgramKey& a, const ProgramKey& b) const
+{
+	return a.vertexSource == b.vertexSource && a.fragmentSource == b.fragmentSource && a.permutation == b.permutation;
+}
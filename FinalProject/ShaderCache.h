@@ -0,0 +1,71 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+// Features a shader variant is compiled with, each is a bool constant in the source
+enum ShaderFeature
+{
+	SHADER_TEXTURED = 1 << 0,   // TEXTURED: sample uTexture instead of using objectColor
+	SHADER_SPOT_LIGHTS = 1 << 1 // SPOT_LIGHTS: clustered lights fade out at their spot cone
+};
+
+/* Compile-time choices of one shader variant, each is #defined after the #version line */
+///////////////////////////////////////////////////////////////////////////////////////////
+struct ShaderPermutation
+{
+	GLuint features;          // ShaderFeature bits
+	GLuint directionalLights; // NR_DIRECTIONAL_LIGHTS: frame data slots holding directional lights
+	GLuint pointLights;       // NR_POINT_LIGHTS: frame data slots holding point lights, after the directional ones
+
+	GLuint GetKey() const;
+	string GetDefines() const;
+};
+
+bool CreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
+void DestroyShaderProgram(GLuint programId);
+
+/* Builds each variant of a shader once, programs are keyed by their source strings */
+/* and permutation, so sources must outlive the cache                               */
+//////////////////////////////////////////////////////////////////////////////////////
+class ShaderCache
+{
+public:
+	ShaderCache();
+
+	// Return the program for these sources and permutation, compiling it on a miss, 0 if it fails to build
+	GLuint Acquire(const char* vertexSource, const char* fragmentSource, const ShaderPermutation& permutation);
+	void Clear();
+
+	size_t GetSize() const;
+	void PrintStats() const;
+
+	~ShaderCache();
+
+private:
+	struct ProgramKey
+	{
+		const char* vertexSource;
+		const char* fragmentSource;
+		GLuint permutation;
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const ProgramKey& key) const;
+	};
+
+	struct KeyEqual
+	{
+		bool operator()(const ProgramKey& a, const ProgramKey& b) const;
+	};
+
+	unordered_map<ProgramKey, GLuint, KeyHash, KeyEqual> programs;
+
+	size_t hits;
+	size_t misses;
+};
@@ -0,0 +1,207 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Calls to the global operator new since startup
+static atomic<size_t> allocationCount(0);
+
+/* Get the number of heap allocations made so far */
+/////////////////////////////////////////////////////
+size_t GetAllocationCount()
+{
+	return allocationCount.load(memory_order_relaxed);
+}
+
+/* Count and allocate, calling the new handler until it succeeds or gives up */
+/* Returns NULL instead of throwing when there is no handler                 */
+///////////////////////////////////////////////////////////////////////////////
+static void* countedAllocate(size_t size)
+{
+	allocationCount.fetch_add(1, memory_order_relaxed);
+
+	void* memory;
+	while ((memory = malloc(size > 0 ? size : 1)) == NULL)
+	{
+		new_handler handler = get_new_handler();
+		if (handler == NULL)
+		{
+			return NULL;
+		}
+		handler();
+	}
+
+	return memory;
+}
+
+/* Replace the global allocation functions to count every heap allocation */
+////////////////////////////////////////////////////////////////////////////
+void* operator new(size_t size)
+{
+	void* memory = countedAllocate(size);
+	if (memory == NULL)
+	{
+		throw bad_alloc();
+	}
+
+	return memory;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept
+{
+	try
+	{
+		return countedAllocate(size);
+	}
+	catch (...)
+	{
+		return NULL;
+	}
+}
+
+void* operator new[](size_t size, const nothrow_t& tag) noexcept
+{
+	return operator new(size, tag);
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, const nothrow_t&) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, const nothrow_t&) noexcept
+{
+	free(memory);
+}
+
+#ifdef __cpp_aligned_new
+/* Over-aligned types, allocated apart from malloc so they need their own free */
+/////////////////////////////////////////////////////////////////////////////////
+static void* countedAllocateAligned(size_t size, align_val_t alignment)
+{
+	allocationCount.fetch_add(1, memory_order_relaxed);
+
+	size_t align = static_cast<size_t>(alignment);
+	void* memory;
+	for (;;)
+	{
+#ifdef _MSC_VER
+		memory = _aligned_malloc(size > 0 ? size : 1, align);
+#else
+		// aligned_alloc wants a size that is a multiple of the alignment
+		memory = aligned_alloc(align, size > 0 ? (size + align - 1) / align * align : align);
+#endif
+		if (memory != NULL)
+		{
+			return memory;
+		}
+
+		new_handler handler = get_new_handler();
+		if (handler == NULL)
+		{
+			return NULL;
+		}
+		handler();
+	}
+}
+
+/* Release memory from countedAllocateAligned */
+/////////////////////////////////////////////////
+static void freeAligned(void* memory)
+{
+#ifdef _MSC_VER
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+void* operator new(size_t size, align_val_t alignment)
+{
+	void* memory = countedAllocateAligned(size, alignment);
+	if (memory == NULL)
+	{
+		throw bad_alloc();
+	}
+
+	return memory;
+}
+
+void* operator new[](size_t size, align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept
+{
+	try
+	{
+		return countedAllocateAligned(size, alignment);
+	}
+	catch (...)
+	{
+		return NULL;
+	}
+}
+
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t& tag) noexcept
+{
+	return operator new(size, alignment, tag);
+}
+
+void operator delete(void* memory, align_val_t) noexcept
+{
+	freeAligned(memory);
+}
+
+void operator delete[](void* memory, align_val_t) noexcept
+{
+	freeAligned(memory);
+}
+
+void operator delete(void* memory, size_t, align_val_t) noexcept
+{
+	freeAligned(memory);
+}
+
+void operator delete[](void* memory, size_t, align_val_t) noexcept
+{
+	freeAligned(memory);
+}
+
+void operator delete(void* memory, align_val_t, const nothrow_t&) noexcept
+{
+	freeAligned(memory);
+}
+
+void operator delete[](void* memory, align_val_t, const nothrow_t&) noexcept
+{
+	freeAligned(memory);
+}
+#endif
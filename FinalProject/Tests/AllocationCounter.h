@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+
+using namespace std;
+
+// Heap allocations made through any global operator new since startup
+// Only test programs link AllocationCounter.cpp, it replaces the global allocation functions
+size_t GetAllocationCount();
@@ -0,0 +1,141 @@
+#include "AllocationCounter.h"
+#include "Mesh.h"
+#include "Primitives.h"
+#include "Test.h"
+#include "VertexLayout.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+// Generation runs measured after the warm-up
+const int GENERATE_RUNS = 10;
+
+// Scratch vectors of the weld, cache, overdraw and fetch passes for one level, each sized once up front
+const size_t PREPARE_TEMPORARIES_PER_LEVEL = 28;
+
+// MSVC's checked iterators give every container a heap allocated proxy
+#if defined(_ITERATOR_DEBUG_LEVEL) && _ITERATOR_DEBUG_LEVEL > 0
+const size_t ALLOCATIONS_PER_VECTOR = 2;
+#else
+const size_t ALLOCATIONS_PER_VECTOR = 1;
+#endif
+
+/* Reallocations of a vector grown one element at a time to size, at the smallest growth factor in use */
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+static size_t growthAllocations(size_t size)
+{
+	return size <= 1 ? size : (size_t)ceil(log((double)size) / log(1.5)) + 1;
+}
+
+/* Most heap allocations Prepare may make for a mesh with the prepared outputs            */
+/* Every level costs the optimizer's temporaries and its own vertices, indices and lods,  */
+/* appended levels grow the outputs, packing makes one more vertex buffer                 */
+////////////////////////////////////////////////////////////////////////////////////////////
+static size_t prepareAllocationBound(const PreparedGeometry& prepared)
+{
+	size_t levels = prepared.lods.size();
+	size_t bound = levels * (PREPARE_TEMPORARIES_PER_LEVEL + 3) + 1;
+
+	if (levels > 1)
+	{
+		bound += growthAllocations((size_t)prepared.vertexCount * PRIMITIVE_FLOATS_PER_VERTEX * sizeof(GLfloat));
+		bound += growthAllocations(prepared.indices.size());
+		bound += growthAllocations(levels);
+	}
+
+	return bound * ALLOCATIONS_PER_VECTOR;
+}
+
+/* Generating into a reused MeshData allocates nothing once it has grown */
+///////////////////////////////////////////////////////////////////////////
+static void testGenerateReused(const char* name, const PrimitiveDesc& desc)
+{
+	MeshData data;
+	GeneratePrimitive(desc, data);
+
+	size_t before = GetAllocationCount();
+	for (int run = 0; run < GENERATE_RUNS; ++run)
+	{
+		GeneratePrimitive(desc, data);
+	}
+	size_t allocations = GetAllocationCount() - before;
+	cout << name << ": " << allocations << " allocations in " << GENERATE_RUNS << " reused generations" << endl;
+
+	CHECK(allocations == 0);
+}
+
+/* Generating into caller storage sized by the Count functions allocates nothing once the trig tables exist */
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void testGenerateCallerStorage(int sectorCount, int stackCount)
+{
+	PrimitiveCounts sphereCounts = CountSphere(sectorCount, stackCount);
+	PrimitiveCounts cylinderCounts = CountCylinder(sectorCount, stackCount);
+	vector<GLfloat> sphereVertices((size_t)sphereCounts.vertexCount * PRIMITIVE_FLOATS_PER_VERTEX);
+	vector<GLuint> sphereIndices(sphereCounts.indexCount);
+	vector<GLfloat> cylinderVertices((size_t)cylinderCounts.vertexCount * PRIMITIVE_FLOATS_PER_VERTEX);
+	vector<GLuint> cylinderIndices(cylinderCounts.indexCount);
+
+	GenerateSphere(0.5f, sectorCount, stackCount, sphereVertices.data(), sphereIndices.data());
+	GenerateCylinder(0.1f, 0.1f, sectorCount, 4.5f, stackCount, cylinderVertices.data(), cylinderIndices.data());
+
+	size_t before = GetAllocationCount();
+	for (int run = 0; run < GENERATE_RUNS; ++run)
+	{
+		GenerateSphere(0.5f, sectorCount, stackCount, sphereVertices.data(), sphereIndices.data());
+		GenerateCylinder(0.1f, 0.1f, sectorCount, 4.5f, stackCount, cylinderVertices.data(), cylinderIndices.data());
+	}
+	size_t allocations = GetAllocationCount() - before;
+	cout << "Caller storage " << sectorCount << "x" << stackCount << ": " << allocations << " allocations" << endl;
+
+	CHECK(allocations == 0);
+}
+
+/* Mesh::Prepare stays within the allocations its outputs and fixed temporaries account for */
+//////////////////////////////////////////////////////////////////////////////////////////////
+static void testPrepareAllocations(const char* name, const PrimitiveDesc& desc)
+{
+	// The first mesh grows the per-thread scratch buffers, later ones reuse them
+	const VertexLayout layout = VertexLayout::PackedPositionNormalUV();
+	PreparedGeometry warmup;
+	Mesh::Prepare(layout, desc, warmup);
+
+	PreparedGeometry prepared;
+	size_t before = GetAllocationCount();
+	CHECK(Mesh::Prepare(layout, desc, prepared));
+	size_t allocations = GetAllocationCount() - before;
+	size_t bound = prepareAllocationBound(prepared);
+	cout << name << ": " << allocations << " allocations to prepare, bound " << bound << endl;
+
+	CHECK(allocations <= bound);
+}
+
+int main()
+{
+	// The scene's meshes, round ones with their detail chains, and a finely tessellated sphere
+	PrimitiveDesc pencilBody = PrimitiveDesc::Cylinder(0.1f, 0.1f, 10, 4.5f, 4);
+	PrimitiveDesc sphere = PrimitiveDesc::Sphere(0.5f, 36, 18);
+	PrimitiveDesc fineSphere = PrimitiveDesc::Sphere(0.5f, 256, 128);
+	pencilBody.lodCount = MAX_PRIMITIVE_LODS;
+	sphere.lodCount = MAX_PRIMITIVE_LODS;
+
+	testGenerateReused("Plane", PrimitiveDesc::Plane());
+	testGenerateReused("Cube", PrimitiveDesc::Cube(2.5f, 0.3f, 2.5f));
+	testGenerateReused("Cylinder", pencilBody);
+	testGenerateReused("Sphere", sphere);
+	testGenerateReused("Sphere 256x128", fineSphere);
+
+	testGenerateCallerStorage(36, 18);
+	testGenerateCallerStorage(256, 128);
+
+	testPrepareAllocations("Plane", PrimitiveDesc::Plane());
+	testPrepareAllocations("Cube", PrimitiveDesc::Cube(2.5f, 0.3f, 2.5f));
+	testPrepareAllocations("Cylinder", pencilBody);
+	testPrepareAllocations("Sphere", sphere);
+	testPrepareAllocations("Sphere 256x128", fineSphere);
+	fineSphere.lodCount = MAX_PRIMITIVE_LODS;
+	testPrepareAllocations("Sphere 256x128 with detail levels", fineSphere);
+
+	return TestResult();
+}
@@ -0,0 +1,264 @@
+#include "BoundingVolumeHierarchy.h"
+#include "Test.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+// Boxes are scattered through a cube of this half size
+const float BVH_TEST_WORLD = 100.0f;
+
+// Frusta and rays checked per scene size
+const int BVH_TEST_FRUSTA = 32;
+const int BVH_TEST_RAYS = 256;
+
+/* Milliseconds elapsed since start */
+/////////////////////////////////////
+static double elapsedMilliseconds(chrono::steady_clock::time_point start)
+{
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
+
+/* Random boxes from 0.1 to 2 units on a side */
+////////////////////////////////////////////////
+static vector<BoundingBox> randomBoxes(mt19937& random, size_t count)
+{
+	uniform_real_distribution<float> position(-BVH_TEST_WORLD, BVH_TEST_WORLD);
+	uniform_real_distribution<float> size(0.1f, 2.0f);
+
+	vector<BoundingBox> boxes(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		boxes[i].minimum = glm::vec3(position(random), position(random), position(random));
+		boxes[i].maximum = boxes[i].minimum + glm::vec3(size(random), size(random), size(random));
+	}
+	return boxes;
+}
+
+/* Inward facing, normalized planes of a view projection, as ExtractFrustumPlanes makes them */
+////////////////////////////////////////////////////////////////////////////////////////////////
+static void extractPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[3] + rows[2];
+	planes[5] = rows[3] - rows[2];
+
+	for (int i = 0; i < 6; ++i)
+	{
+		planes[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+	}
+}
+
+/* A camera somewhere in the world looking in a random direction */
+///////////////////////////////////////////////////////////////////
+static void randomFrustum(mt19937& random, glm::vec4 planes[6])
+{
+	uniform_real_distribution<float> position(-BVH_TEST_WORLD, BVH_TEST_WORLD);
+	uniform_real_distribution<float> direction(-1.0f, 1.0f);
+	uniform_real_distribution<float> fov(30.0f, 90.0f);
+	uniform_real_distribution<float> range(10.0f, 150.0f);
+
+	glm::vec3 eye(position(random), position(random), position(random));
+	glm::vec3 forward(direction(random), direction(random), direction(random));
+	if (glm::length(forward) < 0.01f)
+	{
+		forward = glm::vec3(0.0f, 0.0f, -1.0f);
+	}
+	glm::vec3 up = fabs(glm::normalize(forward).y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+	glm::mat4 view = glm::lookAt(eye, eye + forward, up);
+	glm::mat4 projection = glm::perspective(glm::radians(fov(random)), 4.0f / 3.0f, 0.1f, range(random));
+	extractPlanes(projection * view, planes);
+}
+
+/* Brute force reference: every box not fully behind one of the planes */
+/////////////////////////////////////////////////////////////////////////
+static void queryFrustumBruteForce(const vector<BoundingBox>& boxes, const glm::vec4 planes[6], vector<uint32_t>& primitives)
+{
+	primitives.clear();
+	for (uint32_t primitive = 0; primitive < boxes.size(); ++primitive)
+	{
+		glm::vec3 center = (boxes[primitive].minimum + boxes[primitive].maximum) * 0.5f;
+		glm::vec3 extent = (boxes[primitive].maximum - boxes[primitive].minimum) * 0.5f;
+
+		bool outside = false;
+		for (int i = 0; i < 6 && !outside; ++i)
+		{
+			glm::vec3 normal(planes[i]);
+			outside = glm::dot(normal, center) + planes[i].w + glm::dot(glm::abs(normal), extent) < 0.0f;
+		}
+		if (!outside)
+		{
+			primitives.push_back(primitive);
+		}
+	}
+}
+
+/* Brute force reference: nearest box entry along the ray */
+/////////////////////////////////////////////////////////////
+static bool raycastBruteForce(const vector<BoundingBox>& boxes, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance)
+{
+	bool hit = false;
+	distance = maxDistance;
+
+	for (size_t primitive = 0; primitive < boxes.size(); ++primitive)
+	{
+		float entry = 0.0f, exit = maxDistance;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float inverse = 1.0f / direction[axis];
+			float t1 = (boxes[primitive].minimum[axis] - origin[axis]) * inverse;
+			float t2 = (boxes[primitive].maximum[axis] - origin[axis]) * inverse;
+			entry = max(entry, min(t1, t2));
+			exit = min(exit, max(t1, t2));
+		}
+		if (entry <= exit && (!hit || entry < distance))
+		{
+			distance = entry;
+			hit = true;
+		}
+	}
+
+	return hit;
+}
+
+/* Compare frustum queries of the tree against brute force */
+//////////////////////////////////////////////////////////////
+static void checkFrustumQueries(mt19937& random, const BoundingVolumeHierarchy& hierarchy, const vector<BoundingBox>& boxes)
+{
+	vector<uint32_t> found, expected;
+	glm::vec4 planes[6];
+
+	for (int frustum = 0; frustum < BVH_TEST_FRUSTA; ++frustum)
+	{
+		randomFrustum(random, planes);
+		hierarchy.QueryFrustum(planes, found);
+		queryFrustumBruteForce(boxes, planes, expected);
+
+		sort(found.begin(), found.end());
+		CHECK(found == expected);
+	}
+}
+
+/* Compare ray hits of the tree against brute force */
+///////////////////////////////////////////////////////
+static void checkRaycasts(mt19937& random, const BoundingVolumeHierarchy& hierarchy, const vector<BoundingBox>& boxes)
+{
+	uniform_real_distribution<float> position(-BVH_TEST_WORLD, BVH_TEST_WORLD);
+	uniform_real_distribution<float> direction(-1.0f, 1.0f);
+
+	for (int ray = 0; ray < BVH_TEST_RAYS; ++ray)
+	{
+		glm::vec3 origin(position(random), position(random), position(random));
+		glm::vec3 rayDirection = glm::normalize(glm::vec3(direction(random), direction(random), direction(random)) + glm::vec3(1e-3f));
+
+		uint32_t primitive = 0;
+		float distance = 0.0f, expectedDistance = 0.0f;
+		bool hit = hierarchy.Raycast(origin, rayDirection, 2.0f * BVH_TEST_WORLD, primitive, distance);
+		bool expectedHit = raycastBruteForce(boxes, origin, rayDirection, 2.0f * BVH_TEST_WORLD, expectedDistance);
+
+		// Ties may pick a different box, the distance must match
+		CHECK(hit == expectedHit);
+		if (hit && expectedHit)
+		{
+			CHECK(primitive < boxes.size());
+			CHECK(fabs(distance - expectedDistance) <= 1e-4f * (1.0f + expectedDistance));
+		}
+	}
+}
+
+/* Build, check and time the tree over count random boxes */
+/////////////////////////////////////////////////////////////
+static void testScene(mt19937& random, size_t count)
+{
+	vector<BoundingBox> boxes = randomBoxes(random, count);
+	BoundingVolumeHierarchy hierarchy;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	hierarchy.Build(boxes);
+	double buildMilliseconds = elapsedMilliseconds(start);
+
+	CHECK(hierarchy.GetPrimitiveCount() == count);
+	checkFrustumQueries(random, hierarchy, boxes);
+	checkRaycasts(random, hierarchy, boxes);
+
+	// Move a tenth of the boxes, the refit tree must still answer exactly
+	uniform_real_distribution<float> offset(-5.0f, 5.0f);
+	for (size_t i = 0; i < count; i += 10)
+	{
+		glm::vec3 move(offset(random), offset(random), offset(random));
+		boxes[i].minimum += move;
+		boxes[i].maximum += move;
+		hierarchy.Refit((uint32_t)i, boxes[i]);
+	}
+	checkFrustumQueries(random, hierarchy, boxes);
+	checkRaycasts(random, hierarchy, boxes);
+
+	// Time the same frusta through the tree and through brute force
+	vector<glm::vec4> frusta(BVH_TEST_FRUSTA * 6);
+	for (int frustum = 0; frustum < BVH_TEST_FRUSTA; ++frustum)
+	{
+		randomFrustum(random, &frusta[frustum * 6]);
+	}
+
+	vector<uint32_t> found;
+	size_t visible = 0;
+	start = chrono::steady_clock::now();
+	for (int frustum = 0; frustum < BVH_TEST_FRUSTA; ++frustum)
+	{
+		hierarchy.QueryFrustum(&frusta[frustum * 6], found);
+		visible += found.size();
+	}
+	double queryMilliseconds = elapsedMilliseconds(start) / BVH_TEST_FRUSTA;
+
+	start = chrono::steady_clock::now();
+	for (int frustum = 0; frustum < BVH_TEST_FRUSTA; ++frustum)
+	{
+		queryFrustumBruteForce(boxes, &frusta[frustum * 6], found);
+	}
+	double bruteForceMilliseconds = elapsedMilliseconds(start) / BVH_TEST_FRUSTA;
+
+	BvhStats stats = hierarchy.GetStats();
+	cout << count << " boxes: build " << buildMilliseconds << " ms, " << stats.nodeCount << " nodes, depth " << stats.depth
+		<< ", query " << queryMilliseconds << " ms against " << bruteForceMilliseconds << " ms brute force, "
+		<< visible / BVH_TEST_FRUSTA << " boxes visible on average" << endl;
+}
+
+int main()
+{
+	mt19937 random(330);
+
+	// An empty tree answers nothing
+	BoundingVolumeHierarchy empty;
+	vector<uint32_t> found(1, 0);
+	glm::vec4 planes[6];
+	randomFrustum(random, planes);
+	empty.Build(vector<BoundingBox>());
+	empty.QueryFrustum(planes, found);
+	CHECK(empty.IsEmpty());
+	CHECK(found.empty());
+
+	// A few boxes keep every path through small leaves covered
+	testScene(random, 1);
+	testScene(random, 7);
+	testScene(random, 10000);
+	testScene(random, 100000);
+	testScene(random, 1000000);
+
+	return TestResult();
+}
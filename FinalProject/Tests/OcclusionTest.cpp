@@ -0,0 +1,120 @@
+#include "OcclusionCuller.h"
+#include "Test.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace std;
+
+/* Box from its minimum and maximum corner */
+/////////////////////////////////////////////
+static BoundingBox makeBox(const glm::vec3& minimum, const glm::vec3& maximum)
+{
+	BoundingBox box;
+	box.minimum = minimum;
+	box.maximum = maximum;
+	return box;
+}
+
+/* The app's perspective camera at the origin looking down -z */
+////////////////////////////////////////////////////////////////
+static glm::mat4 cameraViewProjection()
+{
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+	return projection * view;
+}
+
+/* A solid cube hides what is fully behind it and nothing else */
+//////////////////////////////////////////////////////////////////
+static void testBehindCube()
+{
+	OcclusionCuller culler;
+	culler.Begin(cameraViewProjection());
+
+	// Four unit cube centered on the view axis, five to seven units away
+	culler.AddOccluder(makeBox(glm::vec3(-2.0f, -2.0f, -1.0f), glm::vec3(2.0f, 2.0f, 1.0f)), glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -6.0f)));
+	culler.Finish();
+	CHECK(culler.GetOccluderCount() == 1);
+
+	// Fully behind the cube
+	CHECK(culler.IsOccluded(makeBox(glm::vec3(-0.5f, -0.5f, -12.0f), glm::vec3(0.5f, 0.5f, -11.0f))));
+	CHECK(culler.IsOccluded(makeBox(glm::vec3(-1.0f, -1.0f, -40.0f), glm::vec3(1.0f, 1.0f, -30.0f))));
+
+	// Sticking out past the cube's silhouette, partly visible
+	CHECK(!culler.IsOccluded(makeBox(glm::vec3(1.0f, -0.5f, -12.0f), glm::vec3(6.0f, 0.5f, -11.0f))));
+	CHECK(!culler.IsOccluded(makeBox(glm::vec3(-0.5f, 1.5f, -12.0f), glm::vec3(0.5f, 4.0f, -11.0f))));
+
+	// In front of the cube
+	CHECK(!culler.IsOccluded(makeBox(glm::vec3(-0.5f, -0.5f, -3.0f), glm::vec3(0.5f, 0.5f, -2.5f))));
+
+	// Reaching from behind the cube to in front of it
+	CHECK(!culler.IsOccluded(makeBox(glm::vec3(-0.5f, -0.5f, -12.0f), glm::vec3(0.5f, 0.5f, -3.0f))));
+
+	// Off to the side of the cube
+	CHECK(!culler.IsOccluded(makeBox(glm::vec3(8.0f, -0.5f, -12.0f), glm::vec3(9.0f, 0.5f, -11.0f))));
+
+	// Crossing the near plane, left to the GPU
+	CHECK(!culler.IsOccluded(makeBox(glm::vec3(-0.5f, -0.5f, -12.0f), glm::vec3(0.5f, 0.5f, 1.0f))));
+}
+
+/* Without occluders nothing is hidden */
+/////////////////////////////////////////
+static void testNoOccluders()
+{
+	OcclusionCuller culler;
+	culler.Begin(cameraViewProjection());
+	culler.Finish();
+
+	CHECK(culler.GetOccluderCount() == 0);
+	CHECK(!culler.IsOccluded(makeBox(glm::vec3(-0.5f, -0.5f, -12.0f), glm::vec3(0.5f, 0.5f, -11.0f))));
+}
+
+/* Occluders crossing the near plane are skipped instead of rasterized */
+/////////////////////////////////////////////////////////////////////////
+static void testNearPlaneOccluder()
+{
+	OcclusionCuller culler;
+	culler.Begin(cameraViewProjection());
+
+	// Surrounds the camera, its projection would be garbage without clipping
+	culler.AddOccluder(makeBox(glm::vec3(-3.0f, -3.0f, -8.0f), glm::vec3(3.0f, 3.0f, 2.0f)), glm::mat4(1.0f));
+	CHECK(culler.GetOccluderCount() == 0);
+
+	// A real occluder off to the side, so the buffer is in use
+	culler.AddOccluder(makeBox(glm::vec3(6.0f, -1.0f, -21.0f), glm::vec3(8.0f, 1.0f, -19.0f)), glm::mat4(1.0f));
+	culler.Finish();
+	CHECK(culler.GetOccluderCount() == 1);
+
+	// Behind where the skipped occluder would have drawn, still visible
+	CHECK(!culler.IsOccluded(makeBox(glm::vec3(-0.5f, -0.5f, -12.0f), glm::vec3(0.5f, 0.5f, -11.0f))));
+	CHECK(!culler.IsOccluded(makeBox(glm::vec3(-2.0f, -2.0f, -60.0f), glm::vec3(2.0f, 2.0f, -50.0f))));
+
+	// The real occluder still hides what is behind it
+	CHECK(culler.IsOccluded(makeBox(glm::vec3(13.5f, -0.5f, -41.0f), glm::vec3(14.5f, 0.5f, -40.0f))));
+}
+
+/* Begin starts a new view with an empty buffer */
+///////////////////////////////////////////////////
+static void testBeginClears()
+{
+	OcclusionCuller culler;
+	culler.Begin(cameraViewProjection());
+	culler.AddOccluder(makeBox(glm::vec3(-2.0f, -2.0f, -7.0f), glm::vec3(2.0f, 2.0f, -5.0f)), glm::mat4(1.0f));
+	culler.Finish();
+	CHECK(culler.IsOccluded(makeBox(glm::vec3(-0.5f, -0.5f, -12.0f), glm::vec3(0.5f, 0.5f, -11.0f))));
+
+	culler.Begin(cameraViewProjection());
+	culler.AddOccluder(makeBox(glm::vec3(6.0f, -1.0f, -21.0f), glm::vec3(8.0f, 1.0f, -19.0f)), glm::mat4(1.0f));
+	culler.Finish();
+	CHECK(!culler.IsOccluded(makeBox(glm::vec3(-0.5f, -0.5f, -12.0f), glm::vec3(0.5f, 0.5f, -11.0f))));
+}
+
+int main()
+{
+	testBehindCube();
+	testNoOccluders();
+	testNearPlaneOccluder();
+	testBeginClears();
+
+	return TestResult();
+}
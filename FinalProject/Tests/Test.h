@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+// Record a failed condition with its location, the test keeps running
+#define CHECK(condition) Check((condition), #condition, __FILE__, __LINE__)
+
+/* Number of checks that failed so far */
+/////////////////////////////////////////
+inline int& FailedCheckCount()
+{
+	static int count = 0;
+	return count;
+}
+
+/* Report a failed check */
+///////////////////////////
+inline bool Check(bool passed, const char* expression, const char* file, int line)
+{
+	if (!passed)
+	{
+		cout << file << "(" << line << "): check failed: " << expression << endl;
+		++FailedCheckCount();
+	}
+	return passed;
+}
+
+/* Print the summary and get the exit code of a test program */
+///////////////////////////////////////////////////////////////
+inline int TestResult()
+{
+	if (FailedCheckCount() > 0)
+	{
+		cout << FailedCheckCount() << " checks failed" << endl;
+		return EXIT_FAILURE;
+	}
+
+	cout << "All checks passed" << endl;
+	return EXIT_SUCCESS;
+}
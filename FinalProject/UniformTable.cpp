@@ -0,0 +1,96 @@
+#include "UniformTable.h"
+
+#include <vector>
+
+GLuint UniformTable::lookupCount = 0;
+
+/* Constructor */
+/////////////////
+UniformTable::UniformTable()
+{
+	program = 0;
+}
+
+/* Enumerate the active uniforms of a linked program and store their locations */
+/////////////////////////////////////////////////////////////////////////////////
+void UniformTable::Build(GLuint programId)
+{
+	program = programId;
+	locations.clear();
+
+	GLint uniformCount = 0;
+	GLint maxNameLength = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	vector<GLchar> name(maxNameLength > 0 ? maxNameLength : 1);
+
+	for (GLint i = 0; i < uniformCount; ++i)
+	{
+		GLsizei nameLength = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(program, (GLuint)i, maxNameLength, &nameLength, &size, &type, name.data());
+
+		string uniformName(name.data(), nameLength);
+		GLint location = glGetUniformLocation(program, uniformName.c_str());
+
+		// Uniforms inside a uniform block have no location
+		if (location < 0)
+		{
+			continue;
+		}
+
+		locations[uniformName] = location;
+
+		// Arrays of basic types are reported once as "name[0]", store every element
+		size_t bracket = uniformName.rfind("[0]");
+		if (bracket != string::npos && bracket + 3 == uniformName.size())
+		{
+			string baseName = uniformName.substr(0, bracket);
+			locations[baseName] = location;
+
+			for (GLint element = 1; element < size; ++element)
+			{
+				string elementName = baseName + "[" + to_string(element) + "]";
+				locations[elementName] = glGetUniformLocation(program, elementName.c_str());
+			}
+		}
+	}
+}
+
+/* Get the location handle of a uniform, -1 if it is not active */
+//////////////////////////////////////////////////////////////////
+GLint UniformTable::Location(const char* name) const
+{
+	++lookupCount;
+
+	unordered_map<string, GLint>::const_iterator it = locations.find(name);
+	if (it == locations.end())
+	{
+		return -1;
+	}
+
+	return it->second;
+}
+
+/* Get the program the table was built from */
+//////////////////////////////////////////////
+GLuint UniformTable::GetProgram() const
+{
+	return program;
+}
+
+/* Get the number of name lookups since the last reset */
+/////////////////////////////////////////////////////////
+GLuint UniformTable::GetLookupCount()
+{
+	return lookupCount;
+}
+
+/* Reset the lookup counter, called once per frame */
+/////////////////////////////////////////////////////
+void UniformTable::ResetLookupCount()
+{
+	lookupCount = 0;
+}
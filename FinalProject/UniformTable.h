@@ -0,0 +1,31 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+/* Reflection cache of the active uniforms of a linked shader program */
+/* Locations are resolved once so the render loop only uses handles   */
+//////////////////////////////////////////////////////////////////////////
+class UniformTable
+{
+public:
+	UniformTable();
+
+	void Build(GLuint programId);
+	GLint Location(const char* name) const;
+	GLuint GetProgram() const;
+
+	static GLuint GetLookupCount();
+	static void ResetLookupCount();
+
+private:
+	GLuint program;
+	unordered_map<string, GLint> locations;
+
+	// Number of name lookups since the last reset, should stay 0 per frame after warm-up
+	static GLuint lookupCount;
+};
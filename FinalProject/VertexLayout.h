@@ -0,0 +1,97 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Most attributes a vertex layout can describe
+const GLuint MAX_VERTEX_ATTRIBUTES = 8;
+
+// First of the four locations holding the per-instance model matrix
+const GLuint INSTANCE_MODEL_LOCATION = 3;
+
+// First of the three locations holding the per-instance normal matrix, after the model matrix
+const GLuint INSTANCE_NORMAL_LOCATION = 7;
+
+/* Per-instance vertex data of instanced draws */
+/////////////////////////////////////////////////
+struct InstanceTransform
+{
+	glm::mat4 model;
+	glm::mat3 normalMatrix; // Inverse transpose of model
+};
+
+/* Vertex of the packed layout, 16 bytes instead of 32 */
+//////////////////////////////////////////////////////////
+struct PackedVertex
+{
+	GLshort position[3]; // Normalized to the mesh's bounding box
+	GLshort padding;
+	GLuint normal;       // Octahedral x and y in the low 20 bits of a 2_10_10_10
+	GLushort uv[2];      // Normalized to [0, 1]
+};
+
+/* One vertex attribute inside an interleaved vertex */
+//////////////////////////////////////////////////////
+struct VertexAttribute
+{
+	GLuint location;       // Shader attribute location
+	GLint components;      // Number of components (1 to 4)
+	GLenum type;           // Component type, e.g. GL_FLOAT
+	GLboolean normalized;  // Map integer types to [0, 1] or [-1, 1]
+	GLuint offset;         // Byte offset inside the vertex
+};
+
+/* Describes how interleaved vertex data is laid out in a vertex buffer */
+//////////////////////////////////////////////////////////////////////////
+struct VertexLayout
+{
+	GLsizei stride; // Bytes per vertex
+	GLuint attributeCount;
+	VertexAttribute attributes[MAX_VERTEX_ATTRIBUTES];
+
+	/* True when both layouts read vertex data the same way */
+	bool Matches(const VertexLayout& other) const
+	{
+		if (stride != other.stride || attributeCount != other.attributeCount)
+		{
+			return false;
+		}
+
+		for (GLuint i = 0; i < attributeCount; ++i)
+		{
+			const VertexAttribute& a = attributes[i];
+			const VertexAttribute& b = other.attributes[i];
+			if (a.location != b.location || a.components != b.components || a.type != b.type ||
+				a.normalized != b.normalized || a.offset != b.offset)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	/* Position (3 floats), normal (3 floats), texture coordinate (2 floats) */
+	static VertexLayout PositionNormalUV()
+	{
+		VertexLayout layout;
+		layout.stride = sizeof(GLfloat) * 8;
+		layout.attributeCount = 3;
+		layout.attributes[0] = { 0, 3, GL_FLOAT, GL_FALSE, 0 };
+		layout.attributes[1] = { 1, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 3 };
+		layout.attributes[2] = { 2, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 6 };
+		return layout;
+	}
+
+	/* Position (3 snorm16), octahedral normal (2_10_10_10), texture coordinate (2 unorm16) */
+	static VertexLayout PackedPositionNormalUV()
+	{
+		VertexLayout layout;
+		layout.stride = sizeof(PackedVertex);
+		layout.attributeCount = 3;
+		layout.attributes[0] = { 0, 3, GL_SHORT, GL_TRUE, 0 };
+		layout.attributes[1] = { 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(GLshort) * 4 };
+		layout.attributes[2] = { 2, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(GLshort) * 4 + sizeof(GLuint) };
+		return layout;
+	}
+};
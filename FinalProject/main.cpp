@@ -13,7 +13,20 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "dependencies/stb_image.h"
 
+#include "ClusteredLighting.h"
+#include "FrameContext.h"
+#include "FrameStats.h"
+#include "GeometryArena.h"
+#include "IndirectScene.h"
+#include "JobPool.h"
+#include "LightManager.h"
 #include "Mesh.h"
+#include "MeshBatch.h"
+#include "PrimitiveCache.h"
+#include "RenderQueue.h"
+#include "Scene.h"
+#include "ShaderCache.h"
+#include "UniformTable.h"
 
 using namespace std;
 
@@ -22,6 +35,11 @@ using namespace std;
 #define GLSL(Version, Source) "#version " #Version " core \n" #Source
 #endif
 
+/* Shader program Macro that also requires one extension */
+#ifndef GLSL_EXT
+#define GLSL_EXT(Version, Extension, Source) "#version " #Version " core \n#extension " #Extension " : require \n" #Source
+#endif
+
 namespace
 {
 	// Window dimensions
@@ -32,6 +50,17 @@ namespace
 	// Shader program ID
 	GLuint objectShaderId;
 	GLuint lightShaderId;
+	GLuint indirectShaderId;
+
+	// Uniform tables and handles for each shader program
+	UniformTable objectUniformTable;
+	UniformTable lightUniformTable;
+	DrawUniforms objectUniforms;
+	DrawUniforms lightUniforms;
+
+	// Camera and light data shared by both programs
+	FrameUniformBuffer frameUniformBuffer;
+	FrameData frameData;
 
 	// Texture IDs
 	GLuint textureIdPencil;
@@ -43,6 +72,8 @@ namespace
 
 	// For camera control
 	Camera gCamera(glm::vec3(0.0f, 0.0f, 3.0f));
+	// Camera matrices, rebuilt only when the camera or projection changes
+	FrameContext gFrameContext;
 	float gLastX = WINDOW_WIDTH / 2.0f;
 	float gLastY = WINDOW_HEIGHT / 2.0f;
 	bool gFirstMouse = true;
@@ -66,22 +97,61 @@ namespace
 //////////////////////////
 const char* objectVertexShader = GLSL(330,
 	layout(location = 0) in vec3 position;
-	layout(location = 1) in vec3 normal;
+	layout(location = 1) in vec4 normal; // Octahedral in xy when packed
 	layout(location = 2) in vec2 textureCoordinate;
+	layout(location = 3) in mat4 instanceModel; // Identity unless drawn instanced
+	layout(location = 7) in mat3 instanceNormalMatrix; // Inverse transpose of instanceModel
 
 	out vec3 vertexNormal;
 	out vec3 vertexFragmentPos;
 	out vec2 vertexTextureCoordinate;
 
+	struct Light {
+		vec3 position; // Light position
+		vec3 color; // Light color
+		vec3 direction;
+
+		float intensity; // Intensity percentage ranging from 0.0 to 1.0
+	};
+
+	const int NR_LIGHTS = 3;
+
+	// Shared with every program, written once per frame
+	layout(std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec3 viewPosition;
+		Light lights[NR_LIGHTS];
+	};
+
 	uniform mat4 model;
-	uniform mat4 view;
-	uniform mat4 projection;
+	uniform mat3 normalMatrix; // Inverse transpose of model, computed once per object on the CPU
+
+	// Packed positions are relative to the mesh's bounding box
+	uniform vec3 positionScale;
+	uniform vec3 positionOffset;
+	uniform bool octahedralNormals;
+
+	// Unfold a normal stored on the octahedron
+	vec3 decodeOctahedral(vec2 encoded)
+	{
+		vec3 normal = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+		float fold = max(-normal.z, 0.0f);
+		normal.x += normal.x >= 0.0f ? -fold : fold;
+		normal.y += normal.y >= 0.0f ? -fold : fold;
+		return normalize(normal);
+	}
 
 	void main()
 	{
-		gl_Position = projection * view * model * vec4(position, 1.0f);
-		vertexFragmentPos = vec3(model * vec4(position, 1.0f));
-		vertexNormal = mat3(transpose(inverse(model))) * normal;
+		vec3 objectPosition = position * positionScale + positionOffset;
+		vec3 objectNormal = octahedralNormals ? decodeOctahedral(normal.xy) : normal.xyz;
+
+		mat4 world = model * instanceModel;
+		gl_Position = projection * view * world * vec4(objectPosition, 1.0f);
+		vertexFragmentPos = vec3(world * vec4(objectPosition, 1.0f));
+		vertexNormal = normalMatrix * instanceNormalMatrix * objectNormal;
 		vertexTextureCoordinate = textureCoordinate;
 	}
 );
@@ -96,9 +166,7 @@ const char* objectFragmentShader = GLSL(330,
 	out vec4 fragmentColor;
 
 	uniform vec3 objectColor;
-	uniform vec3 viewPosition;
 	uniform sampler2D uTexture;
-	uniform bool hasTexture;
 
 	struct Light {
 		vec3 position; // Light position
@@ -109,64 +177,180 @@ const char* objectFragmentShader = GLSL(330,
 	};
 
 	const int NR_LIGHTS = 3;
-	uniform Light lights[NR_LIGHTS];
 
-	vec3 CalcPhong(Light light);
+	// Shared with every program, written once per frame
+	layout(std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec3 viewPosition;
+		Light lights[NR_LIGHTS];
+	};
+
+	vec3 CalcPhong(vec3 norm, vec3 viewDir, vec3 lightDirection, vec3 color, float attenuation);
 
 	void main()
 	{
-		vec3 result;
+		// Normal and view direction are the same for every light
+		vec3 norm = normalize(vertexNormal); // Normalize vectors to 1 unit
+		vec3 viewDir = normalize(viewPosition - vertexFragmentPos); // Calculate view direction
+		vec3 result = vec3(0.0);
 
-		for (int i = 0; i < NR_LIGHTS; i++) // Loop over the lights 
+		// Directional lights fill the first slots and point lights follow, so neither loop branches on the light type
+		for (int i = 0; i < NR_DIRECTIONAL_LIGHTS; i++)
 		{
-			result += CalcPhong(lights[i]);
+			result += CalcPhong(norm, viewDir, normalize(-lights[i].direction), lights[i].color, 1.0f);
 		}
-		fragmentColor = vec4(result, 1.0); // Send lighting results to GPU
-	}
-
-	vec3 CalcPhong(Light light)
-	{
-		float attenuation = 1.0f;
-		vec3 lightDirection = normalize(-light.direction);
-
-		// If there is no direction vector, light is a point light so recalculate attenuation and light direction
-		if (light.direction == vec3(0.0))
+		for (int i = NR_DIRECTIONAL_LIGHTS; i < NR_DIRECTIONAL_LIGHTS + NR_POINT_LIGHTS; i++)
 		{
-			// Calculate attenuation
-			float distance = length(light.position - vertexFragmentPos);
-			attenuation = light.intensity / (1.0f + 0.09f * distance + 0.032f * (distance * distance));
-			lightDirection = normalize(light.position - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+			// Calculate attenuation and the direction between light source and fragments/pixels on cube
+			vec3 toLight = lights[i].position - vertexFragmentPos;
+			float distance = length(toLight);
+			float attenuation = lights[i].intensity / (1.0f + 0.09f * distance + 0.032f * (distance * distance));
+			result += CalcPhong(norm, viewDir, toLight / distance, lights[i].color, attenuation);
 		}
 
+		// Texture holds the color to be used for all three components
+		vec3 surfaceColor = TEXTURED ? texture(uTexture, vertexTextureCoordinate).xyz : objectColor;
+		fragmentColor = vec4(result * surfaceColor, 1.0); // Send lighting results to GPU
+	}
+
+	vec3 CalcPhong(vec3 norm, vec3 viewDir, vec3 lightDirection, vec3 color, float attenuation)
+	{
 		// Calculate Ambient lighting
 		float ambientStrength = 0.1f; // Set ambient or global lighting strength
-		vec3 ambient = ambientStrength * light.color * attenuation; // Generate ambient light color
+		vec3 ambient = ambientStrength * color * attenuation; // Generate ambient light color
 
 		// Calculate Diffuse lighting
-		vec3 norm = normalize(vertexNormal); // Normalize vectors to 1 unit
 		float impact = max(dot(norm, lightDirection), 0.0);// Calculate diffuse impact by generating dot product of normal and light
-		vec3 diffuse = impact * light.color * attenuation; // Generate diffuse light color
+		vec3 diffuse = impact * color * attenuation; // Generate diffuse light color
 
 		// Calculate Specular lighting
 		float specularIntensity = 0.8f; // Set specular light strength
 		float highlightSize = 16.0f; // Set specular highlight size
-		vec3 viewDir = normalize(viewPosition - vertexFragmentPos); // Calculate view direction
 		vec3 reflectDir = reflect(-lightDirection, norm);// Calculate reflection vector
 		// Calculate specular component
 		float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), highlightSize);
-		vec3 specular = specularIntensity * specularComponent * light.color * attenuation;
+		vec3 specular = specularIntensity * specularComponent * color * attenuation;
+
+		return ambient + diffuse + specular;
+	}
+);
+
+/* Clustered Object Fragment Shader */
+//////////////////////////////////////
+const char* clusteredFragmentShader = GLSL(430,
+	in vec3 vertexNormal;
+	in vec3 vertexFragmentPos;
+	in vec2 vertexTextureCoordinate;
+
+	out vec4 fragmentColor;
+
+	uniform vec3 objectColor;
+	uniform sampler2D uTexture;
+
+	struct Light {
+		vec3 position; // Light position
+		vec3 color; // Light color
+		vec3 direction;
+
+		float intensity; // Intensity percentage ranging from 0.0 to 1.0
+	};
+
+	const int NR_LIGHTS = 3;
+
+	// Shared with every program, written once per frame
+	layout(std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec3 viewPosition;
+		Light lights[NR_LIGHTS];
+	};
 
-		if (hasTexture)
+	struct ClusterLight {
+		vec4 positionRadius;
+		vec4 colorCone; // Color times intensity, w scales the spot falloff
+		vec4 directionCone; // Spot direction, w is the cosine of the outer cone
+	};
+
+	layout(std430, binding = 1) readonly buffer LightBuffer
+	{
+		ClusterLight sceneLights[];
+	};
+
+	// Offset into clusterLights and light count of every cluster
+	layout(std430, binding = 2) readonly buffer ClusterGridBuffer
+	{
+		vec4 clusterScale; // Tiles per pixel in xy, log view depth to slice in zw
+		uvec4 clusterSize;
+		uvec2 clusters[];
+	};
+
+	layout(std430, binding = 3) readonly buffer ClusterIndexBuffer
+	{
+		uint clusterLights[];
+	};
+
+	vec3 CalcPhong(vec3 norm, vec3 viewDir, vec3 lightDirection, vec3 color, float attenuation);
+	uint ClusterIndex();
+
+	void main()
+	{
+		// Normal and view direction are the same for every light
+		vec3 norm = normalize(vertexNormal);
+		vec3 viewDir = normalize(viewPosition - vertexFragmentPos);
+		vec3 result = vec3(0.0);
+
+		// Directional lights reach every fragment and fill the first slots, point lights are taken from the cluster
+		for (int i = 0; i < NR_DIRECTIONAL_LIGHTS; i++)
 		{
-			// Texture holds the color to be used for all three components
-			vec4 textureColor = texture(uTexture, vertexTextureCoordinate);
-			// Calculate phong result
-			return (ambient + diffuse + specular) * textureColor.xyz;
+			result += CalcPhong(norm, viewDir, normalize(-lights[i].direction), lights[i].color, 1.0f);
 		}
-		else
+
+		uvec2 cluster = clusters[ClusterIndex()];
+		for (uint i = 0u; i < cluster.y; i++)
 		{
-			return (ambient + diffuse + specular) * objectColor;
+			ClusterLight light = sceneLights[clusterLights[cluster.x + i]];
+			vec3 toLight = light.positionRadius.xyz - vertexFragmentPos;
+			float distance = length(toLight);
+			vec3 lightDirection = toLight / distance;
+
+			// Same falloff as the object shader, windowed to reach zero at the light's radius
+			float window = clamp(1.0f - pow(distance / light.positionRadius.w, 4.0f), 0.0f, 1.0f);
+			// Spot lights fade out between their inner and outer cone, point lights have no cone
+			float cone = SPOT_LIGHTS ? clamp((dot(-lightDirection, light.directionCone.xyz) - light.directionCone.w) * light.colorCone.w, 0.0f, 1.0f) : 1.0f;
+			float attenuation = window * window * cone / (1.0f + 0.09f * distance + 0.032f * (distance * distance));
+			result += CalcPhong(norm, viewDir, lightDirection, light.colorCone.rgb, attenuation);
 		}
+
+		// Texture holds the color to be used for all three components
+		vec3 surfaceColor = TEXTURED ? texture(uTexture, vertexTextureCoordinate).xyz : objectColor;
+		fragmentColor = vec4(result * surfaceColor, 1.0);
+	}
+
+	// Cluster of this fragment from its window position and view depth
+	uint ClusterIndex()
+	{
+		float depth = -(view * vec4(vertexFragmentPos, 1.0f)).z;
+		uvec3 cell = uvec3(gl_FragCoord.xy * clusterScale.xy, max(log(depth) * clusterScale.z + clusterScale.w, 0.0f));
+		cell = min(cell, clusterSize.xyz - 1u);
+		return cell.x + clusterSize.x * (cell.y + clusterSize.y * cell.z);
+	}
+
+	vec3 CalcPhong(vec3 norm, vec3 viewDir, vec3 lightDirection, vec3 color, float attenuation)
+	{
+		// Ambient, diffuse and specular, same terms as the unclustered shader
+		vec3 ambient = 0.1f * color * attenuation;
+
+		float impact = max(dot(norm, lightDirection), 0.0);
+		vec3 diffuse = impact * color * attenuation;
+
+		vec3 reflectDir = reflect(-lightDirection, norm);
+		float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), 16.0f);
+		vec3 specular = 0.8f * specularComponent * color * attenuation;
+
+		return ambient + diffuse + specular;
 	}
 );
 
@@ -180,15 +364,38 @@ const char* objectFragmentShader = GLSL(330,
 /////////////////////////
 const GLchar* lightVertexShader = GLSL(440,
 	layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
+	layout(location = 3) in mat4 instanceModel; // Per-lamp transform
+
+	struct Light {
+		vec3 position; // Light position
+		vec3 color; // Light color
+		vec3 direction;
+
+		float intensity; // Intensity percentage ranging from 0.0 to 1.0
+	};
+
+	const int NR_LIGHTS = 3;
+
+	// Shared with every program, written once per frame
+	layout(std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec3 viewPosition;
+		Light lights[NR_LIGHTS];
+	};
 
-	//Uniform / Global variables for the  transform matrices
+	//Uniform / Global variables for the model transform
 	uniform mat4 model;
-	uniform mat4 view;
-	uniform mat4 projection;
+
+	// Packed positions are relative to the mesh's bounding box
+	uniform vec3 positionScale;
+	uniform vec3 positionOffset;
 
 	void main()
 	{
-		gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices into clip coordinates
+		vec3 objectPosition = position * positionScale + positionOffset;
+		gl_Position = projection * view * model * instanceModel * vec4(objectPosition, 1.0f); // Transforms vertices into clip coordinates
 	}
 );
 
@@ -203,6 +410,217 @@ const GLchar* lightFragmentShader = GLSL(440,
 	}
 );
 
+/**************************************************************************
+*																		  *
+*				        INDIRECT SCENE SHADERS                            *
+*                                                                         *
+**************************************************************************/
+
+/* Indirect Vertex Shader */
+////////////////////////////
+const char* indirectVertexShader = GLSL_EXT(440, GL_ARB_shader_draw_parameters,
+	layout(location = 0) in vec3 position;
+	layout(location = 1) in vec4 normal; // Octahedral in xy when packed
+	layout(location = 2) in vec2 textureCoordinate;
+
+	out vec3 vertexNormal;
+	out vec3 vertexFragmentPos;
+	out vec2 vertexTextureCoordinate;
+	flat out uint vertexObjectIndex;
+
+	struct Light {
+		vec3 position; // Light position
+		vec3 color; // Light color
+		vec3 direction;
+
+		float intensity; // Intensity percentage ranging from 0.0 to 1.0
+	};
+
+	const int NR_LIGHTS = 3;
+
+	// Shared with every program, written once per frame
+	layout(std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec3 viewPosition;
+		Light lights[NR_LIGHTS];
+	};
+
+	struct ObjectData {
+		mat4 model;
+		mat3 normalMatrix; // Inverse transpose of model
+		vec4 color;
+		vec4 positionScale;
+		vec4 positionOffset;
+		uint textureLayer;
+		uint octahedralNormals;
+	};
+
+	// One entry per draw command
+	layout(std430, binding = 0) readonly buffer ObjectBuffer
+	{
+		ObjectData objects[];
+	};
+
+	// Unfold a normal stored on the octahedron
+	vec3 decodeOctahedral(vec2 encoded)
+	{
+		vec3 normal = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+		float fold = max(-normal.z, 0.0f);
+		normal.x += normal.x >= 0.0f ? -fold : fold;
+		normal.y += normal.y >= 0.0f ? -fold : fold;
+		return normalize(normal);
+	}
+
+	void main()
+	{
+		ObjectData object = objects[gl_DrawIDARB];
+		vec3 objectPosition = position * object.positionScale.xyz + object.positionOffset.xyz;
+		vec3 objectNormal = object.octahedralNormals != 0u ? decodeOctahedral(normal.xy) : normal.xyz;
+
+		mat4 model = object.model;
+		gl_Position = projection * view * model * vec4(objectPosition, 1.0f);
+		vertexFragmentPos = vec3(model * vec4(objectPosition, 1.0f));
+		vertexNormal = object.normalMatrix * objectNormal;
+		vertexTextureCoordinate = textureCoordinate;
+		vertexObjectIndex = uint(gl_DrawIDARB);
+	}
+);
+
+/* Indirect Fragment Shader */
+//////////////////////////////
+const char* indirectFragmentShader = GLSL(440,
+	in vec3 vertexNormal;
+	in vec3 vertexFragmentPos;
+	in vec2 vertexTextureCoordinate;
+	flat in uint vertexObjectIndex;
+
+	out vec4 fragmentColor;
+
+	struct Light {
+		vec3 position; // Light position
+		vec3 color; // Light color
+		vec3 direction;
+
+		float intensity; // Intensity percentage ranging from 0.0 to 1.0
+	};
+
+	const int NR_LIGHTS = 3;
+
+	// Shared with every program, written once per frame
+	layout(std140) uniform FrameData
+	{
+		mat4 view;
+		mat4 projection;
+		vec3 viewPosition;
+		Light lights[NR_LIGHTS];
+	};
+
+	struct ObjectData {
+		mat4 model;
+		mat3 normalMatrix; // Inverse transpose of model
+		vec4 color;
+		vec4 positionScale;
+		vec4 positionOffset;
+		uint textureLayer;
+		uint octahedralNormals;
+	};
+
+	layout(std430, binding = 0) readonly buffer ObjectBuffer
+	{
+		ObjectData objects[];
+	};
+
+	struct ClusterLight {
+		vec4 positionRadius;
+		vec4 colorCone; // Color times intensity, w scales the spot falloff
+		vec4 directionCone; // Spot direction, w is the cosine of the outer cone
+	};
+
+	layout(std430, binding = 1) readonly buffer LightBuffer
+	{
+		ClusterLight sceneLights[];
+	};
+
+	// Offset into clusterLights and light count of every cluster
+	layout(std430, binding = 2) readonly buffer ClusterGridBuffer
+	{
+		vec4 clusterScale; // Tiles per pixel in xy, log view depth to slice in zw
+		uvec4 clusterSize;
+		uvec2 clusters[];
+	};
+
+	layout(std430, binding = 3) readonly buffer ClusterIndexBuffer
+	{
+		uint clusterLights[];
+	};
+
+	// Every texture of the batch, one layer each
+	layout(binding = 0) uniform sampler2DArray uTextures;
+
+	vec3 CalcPhong(vec3 norm, vec3 viewDir, vec3 lightDirection, vec3 color, float attenuation);
+	uint ClusterIndex();
+
+	void main()
+	{
+		// Normal and view direction are the same for every light
+		vec3 norm = normalize(vertexNormal);
+		vec3 viewDir = normalize(viewPosition - vertexFragmentPos);
+		vec3 result = vec3(0.0);
+
+		// Directional lights reach every fragment and fill the first slots, point lights are taken from the cluster
+		for (int i = 0; i < NR_DIRECTIONAL_LIGHTS; i++)
+		{
+			result += CalcPhong(norm, viewDir, normalize(-lights[i].direction), lights[i].color, 1.0f);
+		}
+
+		uvec2 cluster = clusters[ClusterIndex()];
+		for (uint i = 0u; i < cluster.y; i++)
+		{
+			ClusterLight light = sceneLights[clusterLights[cluster.x + i]];
+			vec3 toLight = light.positionRadius.xyz - vertexFragmentPos;
+			float distance = length(toLight);
+			vec3 lightDirection = toLight / distance;
+
+			// Same falloff as the object shader, windowed to reach zero at the light's radius
+			float window = clamp(1.0f - pow(distance / light.positionRadius.w, 4.0f), 0.0f, 1.0f);
+			// Spot lights fade out between their inner and outer cone, point lights have no cone
+			float cone = SPOT_LIGHTS ? clamp((dot(-lightDirection, light.directionCone.xyz) - light.directionCone.w) * light.colorCone.w, 0.0f, 1.0f) : 1.0f;
+			float attenuation = window * window * cone / (1.0f + 0.09f * distance + 0.032f * (distance * distance));
+			result += CalcPhong(norm, viewDir, lightDirection, light.colorCone.rgb, attenuation);
+		}
+
+		ObjectData object = objects[vertexObjectIndex];
+		vec4 textureColor = texture(uTextures, vec3(vertexTextureCoordinate, float(object.textureLayer)));
+		fragmentColor = vec4(result * textureColor.xyz * object.color.xyz, 1.0);
+	}
+
+	// Cluster of this fragment from its window position and view depth
+	uint ClusterIndex()
+	{
+		float depth = -(view * vec4(vertexFragmentPos, 1.0f)).z;
+		uvec3 cell = uvec3(gl_FragCoord.xy * clusterScale.xy, max(log(depth) * clusterScale.z + clusterScale.w, 0.0f));
+		cell = min(cell, clusterSize.xyz - 1u);
+		return cell.x + clusterSize.x * (cell.y + clusterSize.y * cell.z);
+	}
+
+	vec3 CalcPhong(vec3 norm, vec3 viewDir, vec3 lightDirection, vec3 color, float attenuation)
+	{
+		// Ambient, diffuse and specular, same terms as the unclustered shader
+		vec3 ambient = 0.1f * color * attenuation;
+
+		float impact = max(dot(norm, lightDirection), 0.0);
+		vec3 diffuse = impact * color * attenuation;
+
+		vec3 reflectDir = reflect(-lightDirection, norm);
+		float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), 16.0f);
+		vec3 specular = 0.8f * specularComponent * color * attenuation;
+
+		return ambient + diffuse + specular;
+	}
+);
+
 /**************************************************************************
 *																		  *
 *					      FORWARD DECLARATIONS                            *
@@ -212,13 +630,14 @@ const GLchar* lightFragmentShader = GLSL(440,
 bool Initialize();
 bool CreateTexture(const char* filename, GLuint& textureId);
 bool LoadTextures();
-bool CreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
+glm::mat4 ModelMatrix(const glm::vec3& translation, float degrees, const glm::vec3& axis, const glm::vec3& scale);
+void UpdateFrameData(const LightManager& lightManager);
+ShaderPermutation LightPermutation(const LightManager& lightManager, GLuint features, bool clustered);
 void ProcessInput(GLFWwindow* window);
 void FramebufferSizeCallback(GLFWwindow* window, int width, int height);
 void MousePositionCallback(GLFWwindow* window, double xpos, double ypos);
 void MouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 // void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
-void DestroyShaderProgram(GLuint programId);
 
 int main()
 {
@@ -231,19 +650,89 @@ int main()
 	/*
 	 * Create objects
 	 */
-	Mesh plane, pencilBody, pencilTip, notepad, box, sphere;
-	plane.CreatePlane();
-	pencilBody.CreateCylinder(0.1f, 0.1f, 10.0f, 4.5f, 4.0f); // Params: base radius, top radius, sectors, height, stacks
-	pencilTip.CreateCylinder(0.1f, 0.003f, 10.0f, 0.5f, 4.0f);
-	notepad.CreateCube(2.5f, 0.3f, 2.5f); // Params: length, height, width
-	box.CreateCube(3.0f, 1.0f, 2.25f);
-	sphere.CreateSphere(0.5f, 36, 18); // Params: radius, sectors, stacks
+	// Pack every mesh to 16 bytes per vertex, they share one geometry arena
+	// Requests for the same primitive parameters share one mesh
+	PrimitiveCache primitiveCache(VertexLayout::PackedPositionNormalUV());
+	shared_ptr<Mesh> plane, pencilBody, pencilTip, notepad, box, sphere;
+
+	// Generate the meshes across all cores, then upload them together on this thread
+	{
+		JobPool jobPool;
+		MeshBatch meshBatch;
+
+		// Round meshes get a detail chain that halves sectors and stacks per level
+		PrimitiveDesc pencilBodyDesc = PrimitiveDesc::Cylinder(0.1f, 0.1f, 10, 4.5f, 4); // Params: base radius, top radius, sectors, height, stacks
+		PrimitiveDesc pencilTipDesc = PrimitiveDesc::Cylinder(0.1f, 0.003f, 10, 0.5f, 4);
+		PrimitiveDesc sphereDesc = PrimitiveDesc::Sphere(0.5f, 36, 18); // Params: radius, sectors, stacks
+		pencilBodyDesc.lodCount = MAX_PRIMITIVE_LODS;
+		pencilTipDesc.lodCount = MAX_PRIMITIVE_LODS;
+		sphereDesc.lodCount = MAX_PRIMITIVE_LODS;
+
+		plane = primitiveCache.Acquire(PrimitiveDesc::Plane(), meshBatch);
+		pencilBody = primitiveCache.Acquire(pencilBodyDesc, meshBatch);
+		pencilTip = primitiveCache.Acquire(pencilTipDesc, meshBatch);
+		notepad = primitiveCache.Acquire(PrimitiveDesc::Cube(2.5f, 0.3f, 2.5f), meshBatch); // Params: length, height, width
+		box = primitiveCache.Acquire(PrimitiveDesc::Cube(3.0f, 1.0f, 2.25f), meshBatch);
+		sphere = primitiveCache.Acquire(sphereDesc, meshBatch);
+
+		meshBatch.Generate(jobPool);
+		meshBatch.Upload();
+	}
+
+	/*
+	 * Create lights
+	 */
+	// Key light shines down on the desk, its lamp marks where it comes from
+	LightManager lightManager;
+	LightDesc keyLight = LightDesc::Directional(glm::vec3(-0.2f, -1.0f, -0.3f), glm::vec3(1.0f, 1.0f, 1.0f));
+	keyLight.position = glm::vec3(0.0f, 10.0f, 0.0f);
+	keyLight.gizmoScale = LIGHT_GIZMO_SCALE;
+	lightManager.Add(keyLight);
+
+	// Two fill lights reaching across the whole desk
+	const glm::vec3 fillColor(1.0f, 0.97f, 0.61f);
+	lightManager.Add(LightDesc::Point(glm::vec3(7.0f, 1.0f, 0.0f), fillColor, 1.0f, LightRange(1.0f)));
+	lightManager.Add(LightDesc::Point(glm::vec3(0.0f, 1.0f, -7.0f), fillColor, 1.0f, LightRange(1.0f)));
 
 	/*
 	 * Create and compile shaders
 	 */
-	CreateShaderProgram(objectVertexShader, objectFragmentShader, objectShaderId);
-	CreateShaderProgram(lightVertexShader, lightFragmentShader, lightShaderId);
+	// Each variant is specialized for the scene's textures and light counts, so its light loops never branch
+	ShaderCache shaderCache;
+	const GLuint objectFeatures = SHADER_TEXTURED;
+
+	// Shade point lights per cluster when shader storage buffers are available
+	bool clustered = ClusteredLighting::IsSupported();
+	objectShaderId = clustered ? shaderCache.Acquire(objectVertexShader, clusteredFragmentShader, LightPermutation(lightManager, objectFeatures, true)) : 0;
+	if (objectShaderId == 0)
+	{
+		// Fall back to the fixed NR_LIGHTS lights of the frame data
+		clustered = false;
+		objectShaderId = shaderCache.Acquire(objectVertexShader, objectFragmentShader, LightPermutation(lightManager, objectFeatures, false));
+	}
+	lightShaderId = shaderCache.Acquire(lightVertexShader, lightFragmentShader, { 0, 0, 0 });
+
+	// Cache the uniform locations of both programs
+	objectUniformTable.Build(objectShaderId);
+	lightUniformTable.Build(lightShaderId);
+	objectUniforms.Resolve(objectUniformTable);
+	lightUniforms.Resolve(lightUniformTable);
+
+	// Both programs read camera and lights from the same uniform buffer
+	frameUniformBuffer.Create();
+	frameUniformBuffer.AttachProgram(objectShaderId);
+	frameUniformBuffer.AttachProgram(lightShaderId);
+
+	ClusteredLighting clusteredLighting;
+	if (clustered)
+	{
+		lightManager.Create();
+		clusteredLighting.Create();
+	}
+	else if (lightManager.GetCount() > NR_LIGHTS)
+	{
+		cout << "Clustered lighting needs shader storage buffers, only " << NR_LIGHTS << " lights are drawn" << endl;
+	}
 
 	/*
 	 * Load textures
@@ -253,9 +742,58 @@ int main()
 		return EXIT_FAILURE;
 	}
 
+	/*
+	 * Build the draw list once, model matrices are only rebuilt when an object moves
+	 */
+	Scene scene;
+	RenderQueue renderQueue;
+	GLuint planeMesh = scene.AddMesh(plane.get());
+	GLuint pencilBodyMesh = scene.AddMesh(pencilBody.get());
+	GLuint pencilTipMesh = scene.AddMesh(pencilTip.get());
+	GLuint notepadMesh = scene.AddMesh(notepad.get());
+	GLuint boxMesh = scene.AddMesh(box.get());
+	GLuint sphereMesh = scene.AddMesh(sphere.get());
+
+	const glm::vec3 white(1.0f, 1.0f, 1.0f);
+	GLuint planeMaterial = scene.AddMaterial({ objectUniforms, textureIdPlane, white });
+	GLuint pencilMaterial = scene.AddMaterial({ objectUniforms, textureIdPencil, white });
+	GLuint tipMaterial = scene.AddMaterial({ objectUniforms, textureIdTip, white });
+	GLuint paperMaterial = scene.AddMaterial({ objectUniforms, textureIdPaper, white });
+	GLuint boxMaterial = scene.AddMaterial({ objectUniforms, textureIdBox, white });
+	GLuint ballMaterial = scene.AddMaterial({ objectUniforms, textureIdBall, white });
+	GLuint lampMaterial = scene.AddMaterial({ lightUniforms, 0, white });
+
+	const glm::vec3 xAxis(1.0f, 0.0f, 0.0f), yAxis(0.0f, 1.0f, 0.0f);
+	const glm::vec3 unitScale(1.0f);
+	scene.AddItem(planeMesh, planeMaterial, ModelMatrix(glm::vec3(0.0f, 0.0f, 0.0f), 0.0f, yAxis, unitScale));
+	scene.AddItem(pencilBodyMesh, pencilMaterial, ModelMatrix(glm::vec3(-1.5f, 0.4f, 0.0f), 80.0f, yAxis, unitScale));
+	scene.AddItem(pencilTipMesh, tipMaterial, ModelMatrix(glm::vec3(0.962f, 0.4f, 0.434f), 80.0f, yAxis, unitScale));
+	GLuint notepadItem = scene.AddItem(notepadMesh, paperMaterial, ModelMatrix(glm::vec3(-2.0f, 0.0f, 2.0f), 45.0f, yAxis, unitScale));
+	GLuint boxItem = scene.AddItem(boxMesh, boxMaterial, ModelMatrix(glm::vec3(0.75f, 0.0f, -1.0f), 35.0f, -yAxis, unitScale));
+	scene.AddItem(sphereMesh, ballMaterial, ModelMatrix(glm::vec3(0.0f, 0.49f, -1.5f), 45.0f, xAxis, unitScale));
+	// Smaller spheres used as a visual cue for the light sources, drawn in one instanced call
+	lightManager.UpdateGizmos(*sphere);
+	GLuint lampItem = scene.AddInstancedItem(sphereMesh, lampMaterial);
+
+	// The solid cubes hide whatever is entirely behind them
+	scene.SetOccluder(notepadItem, true);
+	scene.SetOccluder(boxItem, true);
+
+	// Draw the static textured objects with one multi-draw indirect call when the driver allows it
+	IndirectScene indirectScene;
+	if (clustered && IndirectScene::IsSupported())
+	{
+		indirectShaderId = shaderCache.Acquire(indirectVertexShader, indirectFragmentShader, LightPermutation(lightManager, objectFeatures, true));
+	}
+	if (indirectShaderId != 0)
+	{
+		frameUniformBuffer.AttachProgram(indirectShaderId);
+		indirectScene.Build(scene, objectShaderId, indirectShaderId);
+	}
+
 	// Set shader
 	glUseProgram(objectShaderId);
-	glUniform1i(glGetUniformLocation(objectShaderId, "uTexture"), 0); // Texture unit 0
+	glUniform1i(objectUniformTable.Location("uTexture"), 0); // Texture unit 0
 
 	// Set background color
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
@@ -263,6 +801,9 @@ int main()
 	// Enable z-depth
 	glEnable(GL_DEPTH_TEST);
 
+	// Handles are resolved, start counting lookups made by the render loop
+	UniformTable::ResetLookupCount();
+
 	// Render loop
 	while (!glfwWindowShouldClose(window))
 	{
@@ -271,19 +812,51 @@ int main()
 		gDeltaTime = currentFrame - gLastFrame;
 		gLastFrame = currentFrame;
 
+		gFrameStats.BeginFrame();
+
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// For processing input
 		ProcessInput(window);
 
+		// Write only the lights that changed, and move the lamps with them
+		bool lightsChanged = lightManager.Upload();
+		if (lightManager.UpdateGizmos(*sphere))
+		{
+			// Instanced items keep the identity transform, this refreshes their bounds
+			scene.SetTransform(lampItem, glm::mat4(1.0f));
+		}
+
+		// Upload camera and lights only when the view, projection or a light changed
+		bool viewChanged = gFrameContext.Update(gCamera, perspective, orthoCoords);
+		if (viewChanged || lightsChanged)
+		{
+			UpdateFrameData(lightManager);
+			frameUniformBuffer.Update(frameData);
+
+			// Clusters follow the view and the lights, so the lights are binned again with either
+			if (clustered)
+			{
+				clusteredLighting.Update(lightManager, gFrameContext.GetView(), gFrameContext.GetProjection(), gFrameContext.GetViewportWidth(), gFrameContext.GetViewportHeight());
+			}
+		}
+
 		// Render objects
-		plane.RenderPlane(objectShaderId, textureIdPlane, WINDOW_WIDTH, WINDOW_HEIGHT, gCamera, perspective, orthoCoords);
-		pencilBody.RenderPencilBody(objectShaderId, textureIdPencil, WINDOW_WIDTH, WINDOW_HEIGHT, gCamera, perspective, orthoCoords);
-		pencilTip.RenderPencilTip(objectShaderId, textureIdTip, WINDOW_WIDTH, WINDOW_HEIGHT, gCamera, perspective, orthoCoords);
-		notepad.RenderNotepad(objectShaderId, textureIdPaper, WINDOW_WIDTH, WINDOW_HEIGHT, gCamera, perspective, orthoCoords);
-		box.RenderBox(objectShaderId, textureIdBox, WINDOW_WIDTH, WINDOW_HEIGHT, gCamera, perspective, orthoCoords);
-		// Draws sphere AND lights
-		sphere.RenderSphere(objectShaderId, lightShaderId, textureIdBall, WINDOW_WIDTH, WINDOW_HEIGHT, gCamera, perspective, orthoCoords);
+		gFrameStats.BeginSubmit();
+		renderQueue.Clear();
+		scene.Cull(gFrameContext.GetViewProjection());
+		scene.Enqueue(renderQueue, gFrameContext.GetView(), gFrameContext.GetProjection());
+		renderQueue.Flush();
+		indirectScene.Update(scene, gFrameContext.GetView(), gFrameContext.GetProjection());
+		indirectScene.Draw();
+		gFrameStats.EndSubmit();
+
+		// Uniform handles are cached, so the render loop should never look up a name
+		if (UniformTable::GetLookupCount() != 0)
+		{
+			cout << "Uniform lookups this frame: " << UniformTable::GetLookupCount() << endl;
+			UniformTable::ResetLookupCount();
+		}
 
 		// Get and handle user input events
 		glfwPollEvents();
@@ -291,9 +864,40 @@ int main()
 		// Swap back buffer and front buffer each frame
 		glfwSwapBuffers(window);
 	}
+	// Report CPU submission cost and geometry arena occupancy
+	gFrameStats.BeginFrame();
+	if (clustered)
+	{
+		cout << "Lights: " << lightManager.GetCount() << endl;
+	}
+	gFrameStats.Print();
+	GeometryArena::PrintStats();
+	primitiveCache.PrintStats();
+	scene.PrintStats();
+	shaderCache.PrintStats();
+
+	// Release frame uniform buffer
+	frameUniformBuffer.Destroy();
+
+	// Release the batched static scene
+	indirectScene.Destroy();
+
+	// Release the light and cluster buffers
+	lightManager.Destroy();
+	clusteredLighting.Destroy();
+
+	// Release the meshes, then the geometry arenas they were allocated from
+	plane.reset();
+	pencilBody.reset();
+	pencilTip.reset();
+	notepad.reset();
+	box.reset();
+	sphere.reset();
+	primitiveCache.Clear();
+	GeometryArena::ReleaseAll();
+
 	// Release shader programs
-	DestroyShaderProgram(objectShaderId);
-	DestroyShaderProgram(lightShaderId);
+	shaderCache.Clear();
 
 
 	exit(EXIT_SUCCESS);
@@ -325,6 +929,11 @@ bool Initialize()
 	glfwMakeContextCurrent(window);
 	glfwSetFramebufferSizeCallback(window, FramebufferSizeCallback);
 
+	// The framebuffer can be larger than the window on high DPI displays
+	int framebufferWidth, framebufferHeight;
+	glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+	gFrameContext.SetViewport(framebufferWidth, framebufferHeight);
+
 	// Register callback functions for handling mouse events
 	glfwSetCursorPosCallback(window, MousePositionCallback);
 	glfwSetScrollCallback(window, MouseScrollCallback);
@@ -444,63 +1053,41 @@ bool LoadTextures()
 	return true;
 }
 
-/* Compile shaders and check for errors */
-//////////////////////////////////////////
-bool CreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId)
+/* Build a model matrix from a translation, rotation and scale */
+/////////////////////////////////////////////////////////////////
+glm::mat4 ModelMatrix(const glm::vec3& translation, float degrees, const glm::vec3& axis, const glm::vec3& scale)
 {
-	// For error reporting
-	int success = 0;
-	char infoLog[512];
-
-	programId = glCreateProgram();
-
-	// Create vertex shader and fragment shader objects
-	GLuint vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
-	GLuint fragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
-
-	// Retrive the shader source
-	glShaderSource(vertexShaderId, 1, &vtxShaderSource, NULL);
-	glShaderSource(fragmentShaderId, 1, &fragShaderSource, NULL);
-
-	// Compile vertex shader
-	glCompileShader(vertexShaderId);
-	// Check for errors
-	glGetShaderiv(vertexShaderId, GL_COMPILE_STATUS, &success);
-	if (!success)
-	{
-		glGetShaderInfoLog(vertexShaderId, sizeof(infoLog), NULL, infoLog);
-		cout << "Vertex shader compilation failed." << infoLog << endl;
-		return false;
-	}
+	return glm::translate(translation) * glm::rotate(glm::radians(degrees), axis) * glm::scale(scale);
+}
 
-	// Compile fragment shader
-	glCompileShader(fragmentShaderId);
-	glGetShaderiv(fragmentShaderId, GL_COMPILE_STATUS, &success);
-	if (!success)
-	{
-		glGetShaderInfoLog(fragmentShaderId, sizeof(infoLog), NULL, infoLog);
-		cout << "Fragment shader compilation failed." << infoLog << endl;
-		return false;
-	}
+/* Fill this frame's camera and light data */
+/////////////////////////////////////////////
+void UpdateFrameData(const LightManager& lightManager)
+{
+	frameData.view = gFrameContext.GetView();
+	frameData.projection = gFrameContext.GetProjection();
+	frameData.viewPosition = glm::vec4(gFrameContext.GetViewPosition(), 1.0f);
 
-	// Attach both shaders to the program
-	glAttachShader(programId, vertexShaderId);
-	glAttachShader(programId, fragmentShaderId);
+	// Directional lights first, then as many point lights as the fixed slots hold
+	lightManager.FillFrameData(frameData);
+}
 
-	glLinkProgram(programId);
-	// Check for errors
-	glGetProgramiv(programId, GL_LINK_STATUS, &success);
-	if (!success)
+/* Shader variant for the lights of the scene, a clustered shader reads point lights from the cluster */
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+ShaderPermutation LightPermutation(const LightManager& lightManager, GLuint features, bool clustered)
+{
+	// Same slots FillFrameData writes, directional lights first
+	ShaderPermutation permutation;
+	permutation.features = features;
+	permutation.directionalLights = min(lightManager.GetCount(LIGHT_DIRECTIONAL), (GLuint)NR_LIGHTS);
+	permutation.pointLights = clustered ? 0 : min(lightManager.GetCount(LIGHT_POINT), (GLuint)NR_LIGHTS - permutation.directionalLights);
+
+	// Spot cones are only evaluated when a spot light exists
+	if (clustered && lightManager.GetCount(LIGHT_SPOT) > 0)
 	{
-		glGetProgramInfoLog(programId, sizeof(infoLog), NULL, infoLog);
-		cout << "Error linking shader program." << infoLog << endl;
-		return false;
+		permutation.features |= SHADER_SPOT_LIGHTS;
 	}
-
-	// Use shader program
-	glUseProgram(programId);
-
-	return true;
+	return permutation;
 }
 
 /* Check if escape key is pressed, and if so set that window should close */
@@ -523,10 +1110,12 @@ void ProcessInput(GLFWwindow* window)
 			orthoCoords[1] -= cameraOffset;
 			orthoCoords[2] += cameraOffset;
 			orthoCoords[3] -= cameraOffset;
+			gFrameContext.MarkProjectionDirty();
 		}
 		else
 		{
 			gCamera.ProcessKeyboard(FORWARD, gDeltaTime);
+			gFrameContext.MarkViewDirty();
 		}
 	}
 	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
@@ -538,37 +1127,44 @@ void ProcessInput(GLFWwindow* window)
 			orthoCoords[1] += cameraOffset;
 			orthoCoords[2] -= cameraOffset;
 			orthoCoords[3] += cameraOffset;
+			gFrameContext.MarkProjectionDirty();
 		}
 		else
 		{
 			gCamera.ProcessKeyboard(BACKWARD, gDeltaTime);
+			gFrameContext.MarkViewDirty();
 		}
 	}
 	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
 	{
 		// Move left
 		gCamera.ProcessKeyboard(LEFT, gDeltaTime);
+		gFrameContext.MarkViewDirty();
 	}
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
 	{
 		// Move right
 		gCamera.ProcessKeyboard(RIGHT, gDeltaTime);
+		gFrameContext.MarkViewDirty();
 	}
 	if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
 	{
 		// Move up
 		gCamera.Position += cameraOffset * gCamera.Up;
+		gFrameContext.MarkViewDirty();
 	}
 	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
 	{
 		// Move down
 		gCamera.Position -= cameraOffset * gCamera.Up;
+		gFrameContext.MarkViewDirty();
 	}
 	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
 	{
 		// Toggle perspective and orthographic view
 		glfwWaitEventsTimeout(0.7); // Prevent mutltiple toggles with one key press 
 		perspective = !perspective;
+		gFrameContext.MarkProjectionDirty();
 	}
 }
 
@@ -577,6 +1173,9 @@ void ProcessInput(GLFWwindow* window)
 void FramebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
 	glViewport(0, 0, width, height);
+
+	// Keep the projection's aspect ratio in sync with the framebuffer
+	gFrameContext.SetViewport(width, height);
 }
 
 /* Called whenever mouses moves */
@@ -598,6 +1197,7 @@ void MousePositionCallback(GLFWwindow* window, double xpos, double ypos)
 	gLastY = ypos;
 
 	gCamera.ProcessMouseMovement(xoffset, yoffset);
+	gFrameContext.MarkViewDirty();
 }
 
 /* Called when scroll wheel moves */
@@ -611,11 +1211,4 @@ void MouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
 		gCamera.MovementSpeed = 0.5f;
 	if (gCamera.MovementSpeed > 30.5f)
 		gCamera.MovementSpeed = 30.5f;
-}
-
-/* Release shader */
-////////////////////
-void DestroyShaderProgram(GLuint programId)
-{
-	glDeleteProgram(programId);
 }
\ No newline at end of file